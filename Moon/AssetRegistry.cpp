@@ -0,0 +1,250 @@
+#include "AssetRegistry.h"
+#include "RenderDevice.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Moon
+{
+	uint64_t hashBytes(std::span<const uint8_t> bytes, uint64_t hash)
+	{
+		// FNV-1a on 8 byte words with an extra shift to mix the high bits down
+		constexpr uint64_t prime = 0x100000001B3ull;
+		size_t i = 0;
+		for (; i + 8 <= bytes.size(); i += 8)
+		{
+			uint64_t word;
+			memcpy(&word, bytes.data() + i, sizeof(word));
+			hash = (hash ^ word) * prime;
+			hash ^= hash >> 29;
+		}
+		for (; i < bytes.size(); i++)
+		{
+			hash = (hash ^ bytes[i]) * prime;
+		}
+		return hash;
+	}
+
+	static uint32_t rotateRight(uint32_t value, int bits)
+	{
+		return (value >> bits) | (value << (32 - bits));
+	}
+
+	void AssetKeyBuilder::compress(const uint8_t* block)
+	{
+		static constexpr uint32_t k[64] =
+		{
+			0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+			0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+			0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+			0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+			0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+			0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+			0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+			0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+		};
+
+		uint32_t w[64];
+		for (int i = 0; i < 16; i++)
+		{
+			w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16) | (uint32_t(block[i * 4 + 2]) << 8) | block[i * 4 + 3];
+		}
+		for (int i = 16; i < 64; i++)
+		{
+			uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+		uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+		for (int i = 0; i < 64; i++)
+		{
+			uint32_t t1 = h + (rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+			uint32_t t2 = (rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+		m_state[0] += a;
+		m_state[1] += b;
+		m_state[2] += c;
+		m_state[3] += d;
+		m_state[4] += e;
+		m_state[5] += f;
+		m_state[6] += g;
+		m_state[7] += h;
+	}
+
+	void AssetKeyBuilder::add(std::span<const uint8_t> bytes)
+	{
+		m_size += bytes.size();
+		size_t i = 0;
+		if (m_blockSize > 0)
+		{
+			size_t count = std::min(bytes.size(), m_block.size() - m_blockSize);
+			memcpy(m_block.data() + m_blockSize, bytes.data(), count);
+			m_blockSize += count;
+			i = count;
+			if (m_blockSize < m_block.size())
+			{
+				return;
+			}
+			compress(m_block.data());
+			m_blockSize = 0;
+		}
+
+		// whole blocks are read in place
+		for (; i + 64 <= bytes.size(); i += 64)
+		{
+			compress(bytes.data() + i);
+		}
+		memcpy(m_block.data(), bytes.data() + i, bytes.size() - i);
+		m_blockSize = bytes.size() - i;
+	}
+
+	AssetKey AssetKeyBuilder::finish()
+	{
+		AssetKey key;
+		key.size = m_size;
+
+		// padding: a one bit, zeros and the message length in bits, big endian
+		uint64_t bitCount = m_size * 8;
+		uint8_t padding[72] = { 0x80 };
+		size_t paddingSize = (m_blockSize < 56 ? 56 : 120) - m_blockSize;
+		for (int i = 0; i < 8; i++)
+		{
+			padding[paddingSize + i] = static_cast<uint8_t>(bitCount >> (56 - i * 8));
+		}
+		add({ padding, paddingSize + 8 });
+
+		for (size_t i = 0; i < m_state.size(); i++)
+		{
+			key.digest[i * 4] = static_cast<uint8_t>(m_state[i] >> 24);
+			key.digest[i * 4 + 1] = static_cast<uint8_t>(m_state[i] >> 16);
+			key.digest[i * 4 + 2] = static_cast<uint8_t>(m_state[i] >> 8);
+			key.digest[i * 4 + 3] = static_cast<uint8_t>(m_state[i]);
+		}
+		return key;
+	}
+
+	template<typename T>
+	AssetId AssetRegistry::AssetTable<T>::find(const AssetKey& key)
+	{
+		auto it = ids.find(key);
+		if (it == ids.end())
+		{
+			return InvalidAssetId;
+		}
+		entries[it->second].refCount++;
+		return it->second;
+	}
+
+	template<typename T>
+	AssetId AssetRegistry::AssetTable<T>::add(const AssetKey& key, const T& asset)
+	{
+		AssetId id;
+		if (!freeIds.empty())
+		{
+			id = freeIds.back();
+			freeIds.pop_back();
+			entries[id] = Entry{ asset, key, 1 };
+		}
+		else
+		{
+			id = static_cast<AssetId>(entries.size());
+			entries.push_back(Entry{ asset, key, 1 });
+		}
+		ids[key] = id;
+		return id;
+	}
+
+	template<typename T>
+	bool AssetRegistry::AssetTable<T>::release(AssetId id)
+	{
+		if (id == InvalidAssetId || --entries[id].refCount > 0)
+		{
+			return false;
+		}
+		ids.erase(entries[id].key);
+		freeIds.push_back(id);
+		return true;
+	}
+
+	void AssetRegistry::init(RenderDevice* engine)
+	{
+		m_engine = engine;
+	}
+
+	void AssetRegistry::cleanup()
+	{
+		for (const auto& [key, id] : m_images.ids)
+		{
+			destroyImage(m_images.entries[id].asset);
+		}
+		for (const auto& [key, id] : m_meshes.ids)
+		{
+			destroyMesh(m_meshes.entries[id].asset);
+		}
+		m_images = {};
+		m_meshes = {};
+	}
+
+	AssetId AssetRegistry::findImage(const AssetKey& key)
+	{
+		return m_images.find(key);
+	}
+
+	AssetId AssetRegistry::addImage(const AssetKey& key, const AllocatedImage& image)
+	{
+		uint32_t textureIndex = m_engine->getBindlessResources().registerTexture(image.imageView);
+		return m_images.add(key, ImageAsset{ image, textureIndex });
+	}
+
+	void AssetRegistry::releaseImage(AssetId id)
+	{
+		if (m_images.release(id))
+		{
+			destroyImage(m_images.entries[id].asset);
+		}
+	}
+
+	AssetId AssetRegistry::findMesh(const AssetKey& key)
+	{
+		return m_meshes.find(key);
+	}
+
+	AssetId AssetRegistry::addMesh(const AssetKey& key, const GPUMeshBuffers& buffers)
+	{
+		return m_meshes.add(key, buffers);
+	}
+
+	void AssetRegistry::releaseMesh(AssetId id)
+	{
+		if (m_meshes.release(id))
+		{
+			destroyMesh(m_meshes.entries[id].asset);
+		}
+	}
+
+	void AssetRegistry::destroyImage(const ImageAsset& image)
+	{
+		m_engine->getBindlessResources().releaseTexture(image.textureIndex);
+		m_engine->destroyImage(image.image);
+	}
+
+	void AssetRegistry::destroyMesh(const GPUMeshBuffers& buffers)
+	{
+		m_engine->destroyBuffer(buffers.indexBuffer);
+		m_engine->destroyBuffer(buffers.vertexBuffer);
+		if (buffers.meshletBuffer.buffer != VK_NULL_HANDLE)
+		{
+			m_engine->destroyBuffer(buffers.meshletBuffer);
+		}
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "RenderTypes.h"
+#include "Mesh.h"
+
+#include <array>
+#include <cstring>
+#include <unordered_map>
+
+namespace Moon
+{
+	//Forward declaration
+	class RenderDevice;
+
+	// FNV-1a on 8 byte words, a fast hash for lookups and cache invalidation
+	uint64_t hashBytes(std::span<const uint8_t> bytes, uint64_t hash = 0xCBF29CE484222325ull);
+
+	// Identity of an asset: the size and SHA-256 digest of its content. Two assets only share GPU resources
+	// when both match, a 64 bit hash alone would merge colliding images or meshes.
+	struct AssetKey
+	{
+		uint64_t size{ 0 };
+		std::array<uint8_t, 32> digest{};
+
+		bool operator==(const AssetKey& other) const = default;
+	};
+
+	struct AssetKeyHash
+	{
+		size_t operator()(const AssetKey& key) const
+		{
+			size_t hash;
+			memcpy(&hash, key.digest.data(), sizeof(hash));
+			return hash;
+		}
+	};
+
+	// Incremental SHA-256 over the parts of an asset
+	class AssetKeyBuilder
+	{
+	public:
+		void add(std::span<const uint8_t> bytes);
+		AssetKey finish();
+
+	private:
+		void compress(const uint8_t* block);
+
+		std::array<uint32_t, 8> m_state{ 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+		std::array<uint8_t, 64> m_block{};
+		size_t m_blockSize{ 0 };
+		uint64_t m_size{ 0 };
+	};
+
+	struct ImageAsset
+	{
+		AllocatedImage image;
+		uint32_t textureIndex; // bindless slot
+	};
+
+	// GPU images and mesh buffers shared by every loaded scene, identified by the key of their content.
+	// Scenes look an asset up before uploading it, each find or add holds a reference on the interned id
+	// and the GPU resources are destroyed when the last scene releases it.
+	class AssetRegistry
+	{
+	public:
+		void init(RenderDevice* engine);
+		void cleanup();
+
+		// InvalidAssetId when no image or mesh with this content is loaded
+		AssetId findImage(const AssetKey& key);
+		AssetId addImage(const AssetKey& key, const AllocatedImage& image);
+		const ImageAsset& getImage(AssetId id) const { return m_images.entries[id].asset; }
+		void releaseImage(AssetId id);
+
+		AssetId findMesh(const AssetKey& key);
+		AssetId addMesh(const AssetKey& key, const GPUMeshBuffers& buffers);
+		const GPUMeshBuffers& getMesh(AssetId id) const { return m_meshes.entries[id].asset; }
+		void releaseMesh(AssetId id);
+
+		size_t getImageCount() const { return m_images.ids.size(); }
+		size_t getMeshCount() const { return m_meshes.ids.size(); }
+
+	private:
+		template<typename T>
+		struct AssetTable
+		{
+			struct Entry
+			{
+				T asset;
+				AssetKey key;
+				uint32_t refCount;
+			};
+
+			std::unordered_map<AssetKey, AssetId, AssetKeyHash> ids;
+			std::vector<Entry> entries;
+			std::vector<AssetId> freeIds;
+
+			AssetId find(const AssetKey& key);
+			AssetId add(const AssetKey& key, const T& asset);
+			// true when the last reference was released, the entry is then free
+			bool release(AssetId id);
+		};
+
+		void destroyImage(const ImageAsset& image);
+		void destroyMesh(const GPUMeshBuffers& buffers);
+
+		RenderDevice* m_engine{ nullptr };
+		AssetTable<ImageAsset> m_images;
+		AssetTable<GPUMeshBuffers> m_meshes;
+	};
+}
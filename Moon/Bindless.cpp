@@ -0,0 +1,139 @@
+#include "Bindless.h"
+#include "RenderDevice.h"
+#include "Descriptor.h"
+
+#include <cassert>
+
+namespace Moon
+{
+	uint32_t BindlessResources::SlotAllocator::allocate()
+	{
+		if (!freeSlots.empty())
+		{
+			uint32_t index = freeSlots.back();
+			freeSlots.pop_back();
+			return index;
+		}
+
+		if (next >= capacity)
+		{
+			std::cout << "Bindless descriptor array is full" << std::endl;
+			return InvalidIndex;
+		}
+		return next++;
+	}
+
+	void BindlessResources::SlotAllocator::release(uint32_t index)
+	{
+		if (index != InvalidIndex)
+		{
+			freeSlots.push_back(index);
+		}
+	}
+
+	void BindlessResources::init(RenderDevice* engine)
+	{
+		m_device = engine->getDevice();
+		m_textureSlots.capacity = MaxTextures;
+		m_samplerSlots.capacity = MaxSamplers;
+		m_materialSlots.capacity = MaxMaterials;
+
+		// textures and samplers are registered while frames are in flight and most slots stay empty
+		const VkDescriptorBindingFlags arrayFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+
+		DescriptorLayoutBuilder builder;
+		builder.addBinding(0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, MaxTextures, arrayFlags);
+		builder.addBinding(1, VK_DESCRIPTOR_TYPE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, MaxSamplers, arrayFlags);
+		builder.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+		m_layout = builder.build(m_device, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
+
+		VkDescriptorPoolSize poolSizes[] =
+		{
+			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MaxTextures },
+			{ VK_DESCRIPTOR_TYPE_SAMPLER, MaxSamplers },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 }
+		};
+
+		VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = 3;
+		poolInfo.pPoolSizes = poolSizes;
+		VK_CHECK(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_pool));
+
+		VkDescriptorSetAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+		allocInfo.descriptorPool = m_pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &m_layout;
+		VK_CHECK(vkAllocateDescriptorSets(m_device, &allocInfo, &m_set));
+
+		m_materialBuffer = engine->createBuffer(sizeof(GPUMaterialData) * MaxMaterials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		m_materials = (GPUMaterialData*)m_materialBuffer.info.pMappedData;
+
+		DescriptorWriter writer;
+		writer.writeBuffer(2, m_materialBuffer.buffer, sizeof(GPUMaterialData) * MaxMaterials, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		writer.updateSet(m_device, m_set);
+	}
+
+	void BindlessResources::cleanup(RenderDevice* engine)
+	{
+		engine->destroyBuffer(m_materialBuffer);
+		vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+		vkDestroyDescriptorSetLayout(m_device, m_layout, nullptr);
+	}
+
+	uint32_t BindlessResources::registerTexture(VkImageView imageView)
+	{
+		uint32_t index = m_textureSlots.allocate();
+		if (index != InvalidIndex)
+		{
+			DescriptorWriter writer;
+			writer.writeImage(0, imageView, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, index);
+			writer.updateSet(m_device, m_set);
+		}
+		return index;
+	}
+
+	void BindlessResources::releaseTexture(uint32_t index)
+	{
+		m_textureSlots.release(index);
+	}
+
+	uint32_t BindlessResources::registerSampler(VkSampler sampler)
+	{
+		uint32_t index = m_samplerSlots.allocate();
+		if (index != InvalidIndex)
+		{
+			DescriptorWriter writer;
+			writer.writeImage(1, VK_NULL_HANDLE, sampler, VK_IMAGE_LAYOUT_UNDEFINED, VK_DESCRIPTOR_TYPE_SAMPLER, index);
+			writer.updateSet(m_device, m_set);
+		}
+		return index;
+	}
+
+	void BindlessResources::releaseSampler(uint32_t index)
+	{
+		m_samplerSlots.release(index);
+	}
+
+	uint32_t BindlessResources::allocateMaterial(const GPUMaterialData& data)
+	{
+		uint32_t index = m_materialSlots.allocate();
+		if (index != InvalidIndex)
+		{
+			m_materials[index] = data;
+		}
+		return index;
+	}
+
+	void BindlessResources::updateMaterial(uint32_t index, const GPUMaterialData& data)
+	{
+		assert(index < MaxMaterials);
+		m_materials[index] = data;
+	}
+
+	void BindlessResources::releaseMaterial(uint32_t index)
+	{
+		m_materialSlots.release(index);
+	}
+}
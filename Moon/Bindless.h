@@ -0,0 +1,74 @@
+#pragma once
+#include "RenderTypes.h"
+
+#include <glm/vec4.hpp>
+
+namespace Moon
+{
+	//Forward declaration
+	class RenderDevice;
+
+	// Material constants as read by the shaders, one entry per material in the material buffer
+	struct GPUMaterialData
+	{
+		glm::vec4 baseColorFactors;
+		glm::vec4 metalRoughFactors;
+		uint32_t colorTextureIndex;
+		uint32_t colorSamplerIndex;
+		uint32_t metalRoughTextureIndex;
+		uint32_t metalRoughSamplerIndex;
+	};
+
+	// Global descriptor set holding every texture, sampler and material of the engine.
+	// It is bound once per frame, draws select their material through the material id in the object data.
+	//  binding 0: texture2D textures[MaxTextures]
+	//  binding 1: sampler samplers[MaxSamplers]
+	//  binding 2: GPUMaterialData materials[MaxMaterials]
+	class BindlessResources
+	{
+	public:
+		static constexpr uint32_t MaxTextures = 4096;
+		static constexpr uint32_t MaxSamplers = 256;
+		static constexpr uint32_t MaxMaterials = 16384;
+		static constexpr uint32_t InvalidIndex = ~0u;
+
+		void init(RenderDevice* engine);
+		void cleanup(RenderDevice* engine);
+
+		uint32_t registerTexture(VkImageView imageView);
+		void releaseTexture(uint32_t index);
+
+		uint32_t registerSampler(VkSampler sampler);
+		void releaseSampler(uint32_t index);
+
+		uint32_t allocateMaterial(const GPUMaterialData& data);
+		void updateMaterial(uint32_t index, const GPUMaterialData& data);
+		void releaseMaterial(uint32_t index);
+
+		VkDescriptorSetLayout getLayout() const { return m_layout; }
+		VkDescriptorSet getSet() const { return m_set; }
+
+	private:
+		struct SlotAllocator
+		{
+			std::vector<uint32_t> freeSlots;
+			uint32_t next{ 0 };
+			uint32_t capacity{ 0 };
+
+			uint32_t allocate();
+			void release(uint32_t index);
+		};
+
+		VkDevice m_device{ VK_NULL_HANDLE };
+		VkDescriptorSetLayout m_layout{ VK_NULL_HANDLE };
+		VkDescriptorPool m_pool{ VK_NULL_HANDLE };
+		VkDescriptorSet m_set{ VK_NULL_HANDLE };
+
+		AllocatedBuffer m_materialBuffer;
+		GPUMaterialData* m_materials{ nullptr };
+
+		SlotAllocator m_textureSlots;
+		SlotAllocator m_samplerSlots;
+		SlotAllocator m_materialSlots;
+	};
+}
@@ -0,0 +1,707 @@
+#include "Bvh.h"
+#include "JobSystem.h"
+
+#include <glm/geometric.hpp>
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+namespace Moon
+{
+	// split candidates per axis
+	constexpr uint32_t BvhBinCount = 16;
+	// nodes with more items bin them on every worker, the subtrees below are built whole by one worker
+	constexpr uint32_t BvhParallelItems = 32768;
+	// items binned by a worker at once
+	constexpr uint32_t BvhBinBatchSize = 8192;
+	// cost of visiting a node relative to testing one of its items
+	constexpr float BvhTraversalCost = 1.f;
+	constexpr uint32_t TriangleBvhLeafSize = 4;
+
+	struct BvhBox
+	{
+		glm::vec3 min{ std::numeric_limits<float>::max() };
+		glm::vec3 max{ std::numeric_limits<float>::lowest() };
+
+		void grow(const glm::vec3& pointMin, const glm::vec3& pointMax)
+		{
+			min = glm::min(min, pointMin);
+			max = glm::max(max, pointMax);
+		}
+
+		void grow(const BvhBox& box) { grow(box.min, box.max); }
+
+		// half the surface area, empty boxes have none
+		float area() const
+		{
+			glm::vec3 size = glm::max(max - min, glm::vec3(0.f));
+			return size.x * size.y + size.y * size.z + size.z * size.x;
+		}
+	};
+
+	struct BvhBin
+	{
+		BvhBox bounds;
+		uint32_t count{ 0 };
+	};
+
+	using BvhBins = std::array<BvhBin, 3 * BvhBinCount>;
+
+	struct BvhBuild
+	{
+		std::span<const glm::vec3> minBounds;
+		std::span<const glm::vec3> maxBounds;
+		std::vector<glm::vec3> centroids;
+		std::vector<uint32_t> items;
+		uint32_t maxLeafSize;
+	};
+
+	static uint32_t getBatchCount(JobSystem* jobSystem, uint32_t count)
+	{
+		return jobSystem != nullptr && count > BvhParallelItems ? (count + BvhBinBatchSize - 1) / BvhBinBatchSize : 1;
+	}
+
+	// Reduces function(begin, end, result) over [first, first + count), the batches of large ranges run on the workers
+	// and their results are merged with merge(result, batchResult)
+	template<typename Result, typename Function, typename Merge>
+	static void reduceBatches(JobSystem* jobSystem, uint32_t first, uint32_t count, Result& result, const Function& function, const Merge& merge)
+	{
+		const uint32_t batchCount = getBatchCount(jobSystem, count);
+		if (batchCount == 1)
+		{
+			function(first, first + count, result);
+			return;
+		}
+
+		std::vector<Result> batchResults(batchCount, result);
+		jobSystem->parallelFor(batchCount, 1, [&](uint32_t firstBatch, uint32_t lastBatch)
+			{
+				for (uint32_t batch = firstBatch; batch < lastBatch; batch++)
+				{
+					uint32_t begin = first + batch * BvhBinBatchSize;
+					function(begin, std::min(begin + BvhBinBatchSize, first + count), batchResults[batch]);
+				}
+			});
+		for (const Result& batchResult : batchResults)
+		{
+			merge(result, batchResult);
+		}
+	}
+
+	// Splits the items of node in two children with the binned surface area heuristic, false when it stays a leaf
+	static bool splitNode(BvhBuild& build, const BvhNode& node, uint32_t depth, JobSystem* jobSystem, BvhNode& left, BvhNode& right)
+	{
+		const uint32_t first = node.firstItem;
+		const uint32_t count = node.itemCount;
+		if (count <= 1 || depth >= BvhMaxDepth)
+		{
+			return false;
+		}
+
+		// the bins are laid out over the box of the item centroids
+		BvhBox centroidBounds;
+		reduceBatches(jobSystem, first, count, centroidBounds, [&](uint32_t begin, uint32_t end, BvhBox& box)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					const glm::vec3& centroid = build.centroids[build.items[i]];
+					box.grow(centroid, centroid);
+				}
+			},
+			[](BvhBox& box, const BvhBox& batchBox) { box.grow(batchBox); });
+
+		const glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+		glm::vec3 binScale;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			binScale[axis] = extent[axis] > 0.f ? float(BvhBinCount) / extent[axis] : 0.f;
+		}
+		auto binOf = [&](const glm::vec3& centroid, int axis)
+			{
+				return std::min(static_cast<uint32_t>((centroid[axis] - centroidBounds.min[axis]) * binScale[axis]), BvhBinCount - 1);
+			};
+
+		// every axis is binned in the same pass
+		BvhBins bins{};
+		reduceBatches(jobSystem, first, count, bins, [&](uint32_t begin, uint32_t end, BvhBins& bins)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					uint32_t item = build.items[i];
+					const glm::vec3& centroid = build.centroids[item];
+					for (int axis = 0; axis < 3; axis++)
+					{
+						BvhBin& bin = bins[axis * BvhBinCount + binOf(centroid, axis)];
+						bin.bounds.grow(build.minBounds[item], build.maxBounds[item]);
+						bin.count++;
+					}
+				}
+			},
+			[](BvhBins& bins, const BvhBins& batchBins)
+			{
+				for (uint32_t b = 0; b < bins.size(); b++)
+				{
+					bins[b].bounds.grow(batchBins[b].bounds);
+					bins[b].count += batchBins[b].count;
+				}
+			});
+
+		// costs are kept multiplied by the area of the node, an empty or flat node does not divide by zero
+		const float nodeArea = BvhBox{ node.min, node.max }.area();
+		const float leafCost = nodeArea * float(count);
+		float bestCost = std::numeric_limits<float>::max();
+		int bestAxis = -1;
+		uint32_t bestSplit = 0;
+		BvhBox bestLeft, bestRight;
+		uint32_t bestLeftCount = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (extent[axis] <= 0.f)
+			{
+				continue;
+			}
+
+			const BvhBin* axisBins = &bins[axis * BvhBinCount];
+			std::array<BvhBox, BvhBinCount> rightBoxes;
+			BvhBox rightBox;
+			for (uint32_t b = BvhBinCount - 1; b > 0; b--)
+			{
+				rightBox.grow(axisBins[b].bounds);
+				rightBoxes[b] = rightBox;
+			}
+
+			BvhBox leftBox;
+			uint32_t leftCount = 0;
+			for (uint32_t split = 1; split < BvhBinCount; split++)
+			{
+				leftBox.grow(axisBins[split - 1].bounds);
+				leftCount += axisBins[split - 1].count;
+				uint32_t rightCount = count - leftCount;
+				if (leftCount == 0 || rightCount == 0)
+				{
+					continue;
+				}
+
+				float cost = BvhTraversalCost * nodeArea + leftBox.area() * float(leftCount) + rightBoxes[split].area() * float(rightCount);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+					bestLeft = leftBox;
+					bestRight = rightBoxes[split];
+					bestLeftCount = leftCount;
+				}
+			}
+		}
+
+		uint32_t* items = build.items.data() + first;
+		if (bestAxis < 0)
+		{
+			// every centroid is at the same place, a leaf too large is cut in the middle of its items
+			if (count <= build.maxLeafSize)
+			{
+				return false;
+			}
+			bestLeftCount = count / 2;
+			bestLeft = {};
+			bestRight = {};
+			for (uint32_t i = 0; i < count; i++)
+			{
+				BvhBox& box = i < bestLeftCount ? bestLeft : bestRight;
+				box.grow(build.minBounds[items[i]], build.maxBounds[items[i]]);
+			}
+		}
+		else
+		{
+			if (bestCost >= leafCost && count <= build.maxLeafSize)
+			{
+				return false;
+			}
+			std::partition(items, items + count, [&](uint32_t item)
+				{
+					return binOf(build.centroids[item], bestAxis) < bestSplit;
+				});
+		}
+
+		left = { bestLeft.min, first, bestLeft.max, bestLeftCount, 0 };
+		right = { bestRight.min, first + bestLeftCount, bestRight.max, count - bestLeftCount, 0 };
+		return true;
+	}
+
+	// Builds the subtree of root with its children after it, child indices are local to nodes
+	static void buildSubtree(BvhBuild& build, const BvhNode& root, uint32_t rootDepth, std::vector<BvhNode>& nodes)
+	{
+		struct Pending
+		{
+			uint32_t node;
+			uint32_t depth;
+		};
+		std::vector<Pending> stack;
+		nodes.push_back(root);
+		stack.push_back({ 0, rootDepth });
+
+		while (!stack.empty())
+		{
+			Pending pending = stack.back();
+			stack.pop_back();
+
+			BvhNode left, right;
+			if (!splitNode(build, nodes[pending.node], pending.depth, nullptr, left, right))
+			{
+				continue;
+			}
+
+			uint32_t child = static_cast<uint32_t>(nodes.size());
+			nodes[pending.node].left = child;
+			nodes.push_back(left);
+			nodes.push_back(right);
+			stack.push_back({ child + 1, pending.depth + 1 });
+			stack.push_back({ child, pending.depth + 1 });
+		}
+	}
+
+	void Bvh::build(std::span<const glm::vec3> minBounds, std::span<const glm::vec3> maxBounds, uint32_t maxLeafSize, JobSystem* jobSystem)
+	{
+		clear();
+		const uint32_t count = static_cast<uint32_t>(minBounds.size());
+		if (count == 0)
+		{
+			return;
+		}
+
+		BvhBuild build;
+		build.minBounds = minBounds;
+		build.maxBounds = maxBounds;
+		build.maxLeafSize = std::max(maxLeafSize, 1u);
+		build.centroids.resize(count);
+		build.items.resize(count);
+
+		BvhBox rootBox;
+		reduceBatches(jobSystem, 0, count, rootBox, [&](uint32_t begin, uint32_t end, BvhBox& box)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					build.centroids[i] = (minBounds[i] + maxBounds[i]) * 0.5f;
+					build.items[i] = i;
+					box.grow(minBounds[i], maxBounds[i]);
+				}
+			},
+			[](BvhBox& box, const BvhBox& batchBox) { box.grow(batchBox); });
+
+		// the top of the tree is split with every worker binning the same node, until the nodes are small enough
+		// to be built whole by one worker
+		m_nodes.push_back({ rootBox.min, 0, rootBox.max, count, 0 });
+		std::vector<uint32_t> depths = { 0 };
+		std::vector<uint32_t> pending = { 0 };
+		std::vector<uint32_t> subtrees;
+		while (!pending.empty())
+		{
+			uint32_t index = pending.back();
+			pending.pop_back();
+			if (jobSystem == nullptr || m_nodes[index].itemCount <= BvhParallelItems)
+			{
+				subtrees.push_back(index);
+				continue;
+			}
+
+			BvhNode left, right;
+			if (!splitNode(build, m_nodes[index], depths[index], jobSystem, left, right))
+			{
+				continue;
+			}
+
+			uint32_t child = static_cast<uint32_t>(m_nodes.size());
+			m_nodes[index].left = child;
+			m_nodes.push_back(left);
+			m_nodes.push_back(right);
+			depths.push_back(depths[index] + 1);
+			depths.push_back(depths[index] + 1);
+			pending.push_back(child);
+			pending.push_back(child + 1);
+		}
+
+		std::vector<std::vector<BvhNode>> subtreeNodes(subtrees.size());
+		auto buildSubtrees = [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t s = begin; s < end; s++)
+				{
+					buildSubtree(build, m_nodes[subtrees[s]], depths[subtrees[s]], subtreeNodes[s]);
+				}
+			};
+		if (jobSystem != nullptr)
+		{
+			jobSystem->parallelFor(static_cast<uint32_t>(subtrees.size()), 1, buildSubtrees);
+		}
+		else
+		{
+			buildSubtrees(0, static_cast<uint32_t>(subtrees.size()));
+		}
+
+		// the subtree roots take the place of their top node, the rest is appended with the child indices moved
+		for (size_t s = 0; s < subtrees.size(); s++)
+		{
+			const std::vector<BvhNode>& nodes = subtreeNodes[s];
+			const uint32_t offset = static_cast<uint32_t>(m_nodes.size()) - 1;
+			auto relocate = [offset](BvhNode node)
+				{
+					node.left = node.left != 0 ? node.left + offset : 0;
+					return node;
+				};
+			m_nodes[subtrees[s]] = relocate(nodes[0]);
+			for (size_t n = 1; n < nodes.size(); n++)
+			{
+				m_nodes.push_back(relocate(nodes[n]));
+			}
+		}
+
+		m_items = std::move(build.items);
+		m_itemMin.resize(count);
+		m_itemMax.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			m_itemMin[i] = minBounds[m_items[i]];
+			m_itemMax[i] = maxBounds[m_items[i]];
+		}
+	}
+
+	void Bvh::refit(std::span<const glm::vec3> minBounds, std::span<const glm::vec3> maxBounds)
+	{
+		assert(minBounds.size() == m_items.size());
+		for (size_t i = 0; i < m_items.size(); i++)
+		{
+			m_itemMin[i] = minBounds[m_items[i]];
+			m_itemMax[i] = maxBounds[m_items[i]];
+		}
+
+		for (size_t n = m_nodes.size(); n-- > 0;)
+		{
+			BvhNode& node = m_nodes[n];
+			BvhBox box;
+			if (node.left == 0)
+			{
+				for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; i++)
+				{
+					box.grow(m_itemMin[i], m_itemMax[i]);
+				}
+			}
+			else
+			{
+				box.grow(m_nodes[node.left].min, m_nodes[node.left].max);
+				box.grow(m_nodes[node.left + 1].min, m_nodes[node.left + 1].max);
+			}
+			node.min = box.min;
+			node.max = box.max;
+		}
+	}
+
+	void Bvh::clear()
+	{
+		m_nodes.clear();
+		m_items.clear();
+		m_itemMin.clear();
+		m_itemMax.clear();
+	}
+
+	// Clears from planeMask the planes the box is inside of, false when it is outside one of them
+	static bool classifyBox(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max, uint32_t& planeMask)
+	{
+		const glm::vec3 center = (min + max) * 0.5f;
+		const glm::vec3 extents = (max - min) * 0.5f;
+		for (uint32_t mask = planeMask; mask != 0; mask &= mask - 1)
+		{
+			uint32_t p = std::countr_zero(mask);
+			const glm::vec4& plane = frustum.planes[p];
+			float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+			float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+			if (distance + radius < 0.f)
+			{
+				return false;
+			}
+			if (distance - radius >= 0.f)
+			{
+				planeMask &= ~(1u << p);
+			}
+		}
+		return true;
+	}
+
+	uint32_t Bvh::cullFrustum(const Frustum& frustum, std::vector<uint32_t>& items) const
+	{
+		if (m_nodes.empty())
+		{
+			return 0;
+		}
+
+		struct Entry
+		{
+			uint32_t node;
+			uint32_t planeMask;
+		};
+		Entry stack[BvhMaxDepth + 2];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = { 0, 0x3F };
+
+		uint32_t testedItems = 0;
+		while (stackSize > 0)
+		{
+			Entry entry = stack[--stackSize];
+			const BvhNode& node = m_nodes[entry.node];
+			if (!classifyBox(frustum, node.min, node.max, entry.planeMask))
+			{
+				continue;
+			}
+
+			if (entry.planeMask == 0)
+			{
+				items.insert(items.end(), m_items.begin() + node.firstItem, m_items.begin() + node.firstItem + node.itemCount);
+				continue;
+			}
+
+			if (node.left == 0)
+			{
+				for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; i++)
+				{
+					uint32_t planeMask = entry.planeMask;
+					if (classifyBox(frustum, m_itemMin[i], m_itemMax[i], planeMask))
+					{
+						items.push_back(m_items[i]);
+					}
+				}
+				testedItems += node.itemCount;
+				continue;
+			}
+
+			stack[stackSize++] = { node.left + 1, entry.planeMask };
+			stack[stackSize++] = { node.left, entry.planeMask };
+		}
+		return testedItems;
+	}
+
+	// Moller-Trumbore, the triangle is its first vertex and the two edges from it
+	static float intersectTriangle(const glm::vec3* triangle, const glm::vec3& origin, const glm::vec3& direction, float& u, float& v)
+	{
+		constexpr float miss = std::numeric_limits<float>::infinity();
+		const glm::vec3& edge1 = triangle[1];
+		const glm::vec3& edge2 = triangle[2];
+		glm::vec3 p = glm::cross(direction, edge2);
+		float determinant = glm::dot(edge1, p);
+		if (determinant == 0.f)
+		{
+			return miss;
+		}
+
+		float inverse = 1.f / determinant;
+		glm::vec3 s = origin - triangle[0];
+		u = glm::dot(s, p) * inverse;
+		if (u < 0.f || u > 1.f)
+		{
+			return miss;
+		}
+
+		glm::vec3 q = glm::cross(s, edge1);
+		v = glm::dot(direction, q) * inverse;
+		if (v < 0.f || u + v > 1.f)
+		{
+			return miss;
+		}
+
+		float distance = glm::dot(edge2, q) * inverse;
+		return distance >= 0.f ? distance : miss;
+	}
+
+	void TriangleBvh::build(std::span<const uint32_t> indices, std::span<const Vertex> vertices, JobSystem* jobSystem)
+	{
+		const size_t triangleCount = indices.size() / 3;
+		m_vertices.resize(triangleCount * 3);
+		std::vector<glm::vec3> minBounds(triangleCount);
+		std::vector<glm::vec3> maxBounds(triangleCount);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			const glm::vec3& p0 = vertices[indices[t * 3 + 0]].position;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+			m_vertices[t * 3 + 0] = p0;
+			m_vertices[t * 3 + 1] = p1 - p0;
+			m_vertices[t * 3 + 2] = p2 - p0;
+			minBounds[t] = glm::min(p0, glm::min(p1, p2));
+			maxBounds[t] = glm::max(p0, glm::max(p1, p2));
+		}
+		m_bvh.build(minBounds, maxBounds, TriangleBvhLeafSize, jobSystem);
+	}
+
+	bool TriangleBvh::intersectRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TriangleHit& hit) const
+	{
+		float distance = m_bvh.intersectRay(origin, direction, maxDistance, false, [&](uint32_t triangle, float closest)
+			{
+				float u, v;
+				float triangleDistance = intersectTriangle(&m_vertices[triangle * 3], origin, direction, u, v);
+				if (triangleDistance < closest)
+				{
+					hit.triangle = triangle;
+					hit.u = u;
+					hit.v = v;
+				}
+				return triangleDistance;
+			});
+		if (distance >= maxDistance)
+		{
+			return false;
+		}
+		hit.distance = distance;
+		return true;
+	}
+
+	bool TriangleBvh::intersectsRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+	{
+		float distance = m_bvh.intersectRay(origin, direction, maxDistance, true, [&](uint32_t triangle, float)
+			{
+				float u, v;
+				return intersectTriangle(&m_vertices[triangle * 3], origin, direction, u, v);
+			});
+		return distance < maxDistance;
+	}
+
+	std::shared_ptr<const TriangleBvh> buildTriangleBvh(const ImportedMesh& mesh, const ImportedSurface& surface, JobSystem* jobSystem)
+	{
+		if (surface.count < 3)
+		{
+			return nullptr;
+		}
+
+		std::shared_ptr<TriangleBvh> bvh = std::make_shared<TriangleBvh>();
+		bvh->build(mesh.indices.subspan(surface.startIndex, surface.count), mesh.vertices, jobSystem);
+		return bvh;
+	}
+
+	void runBvhBenchmark()
+	{
+		using Clock = std::chrono::high_resolution_clock;
+		auto elapsed = [](Clock::time_point start)
+			{
+				return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+			};
+
+		JobSystem jobSystem;
+		jobSystem.init();
+		std::cout << "BVH benchmark (" << jobSystem.getWorkerCount() + 1 << " threads)" << std::endl;
+
+		glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+		glm::mat4 projection = glm::perspective(glm::radians(70.f), 16.f / 9.f, 10000.f, 0.1f);
+		projection[1][1] *= -1;
+		Frustum frustum = extractFrustum(projection * view);
+
+		for (uint32_t objectCount : { 10000u, 100000u, 1000000u })
+		{
+			std::mt19937 rng(objectCount);
+			std::uniform_real_distribution<float> position(-500.f, 500.f);
+			std::uniform_real_distribution<float> size(0.5f, 5.f);
+
+			CullingBounds bounds;
+			std::vector<glm::vec3> minBounds(objectCount);
+			std::vector<glm::vec3> maxBounds(objectCount);
+			bounds.reserve(objectCount);
+			for (uint32_t i = 0; i < objectCount; i++)
+			{
+				Bounds box{ glm::vec3(0.f), 0.f, glm::vec3(size(rng), size(rng), size(rng)) };
+				glm::vec3 center(position(rng), position(rng), position(rng));
+				bounds.pushBack(box, glm::translate(center));
+				minBounds[i] = center - box.extents;
+				maxBounds[i] = center + box.extents;
+			}
+
+			Bvh bvh;
+			auto start = Clock::now();
+			bvh.build(minBounds, maxBounds, 4);
+			float buildTime = elapsed(start);
+			start = Clock::now();
+			bvh.build(minBounds, maxBounds, 4, &jobSystem);
+			float threadedBuildTime = elapsed(start);
+			start = Clock::now();
+			bvh.refit(minBounds, maxBounds);
+			float refitTime = elapsed(start);
+
+			std::vector<uint32_t> visible;
+			visible.reserve(objectCount);
+			start = Clock::now();
+			cullBounds(bounds, frustum, visible);
+			float linearTime = elapsed(start);
+			size_t linearCount = visible.size();
+
+			visible.clear();
+			start = Clock::now();
+			uint32_t tested = bvh.cullFrustum(frustum, visible);
+			float bvhTime = elapsed(start);
+
+			std::cout << objectCount << " objects: build " << buildTime << " ms, threaded " << threadedBuildTime << " ms, refit " << refitTime
+				<< " ms, cullBounds " << linearTime << " ms (" << linearCount << " visible), BVH " << bvhTime << " ms ("
+				<< visible.size() << " visible, " << tested << " tested)" << std::endl;
+		}
+
+		// a displaced grid of 2M triangles, rays cast down on it from random points above
+		constexpr uint32_t gridSize = 1024;
+		std::vector<Vertex> vertices((gridSize + 1) * (gridSize + 1));
+		for (uint32_t y = 0; y <= gridSize; y++)
+		{
+			for (uint32_t x = 0; x <= gridSize; x++)
+			{
+				Vertex& vertex = vertices[y * (gridSize + 1) + x];
+				vertex = {};
+				vertex.position = glm::vec3(float(x), std::sin(x * 0.05f) * std::cos(y * 0.07f) * 10.f, float(y));
+			}
+		}
+		std::vector<uint32_t> indices;
+		indices.reserve(gridSize * gridSize * 6);
+		for (uint32_t y = 0; y < gridSize; y++)
+		{
+			for (uint32_t x = 0; x < gridSize; x++)
+			{
+				uint32_t corner = y * (gridSize + 1) + x;
+				indices.insert(indices.end(), { corner, corner + gridSize + 1, corner + 1, corner + 1, corner + gridSize + 1, corner + gridSize + 2 });
+			}
+		}
+
+		TriangleBvh triangles;
+		auto start = Clock::now();
+		triangles.build(indices, vertices, &jobSystem);
+		float buildTime = elapsed(start);
+
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> coordinate(0.f, float(gridSize));
+		std::uniform_real_distribution<float> slope(-0.5f, 0.5f);
+		constexpr uint32_t rayCount = 100000;
+		std::vector<glm::vec3> origins(rayCount);
+		std::vector<glm::vec3> directions(rayCount);
+		for (uint32_t r = 0; r < rayCount; r++)
+		{
+			origins[r] = glm::vec3(coordinate(rng), 50.f, coordinate(rng));
+			directions[r] = glm::normalize(glm::vec3(slope(rng), -1.f, slope(rng)));
+		}
+
+		uint32_t hitCount = 0;
+		start = Clock::now();
+		for (uint32_t r = 0; r < rayCount; r++)
+		{
+			TriangleHit hit;
+			hitCount += triangles.intersectRay(origins[r], directions[r], 1000.f, hit);
+		}
+		float nearestTime = elapsed(start);
+
+		uint32_t occludedCount = 0;
+		start = Clock::now();
+		for (uint32_t r = 0; r < rayCount; r++)
+		{
+			occludedCount += triangles.intersectsRay(origins[r], directions[r], 1000.f);
+		}
+		float anyTime = elapsed(start);
+
+		std::cout << triangles.getTriangleCount() << " triangles: build " << buildTime << " ms, " << rayCount << " nearest hit rays "
+			<< nearestTime << " ms (" << hitCount << " hits), any hit " << anyTime << " ms (" << occludedCount << " hits)" << std::endl;
+	}
+}
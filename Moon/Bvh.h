@@ -0,0 +1,169 @@
+#pragma once
+#include "Culling.h"
+#include "SceneImport.h"
+
+#include <limits>
+
+namespace Moon
+{
+	//Forward declaration
+	class JobSystem;
+
+	struct BvhNode
+	{
+		glm::vec3 min;
+		uint32_t firstItem; // the items of a subtree are contiguous in Bvh::getItems
+		glm::vec3 max;
+		uint32_t itemCount;
+		uint32_t left; // children at left and left + 1, 0 for a leaf
+	};
+
+	// deeper nodes are made leaves whatever their size, so the traversals can use a fixed stack
+	constexpr uint32_t BvhMaxDepth = 48;
+
+	// Entry distance of the ray in the box, infinity when it misses. inverseDirection is 1 / direction.
+	inline float intersectRayBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& inverseDirection)
+	{
+		glm::vec3 t0 = (min - origin) * inverseDirection;
+		glm::vec3 t1 = (max - origin) * inverseDirection;
+		glm::vec3 entries = glm::min(t0, t1);
+		glm::vec3 exits = glm::max(t0, t1);
+		float enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.f));
+		float exit = std::min(std::min(exits.x, exits.y), exits.z);
+		return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+	}
+
+	// Bounding volume hierarchy over boxes, built top down with a binned surface area heuristic. The top nodes bin
+	// their items on every job system worker, then the subtrees below are built one per worker.
+	// Children are stored after their parent, so a refit walks the nodes backwards.
+	class Bvh
+	{
+	public:
+		void build(std::span<const glm::vec3> minBounds, std::span<const glm::vec3> maxBounds, uint32_t maxLeafSize, JobSystem* jobSystem = nullptr);
+		// new boxes for the same items, the tree is kept and its boxes grown or shrunk to them
+		void refit(std::span<const glm::vec3> minBounds, std::span<const glm::vec3> maxBounds);
+		void clear();
+
+		// Appends the items whose box intersects the frustum. A node inside a plane does not test it again below,
+		// the whole subtree of a node inside every plane is taken without testing its items. Returns the number of
+		// items tested one by one.
+		uint32_t cullFrustum(const Frustum& frustum, std::vector<uint32_t>& items) const;
+
+		// Walks the nodes the ray enters before the closest hit so far, nearest first. hitItem(item, maxDistance)
+		// returns the distance of its hit or at least maxDistance when it misses. anyHit stops at the first hit.
+		// Returns the distance of the closest hit, maxDistance when nothing is hit.
+		template<typename HitItem>
+		float intersectRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, bool anyHit, HitItem&& hitItem) const;
+
+		std::span<const BvhNode> getNodes() const { return m_nodes; }
+		std::span<const uint32_t> getItems() const { return m_items; }
+		bool empty() const { return m_nodes.empty(); }
+
+	private:
+		std::vector<BvhNode> m_nodes;
+		std::vector<uint32_t> m_items; // item indices in leaf order
+		std::vector<glm::vec3> m_itemMin; // item boxes in leaf order, for the leaf tests
+		std::vector<glm::vec3> m_itemMax;
+	};
+
+	template<typename HitItem>
+	float Bvh::intersectRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, bool anyHit, HitItem&& hitItem) const
+	{
+		if (m_nodes.empty())
+		{
+			return maxDistance;
+		}
+
+		const glm::vec3 inverseDirection = 1.f / direction;
+		float closest = maxDistance;
+
+		struct Entry
+		{
+			uint32_t node;
+			float distance;
+		};
+		Entry stack[BvhMaxDepth + 2];
+		uint32_t stackSize = 0;
+
+		float rootDistance = intersectRayBox(m_nodes[0].min, m_nodes[0].max, origin, inverseDirection);
+		if (rootDistance < closest)
+		{
+			stack[stackSize++] = { 0, rootDistance };
+		}
+
+		while (stackSize > 0)
+		{
+			Entry entry = stack[--stackSize];
+			if (entry.distance >= closest)
+			{
+				continue;
+			}
+
+			const BvhNode& node = m_nodes[entry.node];
+			if (node.left == 0)
+			{
+				for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; i++)
+				{
+					float distance = hitItem(m_items[i], closest);
+					if (distance < closest)
+					{
+						closest = distance;
+						if (anyHit)
+						{
+							return closest;
+						}
+					}
+				}
+				continue;
+			}
+
+			// the farther child goes on the stack first so the nearer one is visited first
+			Entry left = { node.left, intersectRayBox(m_nodes[node.left].min, m_nodes[node.left].max, origin, inverseDirection) };
+			Entry right = { node.left + 1, intersectRayBox(m_nodes[node.left + 1].min, m_nodes[node.left + 1].max, origin, inverseDirection) };
+			if (left.distance < right.distance)
+			{
+				std::swap(left, right);
+			}
+			if (left.distance < closest)
+			{
+				stack[stackSize++] = left;
+			}
+			if (right.distance < closest)
+			{
+				stack[stackSize++] = right;
+			}
+		}
+		return closest;
+	}
+
+	struct TriangleHit
+	{
+		float distance; // in units of the ray direction
+		uint32_t triangle; // in the index range of the surface
+		float u, v; // barycentric coordinates of the hit on the second and third vertices
+	};
+
+	// Object space triangles of a surface for ray queries: picking, line of sight
+	class TriangleBvh
+	{
+	public:
+		void build(std::span<const uint32_t> indices, std::span<const Vertex> vertices, JobSystem* jobSystem = nullptr);
+
+		// nearest triangle along origin + distance * direction, both sides of the triangles are hit
+		bool intersectRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TriangleHit& hit) const;
+		// whether any triangle is hit before maxDistance
+		bool intersectsRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+		size_t getTriangleCount() const { return m_vertices.size() / 3; }
+
+	private:
+		Bvh m_bvh;
+		std::vector<glm::vec3> m_vertices; // first vertex and the two edges from it, per triangle
+	};
+
+	// Triangle hierarchy of the full detail range of a surface, null when it has no triangles
+	std::shared_ptr<const TriangleBvh> buildTriangleBvh(const ImportedMesh& mesh, const ImportedSurface& surface, JobSystem* jobSystem = nullptr);
+
+	// Compares the BVH traversals with cullBounds and a linear ray walk on synthetic scenes
+	void runBvhBenchmark();
+}
@@ -0,0 +1,600 @@
+#include "Culling.h"
+#include "Bvh.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+
+#include <glm/gtx/transform.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MOON_CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MOON_CULLING_SSE
+#endif
+
+namespace Moon
+{
+	// below this many objects per batch threading costs more than it saves
+	constexpr uint32_t CULLING_BATCH_SIZE = 16384;
+	// rotation of the frustum planes (radians) the temporal culling margins allow before a rebuild, the translation
+	// allowed is the arc of this angle at the average object distance
+	constexpr float TemporalAngleMargin = 0.02f;
+
+	Frustum extractFrustum(const glm::mat4& viewProj)
+	{
+		glm::vec4 row0 = { viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0] };
+		glm::vec4 row1 = { viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1] };
+		glm::vec4 row2 = { viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2] };
+		glm::vec4 row3 = { viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3] };
+
+		// vulkan clip volume: -w <= x,y <= w and 0 <= z <= w
+		Frustum frustum;
+		frustum.planes[0] = row3 + row0;
+		frustum.planes[1] = row3 - row0;
+		frustum.planes[2] = row3 + row1;
+		frustum.planes[3] = row3 - row1;
+		frustum.planes[4] = row2;
+		frustum.planes[5] = row3 - row2;
+
+		for (glm::vec4& plane : frustum.planes)
+		{
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+	}
+
+	void CullingBounds::clear()
+	{
+		centerX.clear(); centerY.clear(); centerZ.clear();
+		extentX.clear(); extentY.clear(); extentZ.clear();
+		radius.clear();
+	}
+
+	void CullingBounds::reserve(size_t count)
+	{
+		centerX.reserve(count); centerY.reserve(count); centerZ.reserve(count);
+		extentX.reserve(count); extentY.reserve(count); extentZ.reserve(count);
+		radius.reserve(count);
+	}
+
+	void CullingBounds::pushBack(const Bounds& localBounds, const glm::mat4& transform)
+	{
+		centerX.push_back(0.f); centerY.push_back(0.f); centerZ.push_back(0.f);
+		extentX.push_back(0.f); extentY.push_back(0.f); extentZ.push_back(0.f);
+		radius.push_back(0.f);
+		set(size() - 1, localBounds, transform);
+	}
+
+	void CullingBounds::set(size_t index, const Bounds& localBounds, const glm::mat4& transform)
+	{
+		// transform the box center and take the extents of the rotated box along the world axes
+		glm::vec3 center = glm::vec3(transform * glm::vec4(localBounds.origin, 1.f));
+		glm::vec3 extents = glm::abs(glm::vec3(transform[0])) * localBounds.extents.x
+			+ glm::abs(glm::vec3(transform[1])) * localBounds.extents.y
+			+ glm::abs(glm::vec3(transform[2])) * localBounds.extents.z;
+
+		centerX[index] = center.x; centerY[index] = center.y; centerZ[index] = center.z;
+		extentX[index] = extents.x; extentY[index] = extents.y; extentZ[index] = extents.z;
+		radius[index] = glm::length(extents);
+	}
+
+	void CullingBounds::swapRemove(size_t index)
+	{
+		size_t last = size() - 1;
+		centerX[index] = centerX[last]; centerY[index] = centerY[last]; centerZ[index] = centerZ[last];
+		extentX[index] = extentX[last]; extentY[index] = extentY[last]; extentZ[index] = extentZ[last];
+		radius[index] = radius[last];
+
+		centerX.pop_back(); centerY.pop_back(); centerZ.pop_back();
+		extentX.pop_back(); extentY.pop_back(); extentZ.pop_back();
+		radius.pop_back();
+	}
+
+	// Box against plane: the box is outside when even its most positive corner is behind the plane
+	static float boxPlaneDistance(const CullingBounds& bounds, uint32_t i, const glm::vec4& plane)
+	{
+		return plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i] + plane.z * bounds.centerZ[i] + plane.w
+			+ std::abs(plane.x) * bounds.extentX[i] + std::abs(plane.y) * bounds.extentY[i] + std::abs(plane.z) * bounds.extentZ[i];
+	}
+
+	static bool isBoxInFrustum(const CullingBounds& bounds, uint32_t i, const Frustum& frustum)
+	{
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			if (boxPlaneDistance(bounds, i, plane) < 0.f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static uint32_t cullRangeScalar(const CullingBounds& bounds, const Frustum& frustum, uint32_t begin, uint32_t end, uint32_t* output)
+	{
+		uint32_t count = 0;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			if (isBoxInFrustum(bounds, i, frustum))
+			{
+				output[count++] = i;
+			}
+		}
+		return count;
+	}
+
+#if defined(MOON_CULLING_AVX)
+	static uint32_t cullRange(const CullingBounds& bounds, const Frustum& frustum, uint32_t begin, uint32_t end, uint32_t* output)
+	{
+		__m256 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+		for (int p = 0; p < 6; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			nx[p] = _mm256_set1_ps(plane.x); ax[p] = _mm256_set1_ps(std::abs(plane.x));
+			ny[p] = _mm256_set1_ps(plane.y); ay[p] = _mm256_set1_ps(std::abs(plane.y));
+			nz[p] = _mm256_set1_ps(plane.z); az[p] = _mm256_set1_ps(std::abs(plane.z));
+			nw[p] = _mm256_set1_ps(plane.w);
+		}
+
+		const __m256 zero = _mm256_setzero_ps();
+		uint32_t count = 0;
+		uint32_t i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 cx = _mm256_loadu_ps(&bounds.centerX[i]);
+			__m256 cy = _mm256_loadu_ps(&bounds.centerY[i]);
+			__m256 cz = _mm256_loadu_ps(&bounds.centerZ[i]);
+			__m256 ex = _mm256_loadu_ps(&bounds.extentX[i]);
+			__m256 ey = _mm256_loadu_ps(&bounds.extentY[i]);
+			__m256 ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+
+			__m256 outside = zero;
+			for (int p = 0; p < 6; p++)
+			{
+#if defined(__AVX2__)
+				__m256 distance = _mm256_fmadd_ps(nx[p], cx, nw[p]);
+				distance = _mm256_fmadd_ps(ny[p], cy, distance);
+				distance = _mm256_fmadd_ps(nz[p], cz, distance);
+				distance = _mm256_fmadd_ps(ax[p], ex, distance);
+				distance = _mm256_fmadd_ps(ay[p], ey, distance);
+				distance = _mm256_fmadd_ps(az[p], ez, distance);
+#else
+				__m256 distance = _mm256_add_ps(_mm256_mul_ps(nx[p], cx), nw[p]);
+				distance = _mm256_add_ps(_mm256_mul_ps(ny[p], cy), distance);
+				distance = _mm256_add_ps(_mm256_mul_ps(nz[p], cz), distance);
+				distance = _mm256_add_ps(_mm256_mul_ps(ax[p], ex), distance);
+				distance = _mm256_add_ps(_mm256_mul_ps(ay[p], ey), distance);
+				distance = _mm256_add_ps(_mm256_mul_ps(az[p], ez), distance);
+#endif
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, zero, _CMP_LT_OQ));
+			}
+
+			uint32_t visibleMask = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xFF;
+			while (visibleMask)
+			{
+				output[count++] = i + std::countr_zero(visibleMask);
+				visibleMask &= visibleMask - 1;
+			}
+		}
+
+		return count + cullRangeScalar(bounds, frustum, i, end, output + count);
+	}
+#elif defined(MOON_CULLING_SSE)
+	static uint32_t cullRange(const CullingBounds& bounds, const Frustum& frustum, uint32_t begin, uint32_t end, uint32_t* output)
+	{
+		__m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+		for (int p = 0; p < 6; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			nx[p] = _mm_set1_ps(plane.x); ax[p] = _mm_set1_ps(std::abs(plane.x));
+			ny[p] = _mm_set1_ps(plane.y); ay[p] = _mm_set1_ps(std::abs(plane.y));
+			nz[p] = _mm_set1_ps(plane.z); az[p] = _mm_set1_ps(std::abs(plane.z));
+			nw[p] = _mm_set1_ps(plane.w);
+		}
+
+		const __m128 zero = _mm_setzero_ps();
+		uint32_t count = 0;
+		uint32_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+			__m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+			__m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+			__m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+			__m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+			__m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+
+			__m128 outside = zero;
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_mul_ps(nx[p], cx), nw[p]);
+				distance = _mm_add_ps(_mm_mul_ps(ny[p], cy), distance);
+				distance = _mm_add_ps(_mm_mul_ps(nz[p], cz), distance);
+				distance = _mm_add_ps(_mm_mul_ps(ax[p], ex), distance);
+				distance = _mm_add_ps(_mm_mul_ps(ay[p], ey), distance);
+				distance = _mm_add_ps(_mm_mul_ps(az[p], ez), distance);
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+			}
+
+			uint32_t visibleMask = ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xF;
+			while (visibleMask)
+			{
+				output[count++] = i + std::countr_zero(visibleMask);
+				visibleMask &= visibleMask - 1;
+			}
+		}
+
+		return count + cullRangeScalar(bounds, frustum, i, end, output + count);
+	}
+#else
+	static uint32_t cullRange(const CullingBounds& bounds, const Frustum& frustum, uint32_t begin, uint32_t end, uint32_t* output)
+	{
+		return cullRangeScalar(bounds, frustum, begin, end, output);
+	}
+#endif
+
+	// Appends the indices kernel(begin, end, output) keeps to visibleIndices, in batches over the job system workers
+	template<typename Kernel>
+	static void cullBatches(uint32_t count, std::vector<uint32_t>& visibleIndices, JobSystem* jobSystem, const Kernel& kernel)
+	{
+		const size_t outputStart = visibleIndices.size();
+		visibleIndices.resize(outputStart + count);
+		uint32_t* output = visibleIndices.data() + outputStart;
+
+		if (jobSystem == nullptr || count <= CULLING_BATCH_SIZE)
+		{
+			uint32_t visibleCount = kernel(0, count, output);
+			visibleIndices.resize(outputStart + visibleCount);
+			return;
+		}
+
+		// every batch compacts its results at the start of its own range, then the ranges are packed together in order
+		const uint32_t batchCount = (count + CULLING_BATCH_SIZE - 1) / CULLING_BATCH_SIZE;
+		std::vector<uint32_t> batchCounts(batchCount, 0);
+		jobSystem->parallelFor(batchCount, 1, [&](uint32_t firstBatch, uint32_t lastBatch)
+			{
+				for (uint32_t batch = firstBatch; batch < lastBatch; batch++)
+				{
+					uint32_t begin = batch * CULLING_BATCH_SIZE;
+					uint32_t end = std::min(begin + CULLING_BATCH_SIZE, count);
+					batchCounts[batch] = kernel(begin, end, output + begin);
+				}
+			});
+
+		uint32_t visibleCount = batchCounts[0];
+		for (uint32_t batch = 1; batch < batchCount; batch++)
+		{
+			memmove(output + visibleCount, output + batch * CULLING_BATCH_SIZE, batchCounts[batch] * sizeof(uint32_t));
+			visibleCount += batchCounts[batch];
+		}
+		visibleIndices.resize(outputStart + visibleCount);
+	}
+
+	// Distance of every box to the plane it is nearest to, or most behind when it is outside, and of the farthest point
+	// of its bounding sphere to the camera. A visible box leaves the frustum through the first plane, a hidden one enters
+	// it once it is in front of the second.
+	static void measureRange(const CullingBounds& bounds, const Frustum& frustum, const glm::vec3& cameraPosition, uint32_t begin, uint32_t end,
+		float* distances, float* reach)
+	{
+		uint32_t i = begin;
+#if defined(MOON_CULLING_AVX) || defined(MOON_CULLING_SSE)
+		__m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+		for (int p = 0; p < 6; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			nx[p] = _mm_set1_ps(plane.x); ax[p] = _mm_set1_ps(std::abs(plane.x));
+			ny[p] = _mm_set1_ps(plane.y); ay[p] = _mm_set1_ps(std::abs(plane.y));
+			nz[p] = _mm_set1_ps(plane.z); az[p] = _mm_set1_ps(std::abs(plane.z));
+			nw[p] = _mm_set1_ps(plane.w);
+		}
+		const __m128 camX = _mm_set1_ps(cameraPosition.x);
+		const __m128 camY = _mm_set1_ps(cameraPosition.y);
+		const __m128 camZ = _mm_set1_ps(cameraPosition.z);
+
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+			__m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+			__m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+			__m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+			__m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+			__m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+
+			__m128 nearest = _mm_set1_ps(std::numeric_limits<float>::max());
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_mul_ps(nx[p], cx), nw[p]);
+				distance = _mm_add_ps(_mm_mul_ps(ny[p], cy), distance);
+				distance = _mm_add_ps(_mm_mul_ps(nz[p], cz), distance);
+				distance = _mm_add_ps(_mm_mul_ps(ax[p], ex), distance);
+				distance = _mm_add_ps(_mm_mul_ps(ay[p], ey), distance);
+				distance = _mm_add_ps(_mm_mul_ps(az[p], ez), distance);
+				nearest = _mm_min_ps(nearest, distance);
+			}
+			_mm_storeu_ps(distances + i, nearest);
+
+			__m128 dx = _mm_sub_ps(cx, camX);
+			__m128 dy = _mm_sub_ps(cy, camY);
+			__m128 dz = _mm_sub_ps(cz, camZ);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+			_mm_storeu_ps(reach + i, _mm_add_ps(length, _mm_loadu_ps(&bounds.radius[i])));
+		}
+#endif
+		for (; i < end; i++)
+		{
+			float nearest = std::numeric_limits<float>::max();
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				nearest = std::min(nearest, boxPlaneDistance(bounds, i, plane));
+			}
+
+			glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+			distances[i] = nearest;
+			reach[i] = glm::length(center - cameraPosition) + bounds.radius[i];
+		}
+	}
+
+	void cullBounds(const CullingBounds& bounds, const Frustum& frustum, std::vector<uint32_t>& visibleIndices, JobSystem* jobSystem)
+	{
+		cullBatches(static_cast<uint32_t>(bounds.size()), visibleIndices, jobSystem, [&](uint32_t begin, uint32_t end, uint32_t* output)
+			{
+				return cullRange(bounds, frustum, begin, end, output);
+			});
+	}
+
+	void TemporalCuller::cull(const CullingBounds& bounds, uint64_t version, const Frustum& frustum, const glm::vec3& cameraPosition,
+		std::vector<uint32_t>& visibleIndices, JobSystem* jobSystem, const Bvh* bvh)
+	{
+		m_retestedCount = static_cast<uint32_t>(bounds.size());
+
+		// a reference built for bounds that keep moving would be thrown away every frame
+		if (version != m_lastVersion)
+		{
+			m_lastVersion = version;
+			m_referenceVersion = ~0ull;
+			if (bvh != nullptr)
+			{
+				m_retestedCount = bvh->cullFrustum(frustum, visibleIndices);
+			}
+			else
+			{
+				cullBounds(bounds, frustum, visibleIndices, jobSystem);
+			}
+			return;
+		}
+
+		// around the camera c a plane n.p + w moving to n'.p + w' shifts by at most |(n' - n).c + w' - w| + |n' - n| * |p - c|,
+		// the same bound holds for the extents term of the box distance with |e| the radius
+		float translation = 0.f;
+		float rotation = 0.f;
+		for (int p = 0; p < 6; p++)
+		{
+			glm::vec4 delta = frustum.planes[p] - m_reference.planes[p];
+			translation = std::max(translation, std::abs(glm::dot(glm::vec3(delta), cameraPosition) + delta.w));
+			rotation = std::max(rotation, glm::length(glm::vec3(delta)));
+		}
+		// the reaches are measured from the reference camera
+		translation += rotation * glm::length(cameraPosition - m_referenceCamera);
+
+		if (version != m_referenceVersion || rotation > TemporalAngleMargin || translation > m_moveLimit)
+		{
+			rebuild(bounds, frustum, cameraPosition, jobSystem);
+			m_referenceVersion = version;
+		}
+		else
+		{
+			m_retestedCount = static_cast<uint32_t>(m_boundary.size());
+		}
+
+		const uint32_t boundaryCount = static_cast<uint32_t>(m_boundary.size());
+		m_boundaryVisible.resize(boundaryCount);
+		auto testBoundary = [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t b = begin; b < end; b++)
+				{
+					m_boundaryVisible[b] = isBoxInFrustum(bounds, m_boundary[b], frustum);
+				}
+			};
+		if (jobSystem != nullptr && boundaryCount > CULLING_BATCH_SIZE)
+		{
+			jobSystem->parallelFor(boundaryCount, CULLING_BATCH_SIZE, testBoundary);
+		}
+		else
+		{
+			testBoundary(0, boundaryCount);
+		}
+
+		// both lists are in increasing order
+		visibleIndices.reserve(visibleIndices.size() + m_inside.size() + m_boundary.size());
+		size_t inside = 0;
+		for (uint32_t b = 0; b < boundaryCount; b++)
+		{
+			while (inside < m_inside.size() && m_inside[inside] < m_boundary[b])
+			{
+				visibleIndices.push_back(m_inside[inside++]);
+			}
+			if (m_boundaryVisible[b])
+			{
+				visibleIndices.push_back(m_boundary[b]);
+			}
+		}
+		visibleIndices.insert(visibleIndices.end(), m_inside.begin() + inside, m_inside.end());
+	}
+
+	void TemporalCuller::rebuild(const CullingBounds& bounds, const Frustum& frustum, const glm::vec3& cameraPosition, JobSystem* jobSystem)
+	{
+		m_reference = frustum;
+		m_referenceCamera = cameraPosition;
+
+		const uint32_t count = static_cast<uint32_t>(bounds.size());
+		m_distances.resize(count);
+		m_reach.resize(count);
+		auto measure = [&](uint32_t begin, uint32_t end)
+			{
+				measureRange(bounds, frustum, cameraPosition, begin, end, m_distances.data(), m_reach.data());
+			};
+		if (jobSystem != nullptr && count > CULLING_BATCH_SIZE)
+		{
+			jobSystem->parallelFor(count, CULLING_BATCH_SIZE, measure);
+		}
+		else
+		{
+			measure(0, count);
+		}
+
+		double reachSum = 0.0;
+		for (float reach : m_reach)
+		{
+			reachSum += reach;
+		}
+		m_moveLimit = count > 0 ? TemporalAngleMargin * static_cast<float>(reachSum / count) : 0.f;
+
+		// the objects the allowed movement can carry across a plane
+		m_inside.clear();
+		m_boundary.clear();
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (std::abs(m_distances[i]) <= m_moveLimit + TemporalAngleMargin * m_reach[i])
+			{
+				m_boundary.push_back(i);
+			}
+			else if (m_distances[i] > 0.f)
+			{
+				m_inside.push_back(i);
+			}
+		}
+	}
+
+	bool isVisible(const RenderObject& obj, const glm::mat4& viewProj)
+	{
+		std::array<glm::vec3, 8> corners
+		{
+		   glm::vec3 { 1, 1, 1 },
+		   glm::vec3 { 1, 1, -1 },
+		   glm::vec3 { 1, -1, 1 },
+		   glm::vec3 { 1, -1, -1 },
+		   glm::vec3 { -1, 1, 1 },
+		   glm::vec3 { -1, 1, -1 },
+		   glm::vec3 { -1, -1, 1 },
+		   glm::vec3 { -1, -1, -1 },
+		};
+
+		glm::mat4 matrix = viewProj * obj.transform;
+
+		glm::vec3 min = { 1.5, 1.5, 1.5 };
+		glm::vec3 max = { -1.5, -1.5, -1.5 };
+
+		for (int c = 0; c < 8; c++)
+		{
+			// project each corner into clip space
+			glm::vec4 v = matrix * glm::vec4(obj.bounds.origin + (corners[c] * obj.bounds.extents), 1.f);
+
+			// perspective correction
+			v.x = v.x / v.w;
+			v.y = v.y / v.w;
+			v.z = v.z / v.w;
+
+			min = glm::min(glm::vec3{ v.x, v.y, v.z }, min);
+			max = glm::max(glm::vec3{ v.x, v.y, v.z }, max);
+		}
+
+		// check the clip space box is within the view
+		if (min.z > 1.f || max.z < 0.f || min.x > 1.f || max.x < -1.f || min.y > 1.f || max.y < -1.f)
+		{
+			return false;
+		}
+		else
+		{
+			return true;
+		}
+	}
+
+	void runCullingBenchmark()
+	{
+		using Clock = std::chrono::high_resolution_clock;
+
+		JobSystem jobSystem;
+		jobSystem.init();
+
+		glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+		glm::mat4 projection = glm::perspective(glm::radians(70.f), 16.f / 9.f, 10000.f, 0.1f);
+		projection[1][1] *= -1;
+		glm::mat4 viewProj = projection * view;
+		Frustum frustum = extractFrustum(viewProj);
+		// the same camera turned by half a degree, for the temporal culling
+		Frustum turnedFrustum = extractFrustum(projection * glm::rotate(glm::radians(0.5f), glm::vec3(0.f, 1.f, 0.f)) * view);
+
+		std::cout << "Culling benchmark (" << jobSystem.getWorkerCount() + 1 << " threads)" << std::endl;
+		for (uint32_t objectCount : { 10000u, 100000u, 1000000u })
+		{
+			std::mt19937 rng(objectCount);
+			std::uniform_real_distribution<float> position(-500.f, 500.f);
+			std::uniform_real_distribution<float> size(0.5f, 5.f);
+
+			std::vector<RenderObject> objects(objectCount);
+			CullingBounds bounds;
+			bounds.reserve(objectCount);
+			for (RenderObject& obj : objects)
+			{
+				obj.bounds.origin = glm::vec3(0.f);
+				obj.bounds.extents = glm::vec3(size(rng), size(rng), size(rng));
+				obj.bounds.sphereRadius = glm::length(obj.bounds.extents);
+				obj.transform = glm::translate(glm::vec3(position(rng), position(rng), position(rng)));
+				bounds.pushBack(obj.bounds, obj.transform);
+			}
+
+			std::vector<uint32_t> visible;
+			visible.reserve(objectCount);
+
+			auto start = Clock::now();
+			for (uint32_t i = 0; i < objectCount; i++)
+			{
+				if (isVisible(objects[i], viewProj))
+				{
+					visible.push_back(i);
+				}
+			}
+			auto end = Clock::now();
+			float referenceTime = std::chrono::duration<float, std::milli>(end - start).count();
+			size_t referenceCount = visible.size();
+
+			visible.clear();
+			start = Clock::now();
+			cullBounds(bounds, frustum, visible);
+			end = Clock::now();
+			float singleThreadTime = std::chrono::duration<float, std::milli>(end - start).count();
+
+			visible.clear();
+			start = Clock::now();
+			cullBounds(bounds, frustum, visible, &jobSystem);
+			end = Clock::now();
+			float multiThreadTime = std::chrono::duration<float, std::milli>(end - start).count();
+
+			// the first cull only records the version, the second builds the reference
+			TemporalCuller temporalCuller;
+			for (int i = 0; i < 2; i++)
+			{
+				visible.clear();
+				temporalCuller.cull(bounds, 0, frustum, glm::vec3(0.f), visible, &jobSystem);
+			}
+			visible.clear();
+			start = Clock::now();
+			temporalCuller.cull(bounds, 0, turnedFrustum, glm::vec3(0.f), visible, &jobSystem);
+			end = Clock::now();
+			float temporalTime = std::chrono::duration<float, std::milli>(end - start).count();
+
+			std::cout << objectCount << " objects: isVisible " << referenceTime << " ms (" << referenceCount << " visible), "
+				<< "cullBounds " << singleThreadTime << " ms, threaded " << multiThreadTime << " ms, "
+				<< "temporal after a turn " << temporalTime << " ms (" << temporalCuller.getRetestedCount() << " tested)" << std::endl;
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "Mesh.h"
+
+namespace Moon
+{
+	//Forward declaration
+	class JobSystem;
+	class Bvh;
+
+	struct Frustum
+	{
+		glm::vec4 planes[6]; // xyz normal pointing inside, w distance
+	};
+
+	Frustum extractFrustum(const glm::mat4& viewProj);
+
+	// World space bounds stored as structure of arrays so the culling kernels can test several objects at once
+	struct CullingBounds
+	{
+		std::vector<float> centerX, centerY, centerZ;
+		std::vector<float> extentX, extentY, extentZ;
+		std::vector<float> radius;
+
+		size_t size() const { return centerX.size(); }
+		void clear();
+		void reserve(size_t count);
+
+		void pushBack(const Bounds& localBounds, const glm::mat4& transform);
+		void set(size_t index, const Bounds& localBounds, const glm::mat4& transform);
+		void swapRemove(size_t index);
+	};
+
+	// Appends to visibleIndices every index of bounds intersecting the frustum, in increasing order.
+	// Large inputs are split across the job system workers when one is given.
+	void cullBounds(const CullingBounds& bounds, const Frustum& frustum, std::vector<uint32_t>& visibleIndices, JobSystem* jobSystem = nullptr);
+
+	// Frustum culling of the same bounds frame after frame. A reference cull sorts the objects into the ones visible
+	// with a margin from every plane and the ones within the margin of a plane; while the camera moves less than the
+	// margin from the reference only the second ones are tested again, the hidden objects are not looked at.
+	// Bounds that change every frame go through cullBounds, or the hierarchy over them when one is given, the reference
+	// is rebuilt once they settle. The rebuild still measures every object, the margins depend on their distance.
+	class TemporalCuller
+	{
+	public:
+		// Same output as cullBounds, version identifies the content of bounds (see RenderObjectRegistry::getVersion).
+		// bvh must be up to date with bounds, the frames it culls append in its order instead of increasing order.
+		void cull(const CullingBounds& bounds, uint64_t version, const Frustum& frustum, const glm::vec3& cameraPosition,
+			std::vector<uint32_t>& visibleIndices, JobSystem* jobSystem = nullptr, const Bvh* bvh = nullptr);
+
+		// objects tested against the planes by the last cull
+		uint32_t getRetestedCount() const { return m_retestedCount; }
+
+	private:
+		void rebuild(const CullingBounds& bounds, const Frustum& frustum, const glm::vec3& cameraPosition, JobSystem* jobSystem);
+
+		Frustum m_reference;
+		glm::vec3 m_referenceCamera;
+		uint64_t m_referenceVersion{ ~0ull };
+		uint64_t m_lastVersion{ ~0ull };
+		float m_moveLimit{ 0.f }; // plane translation allowed before a rebuild, from the distance of the objects
+		std::vector<uint32_t> m_inside; // visible further than the margin from every plane
+		std::vector<uint32_t> m_boundary; // within the margin of a plane
+		std::vector<uint8_t> m_boundaryVisible;
+		std::vector<float> m_distances; // of the box to the plane it is nearest to or most behind, negative when hidden
+		std::vector<float> m_reach; // distance of the farthest point of the bounding sphere from the reference camera
+		uint32_t m_retestedCount{ 0 };
+	};
+
+	// Reference clip space test, projects the 8 corners of the object box
+	bool isVisible(const RenderObject& obj, const glm::mat4& viewProj);
+
+	// Compares isVisible with cullBounds and TemporalCuller on synthetic scenes of 10k, 100k and 1M objects
+	void runCullingBenchmark();
+}
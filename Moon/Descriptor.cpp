@@ -2,27 +2,42 @@
 
 namespace Moon
 {
-	void DescriptorLayoutBuilder::addBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags shaderStages)
+	void DescriptorLayoutBuilder::addBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags shaderStages, uint32_t count /*= 1*/, VkDescriptorBindingFlags flags /*= 0*/)
 	{
 		VkDescriptorSetLayoutBinding newbind{};
 		newbind.binding = binding;
-		newbind.descriptorCount = 1;
+		newbind.descriptorCount = count;
 		newbind.descriptorType = type;
 		newbind.stageFlags = shaderStages;
 		bindings.push_back(newbind);
+		bindingFlags.push_back(flags);
 	}
 
 	void DescriptorLayoutBuilder::clear()
 	{
 		bindings.clear();
+		bindingFlags.clear();
 	}
 
-	VkDescriptorSetLayout DescriptorLayoutBuilder::build(VkDevice device)
+	VkDescriptorSetLayout DescriptorLayoutBuilder::build(VkDevice device, VkDescriptorSetLayoutCreateFlags flags /*= 0*/)
 	{
 		VkDescriptorSetLayoutCreateInfo info = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
 		info.pBindings = bindings.data();
 		info.bindingCount = (uint32_t)bindings.size();
-		info.flags = 0;
+		info.flags = flags;
+
+		// per binding flags (partially bound, update after bind...) for descriptor indexing
+		VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO };
+		flagsInfo.bindingCount = (uint32_t)bindingFlags.size();
+		flagsInfo.pBindingFlags = bindingFlags.data();
+		for (VkDescriptorBindingFlags bindingFlag : bindingFlags)
+		{
+			if (bindingFlag != 0)
+			{
+				info.pNext = &flagsInfo;
+				break;
+			}
+		}
 
 		VkDescriptorSetLayout set;
 		VK_CHECK(vkCreateDescriptorSetLayout(device, &info, nullptr, &set));
@@ -141,7 +156,7 @@ namespace Moon
 		return newPool;
 	}
 
-	void DescriptorWriter::writeImage(int binding, VkImageView image, VkSampler sampler, VkImageLayout layout, VkDescriptorType type)
+	void DescriptorWriter::writeImage(int binding, VkImageView image, VkSampler sampler, VkImageLayout layout, VkDescriptorType type, uint32_t arrayElement /*= 0*/)
 	{
 		VkDescriptorImageInfo& info = imageInfos.emplace_back(VkDescriptorImageInfo{
 				.sampler = sampler,
@@ -151,6 +166,7 @@ namespace Moon
 
 		VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
 		write.dstBinding = binding;
+		write.dstArrayElement = arrayElement;
 		write.dstSet = VK_NULL_HANDLE;
 		write.descriptorCount = 1;
 		write.descriptorType = type;
@@ -8,10 +8,11 @@ namespace Moon
 	struct DescriptorLayoutBuilder
 	{
 		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		std::vector<VkDescriptorBindingFlags> bindingFlags;
 
-		void addBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags shaderStages);
+		void addBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags shaderStages, uint32_t count = 1, VkDescriptorBindingFlags flags = 0);
 		void clear();
-		VkDescriptorSetLayout build(VkDevice device);
+		VkDescriptorSetLayout build(VkDevice device, VkDescriptorSetLayoutCreateFlags flags = 0);
 	};
 
 	struct DescriptorAllocator
@@ -44,7 +45,7 @@ namespace Moon
 		std::deque<VkDescriptorBufferInfo> bufferInfos;
 		std::vector<VkWriteDescriptorSet> writes;
 
-		void writeImage(int binding, VkImageView image, VkSampler sampler, VkImageLayout layout, VkDescriptorType type);
+		void writeImage(int binding, VkImageView image, VkSampler sampler, VkImageLayout layout, VkDescriptorType type, uint32_t arrayElement = 0);
 		void writeBuffer(int binding, VkBuffer buffer, size_t size, size_t offset, VkDescriptorType type);
 
 		void clear();
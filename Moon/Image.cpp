@@ -1,6 +1,14 @@
 #include "Image.h"
 #include "RenderUtilities.h"
 
+#include <algorithm>
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MOON_MIP_SSE
+#endif
+
 namespace Moon
 {
 	void transitionImage(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout)
@@ -13,7 +21,8 @@ namespace Moon
         imageBarrier.oldLayout = currentLayout;
         imageBarrier.newLayout = newLayout;
 
-        VkImageAspectFlags aspectMask = (newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        bool depth = newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL || newLayout == VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL;
+        VkImageAspectFlags aspectMask = depth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
         imageBarrier.subresourceRange = imageSubresourceRange(aspectMask);
         imageBarrier.image = image;
 
@@ -22,4 +31,126 @@ namespace Moon
         depInfo.pImageMemoryBarriers = &imageBarrier;
         vkCmdPipelineBarrier2(cmd, &depInfo);
 	}
+
+	uint32_t getMipLevelCount(VkExtent3D extent)
+	{
+		return std::bit_width(std::max({ extent.width, extent.height, 1u }));
+	}
+
+	VkExtent3D getMipExtent(VkExtent3D extent, uint32_t level)
+	{
+		return VkExtent3D{ std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u), 1 };
+	}
+
+	bool isBlockCompressed(VkFormat format)
+	{
+		return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+	}
+
+	uint32_t getTexelBlockSize(VkFormat format)
+	{
+		// 8 bytes per 4x4 block for BC1 and BC4, 16 for the others
+		if (isBlockCompressed(format))
+		{
+			bool halfBlock = format <= VK_FORMAT_BC1_RGBA_SRGB_BLOCK || format == VK_FORMAT_BC4_UNORM_BLOCK || format == VK_FORMAT_BC4_SNORM_BLOCK;
+			return halfBlock ? 8 : 16;
+		}
+
+		// the ranges cover every numeric and sRGB variant of a layout
+		if (format >= VK_FORMAT_R8_UNORM && format <= VK_FORMAT_R8_SRGB)
+		{
+			return 1;
+		}
+		if ((format >= VK_FORMAT_R8G8_UNORM && format <= VK_FORMAT_R8G8_SRGB) || (format >= VK_FORMAT_R16_UNORM && format <= VK_FORMAT_R16_SFLOAT))
+		{
+			return 2;
+		}
+		if ((format >= VK_FORMAT_R8G8B8A8_UNORM && format <= VK_FORMAT_A2B10G10R10_SINT_PACK32) ||
+			(format >= VK_FORMAT_R16G16_UNORM && format <= VK_FORMAT_R16G16_SFLOAT) || (format >= VK_FORMAT_R32_UINT && format <= VK_FORMAT_R32_SFLOAT) ||
+			format == VK_FORMAT_B10G11R11_UFLOAT_PACK32 || format == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32)
+		{
+			return 4;
+		}
+		if ((format >= VK_FORMAT_R16G16B16A16_UNORM && format <= VK_FORMAT_R16G16B16A16_SFLOAT) ||
+			(format >= VK_FORMAT_R32G32_UINT && format <= VK_FORMAT_R32G32_SFLOAT))
+		{
+			return 8;
+		}
+		if (format >= VK_FORMAT_R32G32B32A32_UINT && format <= VK_FORMAT_R32G32B32A32_SFLOAT)
+		{
+			return 16;
+		}
+		return 0;
+	}
+
+	size_t getImageSize(VkExtent3D extent, VkFormat format)
+	{
+		if (!isBlockCompressed(format))
+		{
+			return size_t(extent.width) * extent.height * getTexelBlockSize(format);
+		}
+
+		size_t blocks = size_t((extent.width + 3) / 4) * ((extent.height + 3) / 4);
+		return blocks * getTexelBlockSize(format);
+	}
+
+	size_t getMipChainSize(VkExtent3D extent, uint32_t mipLevels, VkFormat format)
+	{
+		size_t size = 0;
+		for (uint32_t level = 0; level < mipLevels; level++)
+		{
+			size += getImageSize(getMipExtent(extent, level), format);
+		}
+		return size;
+	}
+
+	// Averages the 2x2 source texels of each destination texel. Odd edges reuse the last row or column.
+	static void downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight)
+	{
+		for (uint32_t y = 0; y < dstHeight; y++)
+		{
+			const uint8_t* row0 = src + size_t(std::min(y * 2, srcHeight - 1)) * srcWidth * 4;
+			const uint8_t* row1 = src + size_t(std::min(y * 2 + 1, srcHeight - 1)) * srcWidth * 4;
+			uint8_t* out = dst + size_t(y) * dstWidth * 4;
+
+			uint32_t x = 0;
+#if defined(MOON_MIP_SSE)
+			// two destination texels from four source texels of both rows
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i rounding = _mm_set1_epi16(2);
+			for (; x + 2 <= dstWidth && x * 2 + 4 <= srcWidth; x += 2)
+			{
+				__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+				__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+				__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+				__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(low, high), _mm_unpackhi_epi64(low, high));
+				sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(sum, zero));
+			}
+#endif
+			for (; x < dstWidth; x++)
+			{
+				uint32_t x0 = std::min(x * 2, srcWidth - 1) * 4;
+				uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					out[x * 4 + c] = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+				}
+			}
+		}
+	}
+
+	void generateMipChain(uint8_t* chain, VkExtent3D extent, uint32_t mipLevels)
+	{
+		uint8_t* src = chain;
+		for (uint32_t level = 1; level < mipLevels; level++)
+		{
+			VkExtent3D srcExtent = getMipExtent(extent, level - 1);
+			VkExtent3D dstExtent = getMipExtent(extent, level);
+			uint8_t* dst = src + size_t(srcExtent.width) * srcExtent.height * 4;
+			downsample(src, srcExtent.width, srcExtent.height, dst, dstExtent.width, dstExtent.height);
+			src = dst;
+		}
+	}
 }
\ No newline at end of file
@@ -4,4 +4,18 @@
 namespace Moon
 {
 	void transitionImage(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout);
+
+	// Full mip chain down to 1x1
+	uint32_t getMipLevelCount(VkExtent3D extent);
+	VkExtent3D getMipExtent(VkExtent3D extent, uint32_t level);
+	bool isBlockCompressed(VkFormat format);
+	// Bytes per texel, per 4x4 block for the BCn formats. 0 for the formats the loaders do not know.
+	uint32_t getTexelBlockSize(VkFormat format);
+	// Size of one 2D level in a format getTexelBlockSize knows
+	size_t getImageSize(VkExtent3D extent, VkFormat format);
+	// Size of the given levels, tightly packed with level 0 first
+	size_t getMipChainSize(VkExtent3D extent, uint32_t mipLevels, VkFormat format = VK_FORMAT_R8G8B8A8_UNORM);
+
+	// Fills levels 1 to mipLevels - 1 of an RGBA8 chain from its level 0, each level is a 2x2 box filter of the previous one
+	void generateMipChain(uint8_t* chain, VkExtent3D extent, uint32_t mipLevels);
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace Moon
+{
+	void JobSystem::init(uint32_t threadCount)
+	{
+		if (threadCount == 0)
+		{
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+		}
+
+		m_stop = false;
+		m_workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			m_workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	void JobSystem::shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_condition.notify_all();
+
+		for (std::thread& worker : m_workers)
+		{
+			worker.join();
+		}
+		m_workers.clear();
+	}
+
+	void JobSystem::parallelFor(uint32_t count, uint32_t minBatchSize, const std::function<void(uint32_t begin, uint32_t end)>& function)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		minBatchSize = std::max(minBatchSize, 1u);
+		uint32_t batchCount = (count + minBatchSize - 1) / minBatchSize;
+		if (m_workers.empty() || batchCount <= 1)
+		{
+			function(0, count);
+			return;
+		}
+
+		// a few batches per thread so that uneven batches still balance out
+		batchCount = std::min(batchCount, (getWorkerCount() + 1) * 4);
+		const uint32_t batchSize = (count + batchCount - 1) / batchCount;
+		batchCount = (count + batchSize - 1) / batchSize;
+
+		struct BatchState
+		{
+			std::atomic<uint32_t> next{ 0 };
+			std::atomic<uint32_t> done{ 0 };
+		};
+		auto state = std::make_shared<BatchState>();
+
+		// function is only referenced while a batch is running, the caller outlives every batch
+		auto runBatches = [state, batchCount, batchSize, count, &function]()
+			{
+				for (uint32_t batch = state->next++; batch < batchCount; batch = state->next++)
+				{
+					uint32_t begin = batch * batchSize;
+					function(begin, std::min(begin + batchSize, count));
+					state->done++;
+				}
+			};
+
+		const uint32_t helpers = std::min(getWorkerCount(), batchCount - 1);
+		for (uint32_t i = 0; i < helpers; i++)
+		{
+			push(runBatches);
+		}
+
+		runBatches();
+		while (state->done.load() < batchCount)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	void JobSystem::push(std::function<void()>&& job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back(std::move(job));
+		}
+		m_condition.notify_one();
+	}
+
+	void JobSystem::workerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+				if (m_stop && m_jobs.empty())
+				{
+					return;
+				}
+
+				job = std::move(m_jobs.front());
+				m_jobs.pop_front();
+			}
+			job();
+		}
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Moon
+{
+	// Small fixed-size worker pool used for data parallel engine work (culling, asset processing...)
+	class JobSystem
+	{
+	public:
+		JobSystem() = default;
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		~JobSystem() { shutdown(); }
+
+		// threadCount = 0 uses one worker per hardware thread minus the calling thread
+		void init(uint32_t threadCount = 0);
+		void shutdown();
+
+		uint32_t getWorkerCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+		template<typename F>
+		auto submit(F&& function) -> std::future<decltype(function())>
+		{
+			using Result = decltype(function());
+			auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+			std::future<Result> future = task->get_future();
+			if (m_workers.empty())
+			{
+				(*task)();
+				return future;
+			}
+
+			push([task]() { (*task)(); });
+			return future;
+		}
+
+		// Splits [0, count) in batches of at least minBatchSize and runs them on the workers and the
+		// calling thread. Blocks until every batch has been processed.
+		void parallelFor(uint32_t count, uint32_t minBatchSize, const std::function<void(uint32_t begin, uint32_t end)>& function);
+
+	private:
+		void push(std::function<void()>&& job);
+		void workerLoop();
+
+		std::vector<std::thread> m_workers;
+		std::deque<std::function<void()>> m_jobs;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_stop{ false };
+	};
+}
@@ -0,0 +1,185 @@
+#include "Ktx2.h"
+#include "Image.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef MOON_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace Moon
+{
+	static const uint8_t Ktx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	// limits a malformed header cannot get past, above what the devices support
+	constexpr uint32_t Ktx2MaxExtent = 16384;
+	constexpr uint32_t Ktx2MaxLayers = 2048;
+	constexpr size_t Ktx2MaxDecodedSize = size_t(1) << 30;
+	// decoded levels start on a multiple of every texel block size, as buffer to image copies require
+	constexpr size_t Ktx2LevelAlignment = 16;
+
+	struct Ktx2Header
+	{
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+	static_assert(sizeof(Ktx2Header) == 80);
+
+	struct Ktx2LevelIndex
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	enum class Ktx2Supercompression : uint32_t
+	{
+		None = 0,
+		BasisLZ = 1,
+		Zstandard = 2,
+		Zlib = 3,
+	};
+
+	bool isKtx2(std::span<const uint8_t> bytes)
+	{
+		return bytes.size() >= sizeof(Ktx2Header) && memcmp(bytes.data(), Ktx2Identifier, sizeof(Ktx2Identifier)) == 0;
+	}
+
+	std::optional<Ktx2Texture> loadKtx2(std::span<const uint8_t> bytes)
+	{
+		if (!isKtx2(bytes))
+		{
+			return {};
+		}
+
+		Ktx2Header header;
+		memcpy(&header, bytes.data(), sizeof(header));
+
+		if (header.vkFormat == VK_FORMAT_UNDEFINED)
+		{
+			std::cout << "KTX2 Basis Universal textures are not supported" << std::endl;
+			return {};
+		}
+		if (header.pixelWidth == 0 || header.pixelWidth > Ktx2MaxExtent || header.pixelHeight > Ktx2MaxExtent || header.pixelDepth > 1 ||
+			header.layerCount > Ktx2MaxLayers || (header.faceCount != 1 && header.faceCount != 6))
+		{
+			std::cout << "KTX2 texture has an unsupported shape" << std::endl;
+			return {};
+		}
+		if (getTexelBlockSize(static_cast<VkFormat>(header.vkFormat)) == 0)
+		{
+			std::cout << "KTX2 format " << header.vkFormat << " is not supported" << std::endl;
+			return {};
+		}
+
+		Ktx2Supercompression supercompression = static_cast<Ktx2Supercompression>(header.supercompressionScheme);
+		bool zstd = supercompression == Ktx2Supercompression::Zstandard;
+#ifndef MOON_WITH_ZSTD
+		if (zstd)
+		{
+			std::cout << "KTX2 Zstandard supercompression needs MOON_WITH_ZSTD" << std::endl;
+			return {};
+		}
+#endif
+		if (supercompression != Ktx2Supercompression::None && !zstd)
+		{
+			std::cout << "KTX2 supercompression scheme " << header.supercompressionScheme << " is not supported" << std::endl;
+			return {};
+		}
+
+		Ktx2Texture texture;
+		texture.format = static_cast<VkFormat>(header.vkFormat);
+		texture.extent = VkExtent3D{ header.pixelWidth, std::max(header.pixelHeight, 1u), 1 };
+		// 0 asks the loader to generate the chain, only the stored base level is uploaded
+		texture.mipLevels = std::max(header.levelCount, 1u);
+		texture.arrayLayers = std::max(header.layerCount, 1u) * header.faceCount;
+		texture.cubemap = header.faceCount == 6;
+
+		if (texture.mipLevels > getMipLevelCount(texture.extent) || bytes.size() < sizeof(Ktx2Header) + texture.mipLevels * sizeof(Ktx2LevelIndex))
+		{
+			return {};
+		}
+
+		std::vector<Ktx2LevelIndex> levels(texture.mipLevels);
+		memcpy(levels.data(), bytes.data() + sizeof(Ktx2Header), levels.size() * sizeof(Ktx2LevelIndex));
+
+		// every level holds all the layers and faces, tightly packed
+		size_t decodedSize = 0;
+		size_t dataBegin = bytes.size();
+		size_t dataEnd = 0;
+		for (uint32_t i = 0; i < texture.mipLevels; i++)
+		{
+			const Ktx2LevelIndex& level = levels[i];
+			size_t levelSize = getImageSize(getMipExtent(texture.extent, i), texture.format) * texture.arrayLayers;
+			if (level.byteOffset > bytes.size() || level.byteLength > bytes.size() - level.byteOffset ||
+				(zstd ? level.uncompressedByteLength : level.byteLength) != levelSize)
+			{
+				return {};
+			}
+			decodedSize += zstd ? (levelSize + Ktx2LevelAlignment - 1) & ~(Ktx2LevelAlignment - 1) : 0;
+			dataBegin = std::min<size_t>(dataBegin, level.byteOffset);
+			dataEnd = std::max<size_t>(dataEnd, level.byteOffset + level.byteLength);
+		}
+		if (decodedSize > Ktx2MaxDecodedSize)
+		{
+			std::cout << "KTX2 texture is too large to decode" << std::endl;
+			return {};
+		}
+
+		// uncompressed levels are uploaded straight from the file, supercompressed ones are decoded in level order
+		texture.data = bytes.subspan(dataBegin, dataEnd - dataBegin);
+		texture.storage.resize(decodedSize);
+		[[maybe_unused]] size_t storageOffset = 0;
+
+		for (uint32_t i = 0; i < texture.mipLevels; i++)
+		{
+			const Ktx2LevelIndex& level = levels[i];
+
+			VkBufferImageCopy& region = texture.regions.emplace_back();
+			region.bufferOffset = level.byteOffset - dataBegin;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = i;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = texture.arrayLayers;
+			region.imageExtent = getMipExtent(texture.extent, i);
+
+#ifdef MOON_WITH_ZSTD
+			if (zstd)
+			{
+				size_t result = ZSTD_decompress(texture.storage.data() + storageOffset, level.uncompressedByteLength,
+					bytes.data() + level.byteOffset, level.byteLength);
+				if (ZSTD_isError(result) || result != level.uncompressedByteLength)
+				{
+					std::cout << "KTX2 level " << i << " failed to decompress" << std::endl;
+					return {};
+				}
+				region.bufferOffset = storageOffset;
+				storageOffset += (level.uncompressedByteLength + Ktx2LevelAlignment - 1) & ~(Ktx2LevelAlignment - 1);
+			}
+#endif
+		}
+
+		if (zstd)
+		{
+			texture.data = texture.storage;
+		}
+		return texture;
+	}
+}
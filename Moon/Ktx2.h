@@ -0,0 +1,26 @@
+#pragma once
+#include "RenderTypes.h"
+
+namespace Moon
+{
+	// GPU ready texture read from a KTX2 container
+	struct Ktx2Texture
+	{
+		VkFormat format;
+		VkExtent3D extent;
+		uint32_t mipLevels;
+		uint32_t arrayLayers; // layers times faces
+		bool cubemap;
+
+		std::vector<uint8_t> storage; // decoded levels of a supercompressed file
+		std::span<const uint8_t> data; // every level, either the part of the file holding them or storage
+		std::vector<VkBufferImageCopy> regions; // one per level with every layer, bufferOffset relative to data
+	};
+
+	bool isKtx2(std::span<const uint8_t> bytes);
+
+	// Parses the container, Zstandard supercompressed levels are decoded when built with MOON_WITH_ZSTD.
+	// Basis Universal payloads (no Vulkan format), 3D textures and formats getTexelBlockSize does not know
+	// are not supported. The level sizes must match the header, decoding is bounded by the header.
+	std::optional<Ktx2Texture> loadKtx2(std::span<const uint8_t> bytes);
+}
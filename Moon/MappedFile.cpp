@@ -0,0 +1,220 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Moon
+{
+#ifdef _WIN32
+	bool MappedFile::open(const std::filesystem::path& path, size_t padding)
+	{
+		close();
+
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize))
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		m_file = file;
+		m_size = static_cast<size_t>(fileSize.QuadPart);
+		m_padding = padding;
+		m_isOpen = true;
+
+		// an empty file can not be mapped
+		if (m_size == 0)
+		{
+			return true;
+		}
+
+		// a view can not extend past the end of the file, the padding has to fit in the zeroed end of the last page
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo(&systemInfo);
+		size_t pageTail = (systemInfo.dwPageSize - m_size % systemInfo.dwPageSize) % systemInfo.dwPageSize;
+		if (padding > pageTail)
+		{
+			m_data = static_cast<uint8_t*>(VirtualAlloc(nullptr, m_size + padding, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+			m_copied = true;
+
+			size_t offset = 0;
+			while (m_data && offset < m_size)
+			{
+				DWORD chunk = static_cast<DWORD>(std::min<size_t>(m_size - offset, 1u << 30));
+				DWORD read = 0;
+				if (!ReadFile(file, m_data + offset, chunk, &read, nullptr) || read == 0)
+				{
+					close();
+					return false;
+				}
+				offset += read;
+			}
+		}
+		else
+		{
+			m_mapping = CreateFileMappingW(file, nullptr, padding > 0 ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+			if (m_mapping)
+			{
+				m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, padding > 0 ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+			}
+		}
+
+		if (!m_data)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data)
+		{
+			if (m_copied)
+			{
+				VirtualFree(m_data, 0, MEM_RELEASE);
+			}
+			else
+			{
+				UnmapViewOfFile(m_data);
+			}
+		}
+		if (m_mapping)
+		{
+			CloseHandle(m_mapping);
+		}
+		if (m_file)
+		{
+			CloseHandle(m_file);
+		}
+
+		m_data = nullptr;
+		m_mapping = nullptr;
+		m_file = nullptr;
+		m_size = 0;
+		m_padding = 0;
+		m_copied = false;
+		m_isOpen = false;
+	}
+
+	size_t getPeakResidentMemory()
+	{
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		{
+			return 0;
+		}
+		return counters.PeakWorkingSetSize;
+	}
+#else
+	bool MappedFile::open(const std::filesystem::path& path, size_t padding)
+	{
+		close();
+
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			return false;
+		}
+
+		struct stat fileStat;
+		if (fstat(file, &fileStat) != 0)
+		{
+			::close(file);
+			return false;
+		}
+
+		m_file = file;
+		m_size = static_cast<size_t>(fileStat.st_size);
+		m_padding = padding;
+		m_isOpen = true;
+
+		// an empty file can not be mapped
+		if (m_size == 0)
+		{
+			return true;
+		}
+
+		void* data;
+		if (padding > 0)
+		{
+			// reserve zeroed anonymous memory for the file and its padding, then map the file over the start of it
+			void* reserved = mmap(nullptr, m_size + padding, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			data = reserved;
+			if (reserved != MAP_FAILED)
+			{
+				data = mmap(reserved, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, file, 0);
+				if (data == MAP_FAILED)
+				{
+					munmap(reserved, m_size + padding);
+				}
+			}
+		}
+		else
+		{
+			data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+		}
+
+		if (data == MAP_FAILED)
+		{
+			close();
+			return false;
+		}
+
+		madvise(data, m_size, MADV_SEQUENTIAL);
+		m_data = static_cast<uint8_t*>(data);
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data)
+		{
+			munmap(m_data, m_size + m_padding);
+		}
+		if (m_file >= 0)
+		{
+			::close(m_file);
+		}
+
+		m_data = nullptr;
+		m_file = -1;
+		m_size = 0;
+		m_padding = 0;
+		m_isOpen = false;
+	}
+
+	size_t getPeakResidentMemory()
+	{
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+		{
+			return 0;
+		}
+#ifdef __APPLE__
+		return static_cast<size_t>(usage.ru_maxrss);
+#else
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+	}
+#endif
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+namespace Moon
+{
+	// Memory mapping of a whole file. Read only by default; with padding the mapping is copy on write and
+	// followed by at least padding zeroed bytes, for parsers that read past the end of their input.
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile() { close(); }
+
+		bool open(const std::filesystem::path& path, size_t padding = 0);
+		void close();
+
+		bool isOpen() const { return m_isOpen; }
+		const uint8_t* data() const { return m_data; }
+		size_t size() const { return m_size; }
+		std::span<const uint8_t> bytes() const { return { m_data, m_size }; }
+
+		// Only valid when opened with padding, writes never reach the file
+		uint8_t* mutableData() const { return m_padding > 0 ? m_data : nullptr; }
+		size_t capacity() const { return m_size + m_padding; }
+
+	private:
+		uint8_t* m_data{ nullptr };
+		size_t m_size{ 0 };
+		size_t m_padding{ 0 };
+		bool m_isOpen{ false };
+#ifdef _WIN32
+		void* m_file{ nullptr };
+		void* m_mapping{ nullptr };
+		bool m_copied{ false }; // read into memory when the last page has no room for the padding
+#else
+		int m_file{ -1 };
+#endif
+	};
+
+	// Peak resident set size of the process in bytes
+	size_t getPeakResidentMemory();
+}
@@ -1,5 +1,17 @@
 #include "Mesh.h"
 #include "RenderDevice.h"
+#include "RenderRegistry.h"
+#include "SceneImport.h"
+#include "MappedFile.h"
+#include "TextureCompression.h"
+#include "Ktx2.h"
+#include "AssetRegistry.h"
+#include "VertexCompression.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "OcclusionCulling.h"
+#include "Bvh.h"
 
 #include <fastgltf/parser.hpp>
 #include <fastgltf/tools.hpp>
@@ -8,8 +20,12 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtx/quaternion.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <future>
 #include <iostream>
 #include <filesystem>
+#include <unordered_set>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -18,18 +34,40 @@ namespace Moon
 {
 	void MeshNode::Draw(const glm::mat4& topMatrix, DrawContext& ctx)
 	{
-		glm::mat4 nodeMatrix = topMatrix * worldTransform;
+		drawSurfaces(topMatrix, ctx);
+		Node::Draw(topMatrix, ctx);
+	}
+
+	static RenderObject makeRenderObject(const MeshAsset& mesh, const SubMesh& surface, const glm::mat4& transform)
+	{
+		RenderObject def;
+		def.indexCount = surface.count;
+		def.firstIndex = surface.startIndex;
+		def.lods = surface.lods.data();
+		def.lodCount = surface.lodCount;
+		def.lod = 0;
+		def.indexBuffer = mesh.meshBuffers.indexBuffer.buffer;
+		def.indexType = mesh.meshBuffers.indexType;
+		def.meshBufferId = mesh.meshBuffers.meshBufferId;
+		def.material = &surface.material->data;
+		def.bounds = surface.bounds;
+		def.transform = transform;
+		def.vertexBufferAddress = mesh.meshBuffers.vertexBufferAddress;
+		def.vertexFormat = mesh.meshBuffers.vertexFormat;
+		def.indexBufferAddress = mesh.meshBuffers.indexBufferAddress;
+		def.meshletBufferAddress = mesh.meshBuffers.meshletBufferAddress;
+		def.occluder = surface.occluder.get();
+		def.triangles = surface.triangles.get();
+		return def;
+	}
+
+	void MeshNode::drawSurfaces(const glm::mat4& topMatrix, DrawContext& ctx)
+	{
+		glm::mat4 nodeMatrix = topMatrix * getWorldTransform();
 
 		for (auto& s : mesh->surfaces)
 		{
-			RenderObject def;
-			def.indexCount = s.count;
-			def.firstIndex = s.startIndex;
-			def.indexBuffer = mesh->meshBuffers.indexBuffer.buffer;
-			def.material = &s.material->data;
-			def.bounds = s.bounds;
-			def.transform = nodeMatrix;
-			def.vertexBufferAddress = mesh->meshBuffers.vertexBufferAddress;
+			RenderObject def = makeRenderObject(*mesh, s, nodeMatrix);
 
 			if (s.material->data.passType == MaterialPass::Transparent)
 			{
@@ -40,46 +78,102 @@ namespace Moon
 				ctx.OpaqueSurfaces.push_back(def);
 			}
 		}
-
-		Node::Draw(topMatrix, ctx);
 	}
 
 	void LoadedGLTF::Draw(const glm::mat4& topMatrix, DrawContext& ctx)
 	{
-		for (auto& n : topNodes)
+		hierarchy.updateTransforms();
+
+		// walk the flattened hierarchy instead of recursing through the node tree
+		for (MeshNode* n : meshNodes)
 		{
-			n->Draw(topMatrix, ctx);
+			n->drawSurfaces(topMatrix, ctx);
 		}
 	}
 
-	void LoadedGLTF::clearAll()
+	void LoadedGLTF::registerRenderObjects(RenderObjectRegistry& registry)
 	{
-		VkDevice dv = creator->getDevice();
+		hierarchy.updateTransforms();
 
-		descriptorPool.destroyPool(dv);
-		creator->destroyBuffer(materialDataBuffer);
-
-		for (auto& [k, v] : meshes)
+		for (MeshNode* n : meshNodes)
 		{
-			creator->destroyBuffer(v->meshBuffers.indexBuffer);
-			creator->destroyBuffer(v->meshBuffers.vertexBuffer);
+			glm::mat4 nodeMatrix = rootTransform * n->getWorldTransform();
+
+			n->renderObjects.clear();
+			for (auto& s : n->mesh->surfaces)
+			{
+				n->renderObjects.push_back(registry.create(makeRenderObject(*n->mesh, s, nodeMatrix)));
+			}
 		}
+	}
 
-		for (auto& [k, v] : images)
+	void LoadedGLTF::unregisterRenderObjects(RenderObjectRegistry& registry)
+	{
+		for (MeshNode* n : meshNodes)
 		{
-			if (v.image == creator->m_errorCheckerboardImage.image)
+			for (RenderObjectHandle handle : n->renderObjects)
 			{
-				continue;
+				registry.destroy(handle);
 			}
-			creator->destroyImage(v);
+			n->renderObjects.clear();
+		}
+	}
+
+	void LoadedGLTF::syncRenderObjects(RenderObjectRegistry& registry)
+	{
+		if (!hierarchy.updateTransforms())
+		{
+			return;
 		}
 
-		for (auto& sampler : samplers)
+		for (uint32_t node : hierarchy.getChangedNodes())
 		{
-			vkDestroySampler(dv, sampler, nullptr);
+			uint32_t meshNodeIndex = meshNodeLookup[node];
+			if (meshNodeIndex == SceneHierarchy::InvalidIndex)
+			{
+				continue;
+			}
+
+			MeshNode* n = meshNodes[meshNodeIndex];
+			glm::mat4 nodeMatrix = rootTransform * n->getWorldTransform();
+			for (RenderObjectHandle handle : n->renderObjects)
+			{
+				registry.updateTransform(handle, nodeMatrix);
+			}
 		}
 	}
 
+	void LoadedGLTF::clearAll()
+	{
+		unregisterRenderObjects(creator->getRenderRegistry());
+
+		// the frames in flight may still read the materials, textures and meshes, the slots are only freed once they completed
+		creator->getFrameDeletionQueue().pushFunction([engine = creator, materialIds = std::move(materialIds), imageAssets = std::move(imageAssets),
+			meshAssets = std::move(meshAssets), samplers = std::move(samplers)]()
+			{
+				BindlessResources& bindless = engine->getBindlessResources();
+				for (uint32_t id : materialIds)
+				{
+					bindless.releaseMaterial(id);
+				}
+
+				AssetRegistry& assets = engine->getAssetRegistry();
+				for (AssetId id : imageAssets)
+				{
+					assets.releaseImage(id);
+				}
+				for (AssetId id : meshAssets)
+				{
+					assets.releaseMesh(id);
+				}
+
+				for (SamplerHandle sampler : samplers)
+				{
+					engine->getSamplerCache().release(sampler);
+				}
+			});
+	}
+
 	VkFilter extractFilter(fastgltf::Filter filter)
 	{
 		switch (filter)
@@ -100,6 +194,8 @@ namespace Moon
 	{
 		switch (filter)
 		{
+		case fastgltf::Filter::Nearest:
+		case fastgltf::Filter::Linear:
 		case fastgltf::Filter::NearestMipMapNearest:
 		case fastgltf::Filter::LinearMipMapNearest:
 			return VK_SAMPLER_MIPMAP_MODE_NEAREST;
@@ -110,116 +206,403 @@ namespace Moon
 		}
 	}
 
-	std::optional<AllocatedImage> loadImage(RenderDevice* engine, fastgltf::Asset& asset, fastgltf::Image& image, std::string globalPath = "")
+	VkSamplerAddressMode extractAddressMode(fastgltf::Wrap wrap)
+	{
+		switch (wrap)
+		{
+		case fastgltf::Wrap::ClampToEdge:
+			return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		case fastgltf::Wrap::MirroredRepeat:
+			return VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+		case fastgltf::Wrap::Repeat:
+		default:
+			return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		}
+	}
+
+	float extractMaxLod(fastgltf::Filter filter)
+	{
+		// a minification filter without mipmaps only samples the base level
+		if (filter == fastgltf::Filter::Nearest || filter == fastgltf::Filter::Linear)
+		{
+			return 0.25f;
+		}
+		return VK_LOD_CLAMP_NONE;
+	}
+
+	static bool storePixels(unsigned char* data, int width, int height, ImportedImage& image)
+	{
+		if (!data)
+		{
+			return false;
+		}
+
+		// the whole mip chain is built at import so that it is baked in the scene cache
+		image.extent = VkExtent3D{ static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
+		image.mipLevels = getMipLevelCount(image.extent);
+		image.storage.resize(getMipChainSize(image.extent, image.mipLevels));
+		memcpy(image.storage.data(), data, static_cast<size_t>(width) * height * 4);
+		stbi_image_free(data);
+
+		generateMipChain(image.storage.data(), image.extent, image.mipLevels);
+		image.pixels = image.storage;
+		return true;
+	}
+
+	static bool decodePixels(const void* bytes, size_t size, ImportedImage& image)
 	{
-		AllocatedImage newImage{};
 		int width, height, nrChannels;
+		unsigned char* data = stbi_load_from_memory(static_cast<const stbi_uc*>(bytes), static_cast<int>(size), &width, &height, &nrChannels, 4);
+		return storePixels(data, width, height, image);
+	}
+
+	// The materials decide how each image is sampled. An image used both as color and as a single channel
+	// (packed occlusion, roughness, metalness) stays a color texture.
+	static std::vector<TextureRole> getImageRoles(const fastgltf::Asset& asset)
+	{
+		constexpr uint8_t colorUse = 1, normalUse = 2, singleUse = 4;
+		std::vector<uint8_t> uses(asset.images.size(), 0);
+		auto markUse = [&](size_t textureIndex, uint8_t use)
+			{
+				const fastgltf::Texture& texture = asset.textures[textureIndex];
+				if (texture.imageIndex.has_value())
+				{
+					uses[texture.imageIndex.value()] |= use;
+				}
+				if (texture.basisuImageIndex.has_value())
+				{
+					uses[texture.basisuImageIndex.value()] |= use;
+				}
+			};
+
+		for (const fastgltf::Material& mat : asset.materials)
+		{
+			if (mat.pbrData.baseColorTexture.has_value())
+			{
+				markUse(mat.pbrData.baseColorTexture.value().textureIndex, colorUse);
+			}
+			if (mat.pbrData.metallicRoughnessTexture.has_value())
+			{
+				markUse(mat.pbrData.metallicRoughnessTexture.value().textureIndex, colorUse);
+			}
+			if (mat.emissiveTexture.has_value())
+			{
+				markUse(mat.emissiveTexture.value().textureIndex, colorUse);
+			}
+			if (mat.normalTexture.has_value())
+			{
+				markUse(mat.normalTexture.value().textureIndex, normalUse);
+			}
+			if (mat.occlusionTexture.has_value())
+			{
+				markUse(mat.occlusionTexture.value().textureIndex, singleUse);
+			}
+		}
+
+		std::vector<TextureRole> roles(uses.size(), TextureRole::Color);
+		for (size_t i = 0; i < uses.size(); i++)
+		{
+			if (uses[i] == normalUse)
+			{
+				roles[i] = TextureRole::Normal;
+			}
+			else if (uses[i] == singleUse)
+			{
+				roles[i] = TextureRole::Single;
+			}
+		}
+		return roles;
+	}
+
+	// Images only referenced as the fallback of a KHR_texture_basisu image are not decoded unless the KTX2 one fails
+	static std::vector<bool> getDeferredImages(const fastgltf::Asset& asset)
+	{
+		std::vector<bool> fallback(asset.images.size(), false);
+		std::vector<bool> needed(asset.images.size(), false);
+		for (const fastgltf::Texture& texture : asset.textures)
+		{
+			if (texture.basisuImageIndex.has_value())
+			{
+				needed[texture.basisuImageIndex.value()] = true;
+			}
+			if (texture.imageIndex.has_value())
+			{
+				(texture.basisuImageIndex.has_value() ? fallback : needed)[texture.imageIndex.value()] = true;
+			}
+		}
+
+		std::vector<bool> deferred(asset.images.size());
+		for (size_t i = 0; i < deferred.size(); i++)
+		{
+			deferred[i] = fallback[i] && !needed[i];
+		}
+		return deferred;
+	}
+
+	// KTX2 images keep their container as it is, the levels are uploaded from it with the layout of the file.
+	// BC containers are refused when the device cannot sample them, the material then uses the fallback image.
+	static bool storeKtx2(std::span<const uint8_t> bytes, std::shared_ptr<const MappedFile> file, bool blockCompressedTextures, ImportedImage& image)
+	{
+		std::optional<Ktx2Texture> texture = loadKtx2(bytes);
+		if (!texture.has_value() || (!blockCompressedTextures && isBlockCompressed(texture->format)))
+		{
+			return false;
+		}
 
+		image.extent = texture->extent;
+		image.format = texture->format;
+		image.mipLevels = texture->mipLevels;
+		image.arrayLayers = texture->arrayLayers;
+		image.cubemap = texture->cubemap;
+		image.ktx2 = true;
+
+		// bytes decoded by the parser do not outlive the asset
+		if (file)
+		{
+			image.file = std::move(file);
+			image.pixels = bytes;
+		}
+		else
+		{
+			image.storage.assign(bytes.begin(), bytes.end());
+			image.pixels = image.storage;
+		}
+		return true;
+	}
+
+	// Encoded images are read straight from the mapped glTF buffers or from their own mapped file, bufferFiles holds the
+	// mapping of each buffer. KTX2 images are GPU ready and skip the decode, the others are decoded, mipmapped and block
+	// compressed when cooking for a device that samples BC formats.
+	static std::optional<ImportedImage> importImage(const fastgltf::Asset& asset, const fastgltf::Image& image, const std::filesystem::path& folder,
+		TextureRole role, std::span<const std::shared_ptr<const MappedFile>> bufferFiles, const ImportSettings& settings)
+	{
+		ImportedImage newImage{};
+		newImage.name = image.name.c_str();
+
+		std::shared_ptr<MappedFile> imageFile;
+		std::shared_ptr<const MappedFile> file; // mapping encoded points into
+		std::span<const uint8_t> encoded;
 		std::visit(
 			fastgltf::visitor
 			{
 				[](auto& arg) {},
-				[&](fastgltf::sources::URI& filePath) //when textures are stored outside of the gltf/glb file
+				[&](const fastgltf::sources::URI& filePath) //when textures are stored outside of the gltf/glb file
 				{
-					assert(filePath.fileByteOffset == 0);
 					assert(filePath.uri.isLocalPath());
 
 					const std::string path(filePath.uri.path().begin(), filePath.uri.path().end());
-					globalPath += path;
-					unsigned char* data = stbi_load(globalPath.c_str(), &width, &height, &nrChannels, 4);
-					if (data)
-					{
-						VkExtent3D imagesize;
-						imagesize.width = width;
-						imagesize.height = height;
-						imagesize.depth = 1;
+					newImage.name = path;
 
-						newImage = engine->createImage(data, imagesize, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
-						newImage.name = path;
-
-						stbi_image_free(data);
+					imageFile = std::make_shared<MappedFile>();
+					if (imageFile->open(folder / filePath.uri.fspath()) && filePath.fileByteOffset < imageFile->size())
+					{
+						encoded = imageFile->bytes().subspan(filePath.fileByteOffset);
+						file = imageFile;
 					}
 				},
-				[&](fastgltf::sources::Vector& vector) //when fastgltf loads the texture into a std::vector type structure
+				[&](const fastgltf::sources::Vector& vector) //when fastgltf loads the texture into a std::vector type structure, base64 data uris
 				{
-					unsigned char* data = stbi_load_from_memory(vector.bytes.data(), static_cast<int>(vector.bytes.size()),
-						&width, &height, &nrChannels, 4);
-					if (data)
-					{
-						VkExtent3D imagesize;
-						imagesize.width = width;
-						imagesize.height = height;
-						imagesize.depth = 1;
-
-						newImage = engine->createImage(data, imagesize, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
-						newImage.name = image.name.c_str();
-
-						stbi_image_free(data);
-					}
+					encoded = vector.bytes;
 				},
-				[&](fastgltf::sources::BufferView& view) //when image file is embedded into the binary GLB file
+				[&](const fastgltf::sources::ByteView& view)
 				{
-					auto& bufferView = asset.bufferViews[view.bufferViewIndex];
-					auto& buffer = asset.buffers[bufferView.bufferIndex];
-
-					std::visit(fastgltf::visitor 
-						{
-							[](auto& arg) {},
-							[&](fastgltf::sources::Vector& vector)
-							{
-								unsigned char* data = stbi_load_from_memory(vector.bytes.data() + bufferView.byteOffset,
-									static_cast<int>(bufferView.byteLength),
-									&width, &height, &nrChannels, 4);
-								if (data)
-								{
-									VkExtent3D imagesize;
-									imagesize.width = width;
-									imagesize.height = height;
-									imagesize.depth = 1;
-
-									newImage = engine->createImage(data, imagesize, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
-									newImage.name = image.name.c_str();
-
-									stbi_image_free(data);
-								}
-							}
-						},
-					buffer.data);
+					encoded = std::span(reinterpret_cast<const uint8_t*>(view.bytes.data()), view.bytes.size());
+				},
+				[&](const fastgltf::sources::BufferView& view) //when image file is embedded into the binary GLB file
+				{
+					const fastgltf::BufferView& bufferView = asset.bufferViews[view.bufferViewIndex];
+					const std::byte* buffer = fastgltf::DefaultBufferDataAdapter{}(asset.buffers[bufferView.bufferIndex]);
+					if (buffer)
+					{
+						encoded = std::span(reinterpret_cast<const uint8_t*>(buffer) + bufferView.byteOffset, bufferView.byteLength);
+						file = bufferFiles[bufferView.bufferIndex];
+					}
 				},
 			},
 		image.data);
 
+		if (isKtx2(encoded))
+		{
+			if (!storeKtx2(encoded, std::move(file), settings.blockCompressedTextures, newImage))
+			{
+				return {};
+			}
+			return newImage;
+		}
+
 		// if loading the data has failed
-		if (newImage.image == VK_NULL_HANDLE)
+		if (!decodePixels(encoded.data(), encoded.size(), newImage))
 		{
 			return {};
 		}
-		else
+
+		if (!settings.compressTextures || !settings.blockCompressedTextures)
 		{
 			return newImage;
 		}
+
+		// the whole chain is block compressed, the format follows the role of the image
+		VkExtent3D extent = newImage.extent;
+		newImage.format = chooseBlockFormat(role, std::span(newImage.storage.data(), size_t(extent.width) * extent.height * 4));
+		newImage.storage = compressMipChain(newImage.format, newImage.storage.data(), extent, newImage.mipLevels);
+		newImage.pixels = newImage.storage;
+		return newImage;
 	}
 
-	std::optional<std::shared_ptr<LoadedGLTF>> loadGltf(RenderDevice* engine, std::string_view filePath)
+	// Index rebasing, vertex assembly and bounds of every primitive of a mesh. Only reads the asset so
+	// several meshes can be imported at the same time.
+	static void importMesh(const fastgltf::Asset& gltf, const fastgltf::Mesh& mesh, ImportedMesh& newmesh)
 	{
-		std::shared_ptr<LoadedGLTF> scene = std::make_shared<LoadedGLTF>();
-		scene->creator = engine;
-		LoadedGLTF& file = *scene.get();
+		newmesh.name = mesh.name.c_str();
+		std::vector<uint32_t>& indices = newmesh.indexStorage;
+		std::vector<Vertex>& vertices = newmesh.vertexStorage;
+
+		for (auto&& p : mesh.primitives)
+		{
+			ImportedSurface subMesh;
+			subMesh.startIndex = (uint32_t)indices.size();
+			subMesh.count = (uint32_t)gltf.accessors[p.indicesAccessor.value()].count;
+
+			size_t initial_vtx = vertices.size();
 
-		fastgltf::Parser parser{};
-		constexpr auto gltfOptions = fastgltf::Options::DontRequireValidAssetMember | fastgltf::Options::AllowDouble | fastgltf::Options::LoadGLBBuffers | fastgltf::Options::LoadExternalBuffers;
+			// load indexes
+			{
+				const fastgltf::Accessor& indexaccessor = gltf.accessors[p.indicesAccessor.value()];
+				indices.reserve(indices.size() + indexaccessor.count);
+
+				fastgltf::iterateAccessor<std::uint32_t>(gltf, indexaccessor, [&](std::uint32_t idx)
+					{
+						indices.push_back(idx + (uint32_t)initial_vtx);
+					});
+			}
+
+			// load vertex positions
+			{
+				const fastgltf::Accessor& posAccessor = gltf.accessors[p.findAttribute("POSITION")->second];
+				vertices.resize(vertices.size() + posAccessor.count);
+
+				fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, posAccessor, [&](glm::vec3 v, size_t index)
+					{
+						Vertex newvtx;
+						newvtx.position = v;
+						newvtx.normal = { 1, 0, 0 };
+						newvtx.color = glm::vec4{ 1.f };
+						newvtx.uv_x = 0;
+						newvtx.uv_y = 0;
+						vertices[initial_vtx + index] = newvtx;
+					});
+			}
 
+			// load vertex normals
+			auto normals = p.findAttribute("NORMAL");
+			if (normals != p.attributes.end())
+			{
+				fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, gltf.accessors[(*normals).second], [&](glm::vec3 v, size_t index)
+					{
+						vertices[initial_vtx + index].normal = v;
+					});
+			}
+
+			// load UVs
+			auto uv = p.findAttribute("TEXCOORD_0");
+			if (uv != p.attributes.end())
+			{
+				fastgltf::iterateAccessorWithIndex<glm::vec2>(gltf, gltf.accessors[(*uv).second], [&](glm::vec2 v, size_t index)
+					{
+						vertices[initial_vtx + index].uv_x = v.x;
+						vertices[initial_vtx + index].uv_y = v.y;
+					});
+			}
+
+			// load vertex colors
+			auto colors = p.findAttribute("COLOR_0");
+			if (colors != p.attributes.end())
+			{
+				fastgltf::iterateAccessorWithIndex<glm::vec4>(gltf, gltf.accessors[(*colors).second], [&](glm::vec4 v, size_t index)
+					{
+						vertices[initial_vtx + index].color = v;
+					});
+			}
+
+			subMesh.materialIndex = p.materialIndex.has_value() ? static_cast<uint32_t>(p.materialIndex.value()) : 0;
+
+			//calculate bounds
+			glm::vec3 minpos = vertices[initial_vtx].position;
+			glm::vec3 maxpos = vertices[initial_vtx].position;
+			for (size_t i = initial_vtx; i < vertices.size(); i++)
+			{
+				minpos = glm::min(minpos, vertices[i].position);
+				maxpos = glm::max(maxpos, vertices[i].position);
+			}
+			subMesh.bounds.origin = (maxpos + minpos) / 2.f;
+			subMesh.bounds.extents = (maxpos - minpos) / 2.f;
+			subMesh.bounds.sphereRadius = glm::length(subMesh.bounds.extents);
+
+			newmesh.surfaces.push_back(subMesh);
+		}
+
+		newmesh.indices = indices;
+		newmesh.vertices = vertices;
+	}
+
+	static float millisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	static glm::mat4 extractLocalTransform(const fastgltf::Node& node)
+	{
+		glm::mat4 localTransform;
+		std::visit(fastgltf::visitor
+			{ 
+				[&](const fastgltf::Node::TransformMatrix& matrix) 
+				{
+					memcpy(&localTransform, matrix.data(), sizeof(matrix));								  
+				},
+				[&](const fastgltf::Node::TRS& transform)
+				{
+					glm::vec3 tl(transform.translation[0], transform.translation[1], transform.translation[2]);
+					glm::quat rot(transform.rotation[3], transform.rotation[0], transform.rotation[1], transform.rotation[2]);
+					glm::vec3 sc(transform.scale[0], transform.scale[1], transform.scale[2]);
+
+					glm::mat4 tm = glm::translate(glm::mat4(1.f), tl);
+					glm::mat4 rm = glm::toMat4(rot);
+					glm::mat4 sm = glm::scale(glm::mat4(1.f), sc);
+
+					localTransform = tm * rm * sm;
+				} 
+			},
+			node.transform);
+		return localTransform;
+	}
+
+	std::optional<SceneImport> importGltf(JobSystem& jobs, std::string_view filePath, EngineStats& stats, const ImportSettings& settings)
+	{
+		auto parseStart = std::chrono::steady_clock::now();
+
+		fastgltf::Parser parser{ fastgltf::Extensions::KHR_texture_basisu };
+		// buffers are not loaded by the parser, GLB chunks and external buffers stay views into mapped files
+		constexpr auto gltfOptions = fastgltf::Options::DontRequireValidAssetMember | fastgltf::Options::AllowDouble;
+
+		std::filesystem::path path = filePath;
+		std::filesystem::path folder = path.parent_path();
+
+		// the json parser reads past the end of its input, the mapping is padded for it
+		std::shared_ptr<MappedFile> source = std::make_shared<MappedFile>();
 		fastgltf::GltfDataBuffer data;
-		data.loadFromFile(filePath);
+		if (!source->open(path, fastgltf::getGltfBufferPadding()) || !data.fromByteView(source->mutableData(), source->size(), source->capacity()))
+		{
+			std::cerr << "Failed to open glTF: " << filePath << std::endl;
+			return {};
+		}
 
 		fastgltf::Asset gltf;
-		std::filesystem::path path = filePath;
 
 		// load gltf file
 		auto type = fastgltf::determineGltfFileType(&data);
 		if (type == fastgltf::GltfType::glTF)
 		{
-			auto load = parser.loadGLTF(&data, path.parent_path(), gltfOptions);
+			auto load = parser.loadGLTF(&data, folder, gltfOptions);
 			if (load)
 			{
 				gltf = std::move(load.get());
@@ -232,7 +615,7 @@ namespace Moon
 		}
 		else if (type == fastgltf::GltfType::GLB)
 		{
-			auto load = parser.loadBinaryGLTF(&data, path.parent_path(), gltfOptions);
+			auto load = parser.loadBinaryGLTF(&data, folder, gltfOptions);
 			if (load)
 			{
 				gltf = std::move(load.get());
@@ -249,225 +632,588 @@ namespace Moon
 			return {};
 		}
 
-		// init descriptor pool
-		std::vector<DescriptorAllocator::PoolSizeRatio> sizes = { 
-			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3 },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 }
-		};
-		file.descriptorPool.initPool(engine->getDevice(), static_cast<uint32_t>(gltf.materials.size()), sizes);
+		// map the external buffers, the accessors then read from the mappings through byte views.
+		// The GLB binary chunk already is a view into the source mapping.
+		std::vector<std::shared_ptr<const MappedFile>> bufferFiles(gltf.buffers.size());
+		for (size_t i = 0; i < gltf.buffers.size(); i++)
+		{
+			fastgltf::Buffer& buffer = gltf.buffers[i];
+			if (std::holds_alternative<fastgltf::sources::ByteView>(buffer.data))
+			{
+				bufferFiles[i] = source;
+			}
 
-		// load samplers
-		for (fastgltf::Sampler& sampler : gltf.samplers)
+			const fastgltf::sources::URI* uri = std::get_if<fastgltf::sources::URI>(&buffer.data);
+			if (!uri || !uri->uri.isLocalPath())
+			{
+				continue;
+			}
+
+			std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+			if (!file->open(folder / uri->uri.fspath()) || uri->fileByteOffset + buffer.byteLength > file->size())
+			{
+				std::cerr << "Failed to load glTF buffer: " << uri->uri.path() << std::endl;
+				return {};
+			}
+
+			const std::byte* bytes = reinterpret_cast<const std::byte*>(file->data()) + uri->fileByteOffset;
+			buffer.data = fastgltf::sources::ByteView{ fastgltf::span<const std::byte>(bytes, buffer.byteLength), fastgltf::MimeType::GltfBuffer };
+			bufferFiles[i] = std::move(file);
+		}
+
+		stats.assetParseTime += millisecondsSince(parseStart);
+
+		SceneImport import;
+
+		// decode every image and build every mesh as independent tasks
+		auto importStart = std::chrono::steady_clock::now();
+		std::vector<TextureRole> imageRoles = getImageRoles(gltf);
+		std::vector<bool> deferredImages = getDeferredImages(gltf);
+		std::vector<std::future<std::optional<ImportedImage>>> imageTasks(gltf.images.size());
+		auto submitImage = [&](size_t i)
+			{
+				imageTasks[i] = jobs.submit([&, i]()
+					{
+						return importImage(gltf, gltf.images[i], folder, imageRoles[i], bufferFiles, settings);
+					});
+			};
+		for (size_t i = 0; i < gltf.images.size(); i++)
 		{
-			VkSampler newSampler;
-			VkSamplerCreateInfo samplerCI = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
-			vkCreateSampler(engine->getDevice(), &samplerCI, nullptr, &newSampler);
+			if (!deferredImages[i])
+			{
+				submitImage(i);
+			}
+		}
 
-			file.samplers.push_back(newSampler);
+		import.meshes.resize(gltf.meshes.size());
+		std::vector<MeshOptimizationReport> meshReports(gltf.meshes.size());
+		std::vector<LodGenerationReport> lodReports(gltf.meshes.size());
+		std::vector<MeshletReport> meshletReports(gltf.meshes.size());
+		std::vector<std::future<void>> meshTasks;
+		meshTasks.reserve(gltf.meshes.size());
+		for (size_t i = 0; i < gltf.meshes.size(); i++)
+		{
+			meshTasks.push_back(jobs.submit([&, i]()
+				{
+					importMesh(gltf, gltf.meshes[i], import.meshes[i]);
+					if (settings.optimizeMeshes)
+					{
+						meshReports[i] = optimizeMesh(import.meshes[i]);
+					}
+					if (settings.generateLods)
+					{
+						lodReports[i] = generateLods(import.meshes[i]);
+					}
+					if (settings.buildMeshlets)
+					{
+						meshletReports[i] = buildMeshlets(import.meshes[i]);
+					}
+				}));
 		}
 
-		// temporal arrays
-		std::vector<std::shared_ptr<MeshAsset>> meshes;
-		std::vector<std::shared_ptr<Node>> nodes;
-		std::vector<AllocatedImage> images;
-		std::vector<std::shared_ptr<GLTFMaterial>> materials;
+		// samplers
+		for (const fastgltf::Sampler& sampler : gltf.samplers)
+		{
+			ImportedSampler newSampler;
+			// unspecified filters are left to the implementation, use trilinear filtering
+			newSampler.magFilter = extractFilter(sampler.magFilter.value_or(fastgltf::Filter::Linear));
+			newSampler.minFilter = extractFilter(sampler.minFilter.value_or(fastgltf::Filter::LinearMipMapLinear));
+			newSampler.mipmapMode = extractMipmapMode(sampler.minFilter.value_or(fastgltf::Filter::LinearMipMapLinear));
+			newSampler.addressModeU = extractAddressMode(sampler.wrapS);
+			newSampler.addressModeV = extractAddressMode(sampler.wrapT);
+			newSampler.maxLod = extractMaxLod(sampler.minFilter.value_or(fastgltf::Filter::LinearMipMapLinear));
+			import.samplers.push_back(newSampler);
+		}
 
-		// load textures
-		for (fastgltf::Image& image : gltf.images)
+		// materials, textures prefer their KHR_texture_basisu image and keep the regular one as a fallback
+		std::vector<int32_t> fallbackImages;
+		for (const fastgltf::Material& mat : gltf.materials)
 		{
-			std::filesystem::path fullpath(filePath);
-			fullpath.remove_filename();
-			std::optional<AllocatedImage> img = loadImage(engine, gltf, image, fullpath.string());
+			ImportedMaterial newMat;
+			newMat.name = mat.name.c_str();
+			newMat.baseColorFactors = glm::vec4(mat.pbrData.baseColorFactor[0], mat.pbrData.baseColorFactor[1],
+				mat.pbrData.baseColorFactor[2], mat.pbrData.baseColorFactor[3]);
+			newMat.metalRoughFactors = glm::vec4(mat.pbrData.metallicFactor, mat.pbrData.roughnessFactor, 0.f, 0.f);
 
-			if (img.has_value())
+			newMat.passType = MaterialPass::MainColor;
+			if (mat.alphaMode == fastgltf::AlphaMode::Blend)
+			{
+				newMat.passType = MaterialPass::Transparent;
+			}
+			newMat.doubleSided = mat.doubleSided;
+
+			if (mat.pbrData.baseColorTexture.has_value())
 			{
-				images.push_back(*img);
-				file.images[img->name] = *img;
+				const fastgltf::Texture& texture = gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex];
+				int32_t image = texture.imageIndex.has_value() ? static_cast<int32_t>(texture.imageIndex.value()) : -1;
+				newMat.colorImage = texture.basisuImageIndex.has_value() ? static_cast<int32_t>(texture.basisuImageIndex.value()) : image;
+				newMat.colorSampler = static_cast<int32_t>(texture.samplerIndex.value());
+				fallbackImages.push_back(image);
 			}
 			else
 			{
-				images.push_back(engine->m_errorCheckerboardImage);
-				std::cout << "gltf failed to load texture " << image.name << std::endl;
+				fallbackImages.push_back(-1);
 			}
+			import.materials.push_back(newMat);
 		}
 
-		// create buffer to hold the material data
-		file.materialDataBuffer = engine->createBuffer(sizeof(GLTFMetallic_Roughness::MaterialConstants) * gltf.materials.size(),
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-		int data_index = 0;
-		GLTFMetallic_Roughness::MaterialConstants* sceneMaterialConstants = (GLTFMetallic_Roughness::MaterialConstants*)file.materialDataBuffer.info.pMappedData;
+		// nodes, children are stored as ranges of a single array
+		for (const fastgltf::Node& node : gltf.nodes)
+		{
+			ImportedNode newNode;
+			newNode.name = node.name.c_str();
+			newNode.localTransform = extractLocalTransform(node);
+			newNode.meshIndex = node.meshIndex.has_value() ? static_cast<int32_t>(*node.meshIndex) : -1;
+			newNode.firstChild = static_cast<uint32_t>(import.children.size());
+			newNode.childCount = static_cast<uint32_t>(node.children.size());
+			for (size_t c = 0; c < node.children.size(); c++)
+			{
+				import.children.push_back(static_cast<uint32_t>(node.children[c]));
+			}
+			import.nodes.push_back(newNode);
+		}
 
-		// load materials
-		for (fastgltf::Material& mat : gltf.materials)
+		// an empty image falls back to the error texture
+		import.images.resize(gltf.images.size());
+		auto storeImage = [&](size_t i)
+			{
+				std::optional<ImportedImage> image = imageTasks[i].get();
+				if (image.has_value())
+				{
+					import.images[i] = std::move(*image);
+				}
+				else
+				{
+					import.images[i].name = gltf.images[i].name.c_str();
+					import.images[i].extent = VkExtent3D{ 0, 0, 0 };
+				}
+			};
+		for (size_t i = 0; i < imageTasks.size(); i++)
 		{
-			std::shared_ptr<GLTFMaterial> newMat = std::make_shared<GLTFMaterial>();
-			materials.push_back(newMat);
-			file.materials[mat.name.c_str()] = newMat;
-
-			GLTFMetallic_Roughness::MaterialConstants constants;
-			constants.baseColorFactors.x = mat.pbrData.baseColorFactor[0];
-			constants.baseColorFactors.y = mat.pbrData.baseColorFactor[1];
-			constants.baseColorFactors.z = mat.pbrData.baseColorFactor[2];
-			constants.baseColorFactors.w = mat.pbrData.baseColorFactor[3];
-			constants.metalRoughFactors.x = mat.pbrData.metallicFactor;
-			constants.metalRoughFactors.y = mat.pbrData.roughnessFactor;
-			
-			// write material parameters to buffer
-			sceneMaterialConstants[data_index] = constants;
-
-			MaterialPass passType = MaterialPass::MainColor;
-			if (mat.alphaMode == fastgltf::AlphaMode::Blend)
+			if (!deferredImages[i])
 			{
-				passType = MaterialPass::Transparent;
+				storeImage(i);
 			}
+		}
 
-			// default the material textures
-			GLTFMetallic_Roughness::MaterialResources materialResources;
-			materialResources.colorImage = engine->m_whiteImage;
-			materialResources.colorSampler = engine->m_defaultSamplerLinear;
-			materialResources.metalRoughImage = engine->m_whiteImage;
-			materialResources.metalRoughSampler = engine->m_defaultSamplerLinear;
+		// the fallback images of the KTX2 ones that failed or are not 2D are only decoded now
+		std::vector<size_t> fallbacksToLoad;
+		for (size_t i = 0; i < import.materials.size(); i++)
+		{
+			ImportedMaterial& material = import.materials[i];
+			if (material.colorImage >= 0 && fallbackImages[i] >= 0 && !import.images[material.colorImage].isTexture2D())
+			{
+				material.colorImage = fallbackImages[i];
+				if (deferredImages[material.colorImage])
+				{
+					deferredImages[material.colorImage] = false;
+					submitImage(material.colorImage);
+					fallbacksToLoad.push_back(material.colorImage);
+				}
+			}
+		}
+		for (size_t i : fallbacksToLoad)
+		{
+			storeImage(i);
+		}
+		stats.textureLoadTime += millisecondsSince(importStart);
 
-			// set the uniform buffer for the material data
-			materialResources.dataBuffer = file.materialDataBuffer.buffer;
-			materialResources.dataBufferOffset = data_index * sizeof(GLTFMetallic_Roughness::MaterialConstants);
+		for (std::future<void>& task : meshTasks)
+		{
+			task.get();
+		}
+		stats.meshLoadTime += millisecondsSince(importStart);
 
-			// grab textures from gltf file
-			if (mat.pbrData.baseColorTexture.has_value())
+		if (settings.optimizeMeshes)
+		{
+			for (size_t i = 0; i < import.meshes.size(); i++)
 			{
-				size_t img = gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex].imageIndex.value();
-				size_t sampler = gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex].samplerIndex.value();
-
-				materialResources.colorImage = images[img];
-				materialResources.colorSampler = file.samplers[sampler];
+				const MeshOptimizationReport& report = meshReports[i];
+				std::cout << "mesh " << import.meshes[i].name << ": vertices " << report.vertexCountBefore << " -> " << report.vertexCountAfter
+					<< ", ACMR " << report.before.acmr << " -> " << report.after.acmr
+					<< ", ATVR " << report.before.atvr << " -> " << report.after.atvr << std::endl;
 			}
+		}
+		if (settings.generateLods)
+		{
+			for (size_t i = 0; i < import.meshes.size(); i++)
+			{
+				std::cout << "mesh " << import.meshes[i].name << ": LOD triangles";
+				for (size_t triangleCount : lodReports[i].triangleCounts)
+				{
+					if (triangleCount > 0)
+					{
+						std::cout << " " << triangleCount;
+					}
+				}
+				std::cout << std::endl;
+			}
+		}
+		if (settings.buildMeshlets)
+		{
+			for (size_t i = 0; i < import.meshes.size(); i++)
+			{
+				const MeshletReport& report = meshletReports[i];
+				std::cout << "mesh " << import.meshes[i].name << ": " << report.meshletCount << " meshlets, "
+					<< report.averageVertices << " vertices and " << report.averageTriangles << " triangles on average" << std::endl;
+			}
+		}
+		stats.peakLoadMemory = getPeakResidentMemory();
 
-			// build material
-			newMat->data = engine->m_metalRoughMaterial.writeMaterial(engine->getDevice(), passType, materialResources, file.descriptorPool);
+		return import;
+	}
 
-			data_index++;
-		}
+	// the description is part of the key, two images with the same bytes but another shape stay apart
+	static AssetKey getImageKey(const ImportedImage& image)
+	{
+		uint32_t description[] = { image.extent.width, image.extent.height, static_cast<uint32_t>(image.format), image.mipLevels,
+			image.arrayLayers, image.cubemap, image.ktx2 };
+		AssetKeyBuilder builder;
+		builder.add({ reinterpret_cast<const uint8_t*>(description), sizeof(description) });
+		builder.add(image.pixels);
+		return builder.finish();
+	}
+
+	static AssetKey getMeshKey(const ImportedMesh& mesh)
+	{
+		uint64_t sizes[] = { mesh.indices.size(), mesh.meshlets.size(), mesh.vertices.size() };
+		AssetKeyBuilder builder;
+		builder.add({ reinterpret_cast<const uint8_t*>(sizes), sizeof(sizes) });
+		builder.add({ reinterpret_cast<const uint8_t*>(mesh.indices.data()), mesh.indices.size_bytes() });
+		builder.add({ reinterpret_cast<const uint8_t*>(mesh.meshlets.data()), mesh.meshlets.size_bytes() });
+		builder.add({ reinterpret_cast<const uint8_t*>(mesh.vertices.data()), mesh.vertices.size_bytes() });
+		return builder.finish();
+	}
 
-		// use the same vectors for all meshes so that the memory doesnt reallocate as often
-		std::vector<uint32_t> indices;
-		std::vector<Vertex> vertices;
+	template<typename T>
+	static std::span<const uint8_t> asBytes(std::span<const T> span)
+	{
+		return { reinterpret_cast<const uint8_t*>(span.data()), span.size_bytes() };
+	}
 
-		for (fastgltf::Mesh& mesh : gltf.meshes)
+	// 16 bit indices when every vertex can be addressed with them, compact vertices when enabled and the surfaces allow it
+	static GPUMeshBuffers uploadImportedMesh(RenderDevice* engine, const ImportedMesh& mesh)
+	{
+		std::vector<uint16_t> shortIndices;
+		std::span<const uint8_t> indices = asBytes(mesh.indices);
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+		if (mesh.vertices.size() <= 65536)
 		{
-			std::shared_ptr<MeshAsset> newmesh = std::make_shared<MeshAsset>();
-			meshes.push_back(newmesh);
-			file.meshes[mesh.name.c_str()] = newmesh;
-			newmesh->name = mesh.name;
+			shortIndices = narrowIndices(mesh.indices);
+			indices = asBytes(std::span<const uint16_t>(shortIndices));
+			indexType = VK_INDEX_TYPE_UINT16;
+		}
 
-			// clear the mesh arrays each mesh, we dont want to merge them by error
-			indices.clear();
-			vertices.clear();
+		std::vector<CompactVertex> compactVertices;
+		if (engine->m_compactVertices && compressVertices(mesh.vertices, mesh.indices, mesh.surfaces, compactVertices))
+		{
+			return engine->uploadMesh(indices, indexType, asBytes(std::span<const CompactVertex>(compactVertices)), VertexFormat::Compact, mesh.meshlets);
+		}
+		return engine->uploadMesh(indices, indexType, asBytes(mesh.vertices), VertexFormat::Full, mesh.meshlets);
+	}
 
-			for (auto&& p : mesh.primitives)
-			{
-				SubMesh subMesh;
-				subMesh.startIndex = (uint32_t)indices.size();
-				subMesh.count = (uint32_t)gltf.accessors[p.indicesAccessor.value()].count;
+	std::shared_ptr<LoadedGLTF> createScene(RenderDevice* engine, const SceneImport& import)
+	{
+		auto sceneStart = std::chrono::steady_clock::now();
 
-				size_t initial_vtx = vertices.size();
+		std::shared_ptr<LoadedGLTF> scene = std::make_shared<LoadedGLTF>();
+		scene->creator = engine;
+		LoadedGLTF& file = *scene.get();
 
-				// load indexes
-				{
-					fastgltf::Accessor& indexaccessor = gltf.accessors[p.indicesAccessor.value()];
-					indices.reserve(indices.size() + indexaccessor.count);
+		BindlessResources& bindless = engine->getBindlessResources();
+		AssetRegistry& assets = engine->getAssetRegistry();
+		JobSystem& jobs = engine->getJobSystem();
 
-					fastgltf::iterateAccessor<std::uint32_t>(gltf, indexaccessor, [&](std::uint32_t idx)
-						{
-							indices.push_back(idx + (uint32_t)initial_vtx);
-						});
+		// images and meshes are identified by their content, the ones already loaded by another scene
+		// or earlier in this one share its GPU resources instead of being uploaded again
+		std::vector<AssetKey> imageKeys(import.images.size());
+		std::vector<AssetKey> meshKeys(import.meshes.size());
+		jobs.parallelFor(static_cast<uint32_t>(import.images.size() + import.meshes.size()), 1, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					if (i < import.images.size())
+					{
+						imageKeys[i] = getImageKey(import.images[i]);
+					}
+					else
+					{
+						meshKeys[i - import.images.size()] = getMeshKey(import.meshes[i - import.images.size()]);
+					}
 				}
+			});
 
-				// load vertex positions
-				{
-					fastgltf::Accessor& posAccessor = gltf.accessors[p.findAttribute("POSITION")->second];
-					vertices.resize(vertices.size() + posAccessor.count);
+		// the staging writes of every new image and mesh are recorded from the workers
+		std::vector<AssetId> imageAssets(import.images.size(), InvalidAssetId);
+		std::vector<std::future<std::optional<AllocatedImage>>> imageTasks(import.images.size());
+		std::unordered_set<AssetKey, AssetKeyHash> newImages;
+		for (size_t i = 0; i < import.images.size(); i++)
+		{
+			const ImportedImage& image = import.images[i];
+			if (!image.isTexture2D())
+			{
+				continue;
+			}
 
-					fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, posAccessor, [&](glm::vec3 v, size_t index)
-						{
-							Vertex newvtx;
-							newvtx.position = v;
-							newvtx.normal = { 1, 0, 0 };
-							newvtx.color = glm::vec4{ 1.f };
-							newvtx.uv_x = 0;
-							newvtx.uv_y = 0;
-							vertices[initial_vtx + index] = newvtx;
-						});
-				}
+			imageAssets[i] = assets.findImage(imageKeys[i]);
+			if (imageAssets[i] != InvalidAssetId || !newImages.insert(imageKeys[i]).second)
+			{
+				continue;
+			}
 
-				// load vertex normals
-				auto normals = p.findAttribute("NORMAL");
-				if (normals != p.attributes.end())
+			imageTasks[i] = jobs.submit([engine, imagePtr = &image]() -> std::optional<AllocatedImage>
 				{
-					fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, gltf.accessors[(*normals).second], [&](glm::vec3 v, size_t index)
+					AllocatedImage newImage;
+					if (imagePtr->ktx2)
+					{
+						// supercompressed levels are decoded here, the others are copied straight from the container
+						std::optional<Ktx2Texture> texture = loadKtx2(imagePtr->pixels);
+						if (!texture.has_value())
 						{
-							vertices[initial_vtx + index].normal = v;
-						});
-				}
+							return {};
+						}
+						newImage = engine->createImage(*texture, VK_IMAGE_USAGE_SAMPLED_BIT);
+					}
+					else
+					{
+						newImage = engine->createImage(imagePtr->pixels.data(), imagePtr->extent, imagePtr->format, VK_IMAGE_USAGE_SAMPLED_BIT, imagePtr->mipLevels);
+					}
+					newImage.name = imagePtr->name;
+					return newImage;
+				});
+		}
 
-				// load UVs
-				auto uv = p.findAttribute("TEXCOORD_0");
-				if (uv != p.attributes.end())
+		std::vector<AssetId> meshAssets(import.meshes.size(), InvalidAssetId);
+		std::vector<GPUMeshBuffers> meshBuffers(import.meshes.size());
+		std::vector<std::future<void>> meshTasks(import.meshes.size());
+		std::unordered_set<AssetKey, AssetKeyHash> newMeshes;
+		for (size_t i = 0; i < import.meshes.size(); i++)
+		{
+			meshAssets[i] = assets.findMesh(meshKeys[i]);
+			if (meshAssets[i] != InvalidAssetId || !newMeshes.insert(meshKeys[i]).second)
+			{
+				continue;
+			}
+
+			meshTasks[i] = jobs.submit([&, i]()
 				{
-					fastgltf::iterateAccessorWithIndex<glm::vec2>(gltf, gltf.accessors[(*uv).second], [&](glm::vec2 v, size_t index)
+					meshBuffers[i] = uploadImportedMesh(engine, import.meshes[i]);
+				});
+		}
+
+		// the occluders are per surface, every mesh of the file gets its own copies; transparent surfaces hide nothing
+		std::vector<std::future<std::vector<std::shared_ptr<const OccluderMesh>>>> occluderTasks(import.meshes.size());
+		if (engine->m_importSettings.buildOccluders)
+		{
+			for (size_t i = 0; i < import.meshes.size(); i++)
+			{
+				occluderTasks[i] = jobs.submit([&, i]()
+					{
+						const ImportedMesh& mesh = import.meshes[i];
+						std::vector<std::shared_ptr<const OccluderMesh>> occluders(mesh.surfaces.size());
+						for (size_t s = 0; s < mesh.surfaces.size(); s++)
 						{
-							vertices[initial_vtx + index].uv_x = v.x;
-							vertices[initial_vtx + index].uv_y = v.y;
-						});
-				}
+							const ImportedSurface& surface = mesh.surfaces[s];
+							if (import.materials[surface.materialIndex].passType != MaterialPass::Transparent)
+							{
+								occluders[s] = buildOccluderMesh(mesh, surface);
+							}
+						}
+						return occluders;
+					});
+			}
+		}
 
-				// load vertex colors
-				auto colors = p.findAttribute("COLOR_0");
-				if (colors != p.attributes.end())
-				{
-					fastgltf::iterateAccessorWithIndex<glm::vec4>(gltf, gltf.accessors[(*colors).second], [&](glm::vec4 v, size_t index)
+		// the triangle hierarchies of large surfaces are also split over the workers
+		std::vector<std::future<std::vector<std::shared_ptr<const TriangleBvh>>>> triangleTasks(import.meshes.size());
+		if (engine->m_importSettings.buildTriangleBvhs)
+		{
+			for (size_t i = 0; i < import.meshes.size(); i++)
+			{
+				triangleTasks[i] = jobs.submit([&, i]()
+					{
+						const ImportedMesh& mesh = import.meshes[i];
+						std::vector<std::shared_ptr<const TriangleBvh>> triangles(mesh.surfaces.size());
+						for (size_t s = 0; s < mesh.surfaces.size(); s++)
 						{
-							vertices[initial_vtx + index].color = v;
-						});
-				}
+							triangles[s] = buildTriangleBvh(mesh, mesh.surfaces[s], &jobs);
+						}
+						return triangles;
+					});
+			}
+		}
 
-				if (p.materialIndex.has_value())
-				{
-					subMesh.material = materials[p.materialIndex.value()];
-				}
-				else
+		// samplers are shared with the other scenes through the device cache,
+		// trilinear ones get anisotropic filtering
+		SamplerCache& samplerCache = engine->getSamplerCache();
+		for (const ImportedSampler& sampler : import.samplers)
+		{
+			VkSamplerCreateInfo samplerCI = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+			samplerCI.magFilter = sampler.magFilter;
+			samplerCI.minFilter = sampler.minFilter;
+			samplerCI.mipmapMode = sampler.mipmapMode;
+			samplerCI.addressModeU = sampler.addressModeU;
+			samplerCI.addressModeV = sampler.addressModeV;
+			samplerCI.addressModeW = sampler.addressModeV;
+			samplerCI.anisotropyEnable = sampler.minFilter == VK_FILTER_LINEAR && sampler.mipmapMode == VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			samplerCI.maxAnisotropy = samplerCache.getMaxAnisotropy();
+			samplerCI.minLod = 0.f;
+			samplerCI.maxLod = sampler.maxLod;
+
+			file.samplers.push_back(samplerCache.acquire(samplerCI));
+		}
+
+		// temporal arrays
+		std::vector<std::shared_ptr<MeshAsset>> meshes;
+		std::vector<std::shared_ptr<Node>> nodes;
+		std::vector<uint32_t> imageIndices;
+		std::vector<std::shared_ptr<GLTFMaterial>> materials;
+
+		// only the images a material samples warn when they could not be uploaded, unneeded fallbacks stay silent
+		std::vector<bool> usedImages(import.images.size(), false);
+		for (const ImportedMaterial& mat : import.materials)
+		{
+			if (mat.colorImage >= 0)
+			{
+				usedImages[mat.colorImage] = true;
+			}
+		}
+
+		// register textures in image order, descriptor writes to the bindless set stay on this thread.
+		// An image sharing the content of an earlier one of this scene is found once that one is added.
+		for (size_t i = 0; i < imageTasks.size(); i++)
+		{
+			if (imageTasks[i].valid())
+			{
+				std::optional<AllocatedImage> img = imageTasks[i].get();
+				if (img.has_value())
 				{
-					subMesh.material = materials[0];
+					imageAssets[i] = assets.addImage(imageKeys[i], *img);
 				}
+			}
+			else if (imageAssets[i] == InvalidAssetId && import.images[i].isTexture2D())
+			{
+				imageAssets[i] = assets.findImage(imageKeys[i]);
+			}
 
-				//calculate bounds
-				glm::vec3 minpos = vertices[initial_vtx].position;
-				glm::vec3 maxpos = vertices[initial_vtx].position;
-				for (size_t i = initial_vtx; i < vertices.size(); i++)
+			if (imageAssets[i] != InvalidAssetId)
+			{
+				file.imageAssets.push_back(imageAssets[i]);
+				imageIndices.push_back(assets.getImage(imageAssets[i]).textureIndex);
+			}
+			else
+			{
+				imageIndices.push_back(engine->m_errorTextureIndex);
+				if (usedImages[i])
 				{
-					minpos = glm::min(minpos, vertices[i].position);
-					maxpos = glm::max(maxpos, vertices[i].position);
+					std::cout << "gltf failed to load texture " << import.images[i].name << std::endl;
 				}
-				subMesh.bounds.origin = (maxpos + minpos) / 2.f;
-				subMesh.bounds.extents = (maxpos - minpos) / 2.f;
-				subMesh.bounds.sphereRadius = glm::length(subMesh.bounds.extents);
+			}
+		}
 
-				newmesh->surfaces.push_back(subMesh);
+		// load materials
+		for (const ImportedMaterial& mat : import.materials)
+		{
+			std::shared_ptr<GLTFMaterial> newMat = std::make_shared<GLTFMaterial>();
+			materials.push_back(newMat);
+			file.materials[mat.name] = newMat;
+
+			GPUMaterialData constants;
+			constants.baseColorFactors = mat.baseColorFactors;
+			constants.metalRoughFactors = mat.metalRoughFactors;
+
+			// default the material textures
+			constants.colorTextureIndex = engine->m_whiteTextureIndex;
+			constants.colorSamplerIndex = engine->m_defaultSamplerLinearIndex;
+			constants.metalRoughTextureIndex = engine->m_whiteTextureIndex;
+			constants.metalRoughSamplerIndex = engine->m_defaultSamplerLinearIndex;
+
+			// grab textures from gltf file
+			if (mat.colorImage >= 0)
+			{
+				constants.colorTextureIndex = imageIndices[mat.colorImage];
+				constants.colorSamplerIndex = file.samplers[mat.colorSampler].index;
 			}
 
-			newmesh->meshBuffers = engine->uploadMesh(indices, vertices);
+			// build material
+			newMat->data = engine->m_metalRoughMaterial.writeMaterial(mat.passType, constants, bindless);
+			newMat->data.doubleSided = mat.doubleSided;
+			if (newMat->data.materialId == BindlessResources::InvalidIndex)
+			{
+				// the material buffer is full, the surfaces keep their pass but are shaded with the default material
+				newMat->data.materialId = engine->m_defaultMaterialIndex;
+			}
+			else
+			{
+				file.materialIds.push_back(newMat->data.materialId);
+			}
+		}
+
+		// meshes are finished in file order so the scene is the same as a sequential load
+		for (size_t i = 0; i < meshTasks.size(); i++)
+		{
+			if (meshTasks[i].valid())
+			{
+				meshTasks[i].get();
+				meshAssets[i] = assets.addMesh(meshKeys[i], meshBuffers[i]);
+
+				EngineStats& stats = engine->getStats();
+				const ImportedMesh& mesh = import.meshes[i];
+				stats.vertexMemory += mesh.vertices.size() * (meshBuffers[i].vertexFormat == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex));
+				stats.indexMemory += mesh.indices.size() * (meshBuffers[i].indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t));
+				stats.fullVertexMemory += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(uint32_t);
+			}
+			else if (meshAssets[i] == InvalidAssetId)
+			{
+				meshAssets[i] = assets.findMesh(meshKeys[i]);
+			}
+			file.meshAssets.push_back(meshAssets[i]);
+
+			const ImportedMesh& imported = import.meshes[i];
+			std::shared_ptr<MeshAsset> newmesh = std::make_shared<MeshAsset>();
+			meshes.push_back(newmesh);
+			file.meshes[imported.name] = newmesh;
+			newmesh->name = imported.name;
+			newmesh->meshBuffers = assets.getMesh(meshAssets[i]);
+
+			std::vector<std::shared_ptr<const OccluderMesh>> occluders;
+			if (occluderTasks[i].valid())
+			{
+				occluders = occluderTasks[i].get();
+			}
+			std::vector<std::shared_ptr<const TriangleBvh>> triangles;
+			if (triangleTasks[i].valid())
+			{
+				triangles = triangleTasks[i].get();
+			}
+
+			for (size_t s = 0; s < imported.surfaces.size(); s++)
+			{
+				const ImportedSurface& surface = imported.surfaces[s];
+				SubMesh subMesh;
+				subMesh.startIndex = surface.startIndex;
+				subMesh.count = surface.count;
+				subMesh.lodCount = surface.lodCount + 1;
+				subMesh.lods[0] = MeshLod{ surface.startIndex, surface.count, 0.f, surface.firstMeshlet, surface.meshletCount };
+				std::copy(surface.lods, surface.lods + surface.lodCount, subMesh.lods.begin() + 1);
+				subMesh.bounds = surface.bounds;
+				subMesh.material = materials[surface.materialIndex];
+				subMesh.occluder = s < occluders.size() ? occluders[s] : nullptr;
+				subMesh.triangles = s < triangles.size() ? triangles[s] : nullptr;
+				newmesh->surfaces.push_back(subMesh);
+			}
 		}
 
 		// load all nodes and their meshes
-		for (fastgltf::Node& node : gltf.nodes)
+		for (const ImportedNode& node : import.nodes)
 		{
 			std::shared_ptr<Node> newNode;
 
 			// find if the node has a mesh, and if it does hook it to the mesh pointer and allocate it with the meshnode class
-			if (node.meshIndex.has_value())
+			if (node.meshIndex >= 0)
 			{
 				newNode = std::make_shared<MeshNode>();
-				static_cast<MeshNode*>(newNode.get())->mesh = meshes[*node.meshIndex];
+				static_cast<MeshNode*>(newNode.get())->mesh = meshes[node.meshIndex];
 			}
 			else
 			{
@@ -475,53 +1221,75 @@ namespace Moon
 			}
 
 			nodes.push_back(newNode);
-			file.nodes[node.name.c_str()];
-
-			std::visit(fastgltf::visitor
-				{ 
-					[&](fastgltf::Node::TransformMatrix matrix) 
-					{
-						memcpy(&newNode->localTransform, matrix.data(), sizeof(matrix));								  
-					},
-					[&](fastgltf::Node::TRS transform)
-					{
-						glm::vec3 tl(transform.translation[0], transform.translation[1], transform.translation[2]);
-						glm::quat rot(transform.rotation[3], transform.rotation[0], transform.rotation[1], transform.rotation[2]);
-						glm::vec3 sc(transform.scale[0], transform.scale[1], transform.scale[2]);
-
-						glm::mat4 tm = glm::translate(glm::mat4(1.f), tl);
-						glm::mat4 rm = glm::toMat4(rot);
-						glm::mat4 sm = glm::scale(glm::mat4(1.f), sc);
-
-						newNode->localTransform = tm * rm * sm;
-					} 
-				},
-				node.transform);
+			file.nodes[node.name];
 		}
 
 		// run loop again to setup transform hierarchy
-		for (int i = 0; i < gltf.nodes.size(); i++)
+		for (size_t i = 0; i < import.nodes.size(); i++)
 		{
-			fastgltf::Node& node = gltf.nodes[i];
+			const ImportedNode& node = import.nodes[i];
 			std::shared_ptr<Node>& sceneNode = nodes[i];
 
-			for (auto& c : node.children)
+			for (uint32_t c = 0; c < node.childCount; c++)
 			{
-				sceneNode->children.push_back(nodes[c]);
-				nodes[c]->parent = sceneNode;
+				uint32_t child = import.children[node.firstChild + c];
+				sceneNode->children.push_back(nodes[child]);
+				nodes[child]->parent = sceneNode;
 			}
 		}
 
 		// find the top nodes, with no parents
-		for (auto& node : nodes)
+		std::vector<size_t> stack;
+		for (size_t i = 0; i < nodes.size(); i++)
 		{
-			if (node->parent.lock() == nullptr)
+			if (nodes[i]->parent.lock() == nullptr)
 			{
-				file.topNodes.push_back(node);
-				node->refreshTransform(glm::mat4{ 1.f });
+				file.topNodes.push_back(nodes[i]);
+				stack.push_back(i);
 			}
 		}
 
+		// flatten the node tree depth first so that parents are always stored before their children
+		file.hierarchy.reserve(nodes.size());
+		std::reverse(stack.begin(), stack.end());
+		while (!stack.empty())
+		{
+			size_t nodeIndex = stack.back();
+			stack.pop_back();
+
+			std::shared_ptr<Node>& node = nodes[nodeIndex];
+			std::shared_ptr<Node> parent = node->parent.lock();
+			uint32_t parentIndex = parent ? parent->hierarchyIndex : SceneHierarchy::InvalidIndex;
+
+			node->hierarchy = &file.hierarchy;
+			node->hierarchyIndex = file.hierarchy.addNode(parentIndex, import.nodes[nodeIndex].localTransform);
+			file.meshNodeLookup.push_back(SceneHierarchy::InvalidIndex);
+			if (MeshNode* meshNode = dynamic_cast<MeshNode*>(node.get()))
+			{
+				file.meshNodeLookup[node->hierarchyIndex] = static_cast<uint32_t>(file.meshNodes.size());
+				file.meshNodes.push_back(meshNode);
+			}
+
+			const ImportedNode& importedNode = import.nodes[nodeIndex];
+			for (uint32_t c = importedNode.childCount; c > 0; c--)
+			{
+				stack.push_back(import.children[importedNode.firstChild + c - 1]);
+			}
+		}
+		file.registerRenderObjects(engine->getRenderRegistry());
+		engine->getStats().sceneBuildTime += millisecondsSince(sceneStart);
+		engine->getStats().peakLoadMemory = getPeakResidentMemory();
+
 		return scene;
 	}
+
+	std::optional<std::shared_ptr<LoadedGLTF>> loadGltf(RenderDevice* engine, std::string_view filePath)
+	{
+		std::optional<SceneImport> import = importGltf(engine->getJobSystem(), filePath, engine->getStats(), engine->m_importSettings);
+		if (!import.has_value())
+		{
+			return {};
+		}
+		return createScene(engine, *import);
+	}
 }
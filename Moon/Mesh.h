@@ -1,7 +1,10 @@
 #pragma once
 #include "RenderTypes.h"
 #include "Descriptor.h"
+#include "UploadManager.h"
+#include "SamplerCache.h"
 
+#include <array>
 #include <filesystem>
 #include <unordered_map>
 
@@ -11,6 +14,12 @@ namespace Moon
 {
 	//Forward declaration
 	class RenderDevice;
+	class RenderObjectRegistry;
+	class TriangleBvh;
+
+	// id of a shared image or mesh in the device AssetRegistry
+	using AssetId = uint32_t;
+	constexpr AssetId InvalidAssetId = ~0u;
 
 	struct Vertex
 	{
@@ -21,17 +30,79 @@ namespace Moon
 		glm::vec4 color;
 	};
 
+	// 16 byte vertex decoded by mesh.vert: position quantized to unorm16 inside the bounds of its surface,
+	// octahedral snorm8 normal, half float uv and unorm8 color
+	struct CompactVertex
+	{
+		uint16_t position[3];
+		int8_t normal[2];
+		uint16_t uv[2];
+		uint32_t color;
+	};
+	static_assert(sizeof(CompactVertex) == 16);
+
+	enum class VertexFormat : uint32_t
+	{
+		Full = 0,    // Vertex
+		Compact = 1, // CompactVertex
+	};
+
+	// Cluster of at most MeshletMaxVertices vertices and MeshletMaxTriangles triangles, a contiguous range of the mesh
+	// indices. The bounds are in object space, clusterCull.comp reads this layout.
+	struct Meshlet
+	{
+		glm::vec3 center;
+		float radius;
+		glm::vec3 coneAxis; // zero when the triangles face too many directions to be culled together
+		float coneCutoff; // back facing for every eye with dot(center - eye, axis) >= cutoff * |center - eye| + radius
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t padding[2];
+	};
+	static_assert(sizeof(Meshlet) == 48);
+
+	constexpr uint32_t MeshletMaxVertices = 64;
+	constexpr uint32_t MeshletMaxTriangles = 124;
+
 	struct GPUMeshBuffers
 	{
 		AllocatedBuffer indexBuffer;
 		AllocatedBuffer vertexBuffer;
+		AllocatedBuffer meshletBuffer; // only allocated for meshes built with meshlets
 		VkDeviceAddress vertexBufferAddress;
+		VkDeviceAddress indexBufferAddress;
+		VkDeviceAddress meshletBufferAddress;
+		VkIndexType indexType;
+		VertexFormat vertexFormat;
+		uint32_t meshBufferId;
+		UploadTicket upload; // the buffers are usable by the GPU once the upload timeline reaches it
 	};
 
-	struct GPUDrawPushConstants
+	// per draw data, read by mesh.vert through the instance index
+	struct GPUObjectData
 	{
 		glm::mat4 worldMatrix;
 		VkDeviceAddress vertexBuffer;
+		uint32_t materialId;
+		VertexFormat vertexFormat;
+		glm::vec4 boundsOrigin; // dequantization box of compact positions
+		glm::vec4 boundsExtents;
+	};
+
+	// one meshlet of a draw to test in clusterCull.comp, the indices of the visible ones are copied after the
+	// firstIndex of the draw command and its indexCount grows accordingly
+	struct GPUClusterJob
+	{
+		VkDeviceAddress meshlet;
+		VkDeviceAddress indices;
+		uint32_t drawIndex;
+		uint32_t flags; // ClusterJobFlags
+	};
+
+	enum ClusterJobFlags : uint32_t
+	{
+		ClusterJobShortIndices = 1,
+		ClusterJobCullBackfaces = 2, // only set for transforms made of rotation and uniform scale
 	};
 
 	struct GLTFMaterial
@@ -46,12 +117,58 @@ namespace Moon
 		glm::vec3 extents;
 	};
 
+	// Index range of one level of detail of a surface. error is how far the simplification may have moved
+	// the surface, in object space units, 0 for the full detail level.
+	struct MeshLod
+	{
+		uint32_t startIndex;
+		uint32_t count;
+		float error;
+		uint32_t firstMeshlet; // meshlets covering the range, none when the mesh was built without them
+		uint32_t meshletCount;
+	};
+
+	constexpr uint32_t MaxMeshLods = 5; // the full detail range and up to four simplified ones
+
+	struct GPUCullLod
+	{
+		uint32_t startIndex;
+		uint32_t count;
+		float error;
+		uint32_t padding;
+	};
+
+	// persistent copy of an opaque render object tested by drawCull.comp, the visible ones append a draw command
+	// to the commands of their batch and pick their level of detail there
+	struct GPUCullObject
+	{
+		glm::vec4 center; // world box center, bounding sphere radius
+		glm::vec4 extents; // world box half extents, world to object scale of the level of detail errors
+		uint32_t batch;
+		uint32_t firstCommand; // of the batch
+		uint32_t lodCount;
+		uint32_t padding;
+		GPUCullLod lods[MaxMeshLods];
+	};
+	static_assert(sizeof(GPUCullObject) == 128);
+
+	// Simplified object space copy of a surface kept on the CPU, rasterized by the software occlusion culling
+	struct OccluderMesh
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+	};
+
 	struct SubMesh
 	{
 		uint32_t startIndex;
 		uint32_t count;
+		uint32_t lodCount;
+		std::array<MeshLod, MaxMeshLods> lods; // lods[0] is startIndex/count, coarser levels follow
 		Bounds bounds;
 		std::shared_ptr<GLTFMaterial> material;
+		std::shared_ptr<const OccluderMesh> occluder; // only for the surfaces flagged as occluders at load
+		std::shared_ptr<const TriangleBvh> triangles; // only when ImportSettings::buildTriangleBvhs is set
 	};
 
 	struct MeshAsset
@@ -63,14 +180,24 @@ namespace Moon
 
 	struct RenderObject
 	{
-		uint32_t indexCount;
+		uint32_t indexCount; // range of the selected level of detail
 		uint32_t firstIndex;
+		const MeshLod* lods; // levels of the surface, see RenderObjectRegistry::selectLods
+		uint32_t lodCount;
+		uint32_t lod; // kept between frames for the selection hysteresis
 		VkBuffer indexBuffer;
+		VkIndexType indexType;
+		uint32_t meshBufferId;
 
 		MaterialInstance* material;
 		Bounds bounds;
 		glm::mat4 transform;
 		VkDeviceAddress vertexBufferAddress;
+		VertexFormat vertexFormat;
+		VkDeviceAddress indexBufferAddress;
+		VkDeviceAddress meshletBufferAddress;
+		const OccluderMesh* occluder; // null when the surface does not hide other objects
+		const TriangleBvh* triangles; // object space ray queries, null when the surface is only hit on its box
 	};
 
 	struct DrawContext
@@ -82,28 +209,44 @@ namespace Moon
 	struct MeshNode : public Node
 	{
 		std::shared_ptr<MeshAsset> mesh;
+		std::vector<RenderObjectHandle> renderObjects; // one per surface, while registered
 
 		virtual void Draw(const glm::mat4& topMatrix, DrawContext& ctx);
+		void drawSurfaces(const glm::mat4& topMatrix, DrawContext& ctx);
 	};
 
 	struct LoadedGLTF : public IRenderable
 	{
 		std::unordered_map<std::string, std::shared_ptr<MeshAsset>> meshes;
 		std::unordered_map<std::string, std::shared_ptr<Node>> nodes;
-		std::unordered_map<std::string, AllocatedImage> images;
 		std::unordered_map<std::string, std::shared_ptr<GLTFMaterial>> materials;
 
 		std::vector<std::shared_ptr<Node>> topNodes;
 
-		std::vector<VkSampler> samplers;
-		DescriptorAllocator descriptorPool;
-		AllocatedBuffer materialDataBuffer;
+		SceneHierarchy hierarchy;
+		std::vector<MeshNode*> meshNodes; // in hierarchy order
+		std::vector<uint32_t> meshNodeLookup; // hierarchy index -> meshNodes index
+		glm::mat4 rootTransform{ 1.f };
+
+		std::vector<SamplerHandle> samplers; // references into the device sampler cache
+
+		// shared images and mesh buffers referenced by this file, ids in the device AssetRegistry
+		std::vector<AssetId> imageAssets;
+		std::vector<AssetId> meshAssets;
+
+		// bindless slots owned by this file
+		std::vector<uint32_t> materialIds;
 
 		RenderDevice* creator;
 
 		~LoadedGLTF() { clearAll(); };
 		virtual void Draw(const glm::mat4& topMatrix, DrawContext& ctx);
 
+		// retained mode: create the render objects once, then only push transform changes
+		void registerRenderObjects(RenderObjectRegistry& registry);
+		void unregisterRenderObjects(RenderObjectRegistry& registry);
+		void syncRenderObjects(RenderObjectRegistry& registry);
+
 	private:
 		void clearAll();
 	};
@@ -0,0 +1,355 @@
+#include "MeshOptimizer.h"
+#include "AssetRegistry.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace Moon
+{
+	// clusters may lose this much vertex cache efficiency to get a better draw order
+	constexpr float OverdrawThreshold = 1.05f;
+
+	// FIFO cache simulated with timestamps, a vertex is cached while fewer than cacheSize misses happened since its own
+	struct VertexCacheSimulation
+	{
+		std::vector<uint32_t> cacheTime;
+		uint32_t time;
+		uint32_t cacheSize;
+
+		VertexCacheSimulation(size_t vertexCount, uint32_t size)
+			: cacheTime(vertexCount, 0), time(size + 1), cacheSize(size)
+		{
+		}
+
+		bool access(uint32_t vertex)
+		{
+			if (time - cacheTime[vertex] <= cacheSize)
+			{
+				return false;
+			}
+			cacheTime[vertex] = time++;
+			return true;
+		}
+
+		void reset()
+		{
+			time += cacheSize + 1;
+		}
+	};
+
+	VertexCacheStats analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize)
+	{
+		VertexCacheSimulation cache(vertexCount, cacheSize);
+		std::vector<uint8_t> used(vertexCount, 0);
+		size_t misses = 0;
+		size_t usedCount = 0;
+		for (uint32_t index : indices)
+		{
+			misses += cache.access(index);
+			usedCount += !used[index];
+			used[index] = 1;
+		}
+
+		VertexCacheStats stats{ 0.f, 0.f };
+		if (indices.size() >= 3)
+		{
+			stats.acmr = float(misses) / float(indices.size() / 3);
+			stats.atvr = float(misses) / float(usedCount);
+		}
+		return stats;
+	}
+
+	// Tipsify, Sander et al. 2007: fans around the most recently cached vertex that stays cached for its remaining triangles
+	static std::vector<uint32_t> tipsify(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+		// triangles of every vertex
+		std::vector<uint32_t> offsets(vertexCount + 1, 0);
+		for (uint32_t index : indices)
+		{
+			offsets[index + 1]++;
+		}
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+		std::vector<uint32_t> adjacency(indices.size());
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (uint32_t i = 0; i < indices.size(); i++)
+		{
+			adjacency[fill[indices[i]]++] = i / 3;
+		}
+
+		std::vector<uint32_t> live(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			live[v] = offsets[v + 1] - offsets[v];
+		}
+
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		std::vector<uint32_t> deadEnd;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+
+		uint32_t time = cacheSize + 1;
+		uint32_t cursor = 0;
+
+		auto skipDeadEnd = [&]() -> int64_t
+			{
+				while (!deadEnd.empty())
+				{
+					uint32_t vertex = deadEnd.back();
+					deadEnd.pop_back();
+					if (live[vertex] > 0)
+					{
+						return vertex;
+					}
+				}
+				for (; cursor < vertexCount; cursor++)
+				{
+					if (live[cursor] > 0)
+					{
+						return cursor;
+					}
+				}
+				return -1;
+			};
+
+		int64_t fan = skipDeadEnd();
+		while (fan >= 0)
+		{
+			candidates.clear();
+			for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; a++)
+			{
+				uint32_t triangle = adjacency[a];
+				if (emitted[triangle])
+				{
+					continue;
+				}
+				emitted[triangle] = 1;
+
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					uint32_t vertex = indices[triangle * 3 + k];
+					result.push_back(vertex);
+					deadEnd.push_back(vertex);
+					candidates.push_back(vertex);
+					live[vertex]--;
+					if (time - cacheTime[vertex] > cacheSize)
+					{
+						cacheTime[vertex] = time++;
+					}
+				}
+			}
+
+			// the candidate that will still be cached once its remaining triangles are emitted, the oldest one first
+			int64_t next = -1;
+			int64_t bestPriority = -1;
+			for (uint32_t vertex : candidates)
+			{
+				if (live[vertex] == 0)
+				{
+					continue;
+				}
+				int64_t priority = 0;
+				if (time - cacheTime[vertex] + 2 * live[vertex] <= cacheSize)
+				{
+					priority = time - cacheTime[vertex];
+				}
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					next = vertex;
+				}
+			}
+			fan = next >= 0 ? next : skipDeadEnd();
+		}
+		return result;
+	}
+
+	// Splits the cache ordered triangles into clusters and draws the clusters facing away from the mesh center first,
+	// Sander et al. 2007. Clusters start where the cache is flushed anyway, or where splitting costs under OverdrawThreshold.
+	static std::vector<uint32_t> optimizeOverdraw(std::span<const uint32_t> indices, std::span<const Vertex> vertices, uint32_t cacheSize)
+	{
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		VertexCacheSimulation cache(vertices.size(), cacheSize);
+
+		auto triangleMisses = [&](uint32_t triangle)
+			{
+				return cache.access(indices[triangle * 3 + 0]) + cache.access(indices[triangle * 3 + 1]) + cache.access(indices[triangle * 3 + 2]);
+			};
+
+		// hard boundaries: triangles missing all their vertices
+		std::vector<uint32_t> hardClusters = { 0 };
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			if (triangleMisses(t) == 3 && t > 0)
+			{
+				hardClusters.push_back(t);
+			}
+		}
+		hardClusters.push_back(triangleCount);
+
+		// soft boundaries: split a hard cluster wherever the part before reaches its cache efficiency
+		std::vector<uint32_t> clusters;
+		for (size_t h = 0; h + 1 < hardClusters.size(); h++)
+		{
+			uint32_t start = hardClusters[h];
+			uint32_t end = hardClusters[h + 1];
+
+			cache.reset();
+			uint32_t clusterMisses = 0;
+			for (uint32_t t = start; t < end; t++)
+			{
+				clusterMisses += triangleMisses(t);
+			}
+			float threshold = OverdrawThreshold * float(clusterMisses) / float(end - start);
+
+			cache.reset();
+			clusters.push_back(start);
+			uint32_t misses = 0;
+			for (uint32_t t = start; t < end; t++)
+			{
+				misses += triangleMisses(t);
+				if (t + 1 < end && float(misses) <= threshold * float(t + 1 - clusters.back()))
+				{
+					clusters.push_back(t + 1);
+					cache.reset();
+					misses = 0;
+				}
+			}
+		}
+		clusters.push_back(triangleCount);
+
+		glm::vec3 meshCenter(0.f);
+		for (const Vertex& vertex : vertices)
+		{
+			meshCenter += vertex.position;
+		}
+		meshCenter /= float(std::max<size_t>(vertices.size(), 1));
+
+		// area weighted center and normal of every cluster
+		const size_t clusterCount = clusters.size() - 1;
+		std::vector<float> sortKeys(clusterCount);
+		for (size_t c = 0; c < clusterCount; c++)
+		{
+			glm::vec3 center(0.f);
+			glm::vec3 normal(0.f);
+			float area = 0.f;
+			for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++)
+			{
+				glm::vec3 p0 = vertices[indices[t * 3 + 0]].position;
+				glm::vec3 p1 = vertices[indices[t * 3 + 1]].position;
+				glm::vec3 p2 = vertices[indices[t * 3 + 2]].position;
+				glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+				float triangleArea = glm::length(n);
+
+				center += (p0 + p1 + p2) * (triangleArea / 3.f);
+				normal += n;
+				area += triangleArea;
+			}
+
+			float normalLength = glm::length(normal);
+			sortKeys[c] = area > 0.f && normalLength > 0.f ? glm::dot(center / area - meshCenter, normal / normalLength) : 0.f;
+		}
+
+		std::vector<uint32_t> order(clusterCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+		for (uint32_t c : order)
+		{
+			result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+		}
+		return result;
+	}
+
+	struct VertexHash
+	{
+		size_t operator()(const Vertex& vertex) const
+		{
+			return static_cast<size_t>(hashBytes({ reinterpret_cast<const uint8_t*>(&vertex), sizeof(Vertex) }));
+		}
+	};
+
+	struct VertexEqual
+	{
+		bool operator()(const Vertex& a, const Vertex& b) const
+		{
+			return memcmp(&a, &b, sizeof(Vertex)) == 0;
+		}
+	};
+
+	MeshOptimizationReport optimizeMesh(ImportedMesh& mesh)
+	{
+		MeshOptimizationReport report;
+		report.vertexCountBefore = mesh.vertices.size();
+		report.before = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices(mesh.indices.begin(), mesh.indices.end());
+		vertices.reserve(mesh.vertices.size());
+
+		std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> welded;
+		std::vector<uint32_t> local;
+		for (const ImportedSurface& surface : mesh.surfaces)
+		{
+			// each surface gets its own vertices, their positions are quantized with the surface bounds
+			const uint32_t base = static_cast<uint32_t>(vertices.size());
+			welded.clear();
+			local.resize(surface.count);
+			for (uint32_t i = 0; i < surface.count; i++)
+			{
+				const Vertex& vertex = mesh.vertices[mesh.indices[surface.startIndex + i]];
+				auto [it, inserted] = welded.try_emplace(vertex, static_cast<uint32_t>(vertices.size()));
+				if (inserted)
+				{
+					vertices.push_back(vertex);
+				}
+				local[i] = it->second - base;
+			}
+
+			std::span<const Vertex> surfaceVertices(vertices.data() + base, vertices.size() - base);
+			if (surface.count >= 3 && surface.count % 3 == 0)
+			{
+				local = tipsify(local, static_cast<uint32_t>(surfaceVertices.size()), VertexCacheSize);
+				local = optimizeOverdraw(local, surfaceVertices, VertexCacheSize);
+			}
+
+			for (uint32_t i = 0; i < surface.count; i++)
+			{
+				indices[surface.startIndex + i] = local[i] + base;
+			}
+		}
+
+		// vertices in the order the indices first use them
+		constexpr uint32_t unused = ~0u;
+		std::vector<uint32_t> remap(vertices.size(), unused);
+		std::vector<Vertex> fetchOrdered;
+		fetchOrdered.reserve(vertices.size());
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == unused)
+			{
+				remap[index] = static_cast<uint32_t>(fetchOrdered.size());
+				fetchOrdered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+
+		mesh.vertexStorage = std::move(fetchOrdered);
+		mesh.indexStorage = std::move(indices);
+		mesh.vertices = mesh.vertexStorage;
+		mesh.indices = mesh.indexStorage;
+
+		report.vertexCountAfter = mesh.vertices.size();
+		report.after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+		return report;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "SceneImport.h"
+
+namespace Moon
+{
+	// Post transform vertex cache statistics of an index buffer, simulated with a FIFO cache
+	struct VertexCacheStats
+	{
+		float acmr; // vertex shader invocations per triangle, 0.5 at best, 3 at worst
+		float atvr; // vertex shader invocations per vertex, 1 at best
+	};
+
+	constexpr uint32_t VertexCacheSize = 16;
+
+	VertexCacheStats analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize = VertexCacheSize);
+
+	struct MeshOptimizationReport
+	{
+		size_t vertexCountBefore;
+		size_t vertexCountAfter;
+		VertexCacheStats before;
+		VertexCacheStats after;
+	};
+
+	// Rewrites the vertices and indices of an imported mesh, surface by surface:
+	//  - welds the bitwise identical vertices
+	//  - reorders the triangles for the vertex cache (Tipsify)
+	//  - sorts the resulting clusters so the outer ones are drawn first, to reduce overdraw
+	//  - reorders the vertices in the order the indices first use them, for fetch locality
+	// Surfaces keep their index range and bounds, their vertices stay separate from the other surfaces.
+	MeshOptimizationReport optimizeMesh(ImportedMesh& mesh);
+}
@@ -0,0 +1,321 @@
+#include "MeshSimplifier.h"
+#include "AssetRegistry.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
+namespace Moon
+{
+	// surfaces under this many triangles are cheap enough at full detail
+	constexpr uint32_t MinLodTriangles = 32;
+	// a level may move the surface by this fraction of its bounding sphere radius at most
+	constexpr float MaxLodError = 0.25f;
+
+	// Sum of area weighted squared distances to a set of planes, x^T A x + 2 b.x + c
+	struct Quadric
+	{
+		double a00, a01, a02, a11, a12, a22;
+		double b0, b1, b2;
+		double c;
+		double weight;
+
+		void addPlane(const glm::dvec3& n, double d, double w)
+		{
+			a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+			a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+			b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+			c += w * d * d;
+			weight += w;
+		}
+
+		void add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02;
+			a11 += q.a11; a12 += q.a12; a22 += q.a22;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2;
+			c += q.c;
+			weight += q.weight;
+		}
+
+		double evaluate(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double r = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+			return std::max(r, 0.0);
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double cost; // mean squared distance over the merged area
+	};
+
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& position) const
+		{
+			return static_cast<size_t>(hashBytes({ reinterpret_cast<const uint8_t*>(&position), sizeof(position) }));
+		}
+	};
+
+	static uint64_t edgeKey(uint32_t a, uint32_t b)
+	{
+		return (uint64_t(a) << 32) | b;
+	}
+
+	// locks the vertices sharing their position with another vertex, and the vertices of edges that are not
+	// shared by exactly two opposite triangles
+	static std::vector<uint8_t> findLockedVertices(std::span<const uint32_t> indices, std::span<const Vertex> vertices)
+	{
+		std::vector<uint8_t> locked(vertices.size(), 0);
+		std::vector<uint32_t> positionIds(vertices.size());
+		std::iota(positionIds.begin(), positionIds.end(), 0);
+
+		std::unordered_map<glm::vec3, uint32_t, PositionHash> positions;
+		for (uint32_t index : indices)
+		{
+			auto [it, inserted] = positions.try_emplace(vertices[index].position, index);
+			if (it->second != index)
+			{
+				locked[index] = 1;
+				locked[it->second] = 1;
+			}
+			positionIds[index] = it->second;
+		}
+
+		std::unordered_map<uint64_t, uint32_t> edges;
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			uint32_t a = positionIds[indices[i]];
+			uint32_t b = positionIds[indices[i - i % 3 + (i + 1) % 3]];
+			edges[edgeKey(a, b)]++;
+		}
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			uint32_t a = indices[i];
+			uint32_t b = indices[i - i % 3 + (i + 1) % 3];
+			auto reverse = edges.find(edgeKey(positionIds[b], positionIds[a]));
+			if (reverse == edges.end() || reverse->second != 1 || edges[edgeKey(positionIds[a], positionIds[b])] != 1)
+			{
+				locked[a] = 1;
+				locked[b] = 1;
+			}
+		}
+		return locked;
+	}
+
+	// moving from onto to must not turn any remaining triangle around from over or into a sliver
+	static bool flipsTriangles(const Collapse& collapse, std::span<const uint32_t> indices, std::span<const Vertex> vertices,
+		std::span<const uint32_t> offsets, std::span<const uint32_t> adjacency)
+	{
+		const glm::vec3 target = vertices[collapse.to].position;
+		for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++)
+		{
+			const uint32_t* triangle = &indices[adjacency[a] * 3];
+			if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+			{
+				continue;
+			}
+
+			glm::vec3 before[3];
+			glm::vec3 after[3];
+			for (int k = 0; k < 3; k++)
+			{
+				before[k] = vertices[triangle[k]].position;
+				after[k] = triangle[k] == collapse.from ? target : before[k];
+			}
+			glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+			if (glm::dot(n0, n1) <= 1e-2f * glm::length(n0) * glm::length(n1))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::vector<uint32_t> simplifyMesh(std::span<const uint32_t> indices, std::span<const Vertex> vertices,
+		size_t targetIndexCount, float maxError, float& error)
+	{
+		error = 0.f;
+		std::vector<uint32_t> result(indices.begin(), indices.end());
+		if (result.size() <= targetIndexCount || result.size() % 3 != 0)
+		{
+			return result;
+		}
+
+		const size_t vertexCount = vertices.size();
+		std::vector<uint8_t> locked = findLockedVertices(indices, vertices);
+
+		std::vector<Quadric> quadrics(vertexCount, Quadric{});
+		for (size_t t = 0; t < result.size(); t += 3)
+		{
+			glm::dvec3 p0 = vertices[result[t + 0]].position;
+			glm::dvec3 p1 = vertices[result[t + 1]].position;
+			glm::dvec3 p2 = vertices[result[t + 2]].position;
+			glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+			double length = glm::length(n);
+			if (length == 0.0)
+			{
+				continue;
+			}
+			n /= length;
+			for (int k = 0; k < 3; k++)
+			{
+				quadrics[result[t + k]].addPlane(n, -glm::dot(n, p0), length * 0.5);
+			}
+		}
+
+		auto collapseCost = [&](uint32_t from, uint32_t to)
+			{
+				const glm::vec3& p = vertices[to].position;
+				double weight = quadrics[from].weight + quadrics[to].weight;
+				return weight > 0.0 ? (quadrics[from].evaluate(p) + quadrics[to].evaluate(p)) / weight : 0.0;
+			};
+
+		const double maxCost = double(maxError) * double(maxError);
+		double reachedCost = 0.0;
+
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> adjacency;
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<uint8_t> touched(vertexCount);
+		std::vector<Collapse> collapses;
+
+		// every pass collapses the cheapest independent edges, the vertices around a collapse wait for the next pass
+		while (result.size() > targetIndexCount)
+		{
+			offsets.assign(vertexCount + 1, 0);
+			for (uint32_t index : result)
+			{
+				offsets[index + 1]++;
+			}
+			std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+			adjacency.resize(result.size());
+			std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for (uint32_t i = 0; i < result.size(); i++)
+			{
+				adjacency[fill[result[i]]++] = i / 3;
+			}
+
+			collapses.clear();
+			for (size_t i = 0; i < result.size(); i++)
+			{
+				uint32_t a = result[i];
+				uint32_t b = result[i - i % 3 + (i + 1) % 3];
+				if (!locked[a])
+				{
+					collapses.push_back(Collapse{ a, b, collapseCost(a, b) });
+				}
+				if (!locked[b])
+				{
+					collapses.push_back(Collapse{ b, a, collapseCost(b, a) });
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+			std::iota(remap.begin(), remap.end(), 0);
+			std::fill(touched.begin(), touched.end(), 0);
+
+			// a collapse removes the two triangles of its edge
+			const size_t budget = (result.size() - targetIndexCount) / 3;
+			size_t removed = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (removed >= budget || collapse.cost > maxCost)
+				{
+					break;
+				}
+				if (touched[collapse.from] || touched[collapse.to] || flipsTriangles(collapse, result, vertices, offsets, adjacency))
+				{
+					continue;
+				}
+
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to].add(quadrics[collapse.from]);
+				for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++)
+				{
+					uint32_t triangle = adjacency[a];
+					touched[result[triangle * 3 + 0]] = 1;
+					touched[result[triangle * 3 + 1]] = 1;
+					touched[result[triangle * 3 + 2]] = 1;
+				}
+				touched[collapse.to] = 1;
+				reachedCost = std::max(reachedCost, collapse.cost);
+				removed += 2;
+			}
+			if (removed == 0)
+			{
+				break;
+			}
+
+			size_t write = 0;
+			for (size_t t = 0; t < result.size(); t += 3)
+			{
+				uint32_t a = remap[result[t + 0]];
+				uint32_t b = remap[result[t + 1]];
+				uint32_t c = remap[result[t + 2]];
+				if (a != b && b != c && a != c)
+				{
+					result[write++] = a;
+					result[write++] = b;
+					result[write++] = c;
+				}
+			}
+			result.resize(write);
+		}
+
+		error = static_cast<float>(std::sqrt(reachedCost));
+		return result;
+	}
+
+	LodGenerationReport generateLods(ImportedMesh& mesh)
+	{
+		LodGenerationReport report{};
+		std::vector<uint32_t> indices(mesh.indices.begin(), mesh.indices.end());
+
+		for (ImportedSurface& surface : mesh.surfaces)
+		{
+			report.triangleCounts[0] += surface.count / 3;
+			surface.lodCount = 0;
+			if (surface.count < MinLodTriangles * 3 || surface.count % 3 != 0)
+			{
+				continue;
+			}
+
+			// every level is simplified from the full detail indices so the quadrics measure the whole distance
+			std::span<const uint32_t> source(mesh.indices.data() + surface.startIndex, surface.count);
+			size_t previousCount = surface.count;
+			float previousError = 0.f;
+			for (uint32_t level = 1; level < MaxMeshLods; level++)
+			{
+				size_t target = size_t(surface.count / 3 >> level) * 3;
+				float error;
+				std::vector<uint32_t> lod = simplifyMesh(source, mesh.vertices, target, surface.bounds.sphereRadius * MaxLodError, error);
+
+				// stop once the locked vertices or the error limit keep the level close to the previous one
+				if (lod.empty() || lod.size() > previousCount * 3 / 4)
+				{
+					break;
+				}
+
+				previousError = std::max(previousError, error);
+				surface.lods[surface.lodCount++] = MeshLod{ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lod.size()), previousError };
+				indices.insert(indices.end(), lod.begin(), lod.end());
+				report.triangleCounts[level] += lod.size() / 3;
+				previousCount = lod.size();
+			}
+		}
+
+		mesh.indexStorage = std::move(indices);
+		mesh.indices = mesh.indexStorage;
+		return report;
+	}
+}
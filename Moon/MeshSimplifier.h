@@ -0,0 +1,21 @@
+#pragma once
+#include "SceneImport.h"
+
+namespace Moon
+{
+	// Quadric error metric simplification, Garland & Heckbert 1997. Edges collapse onto one of their existing vertices
+	// so every level shares the vertices of the mesh. Vertices on open borders and on attribute seams (several vertices
+	// at the same position) never move. Stops once the indices are down to targetIndexCount or the next collapse would
+	// move the surface by more than maxError, error receives the distance reached, in the units of the positions.
+	std::vector<uint32_t> simplifyMesh(std::span<const uint32_t> indices, std::span<const Vertex> vertices,
+		size_t targetIndexCount, float maxError, float& error);
+
+	struct LodGenerationReport
+	{
+		size_t triangleCounts[MaxMeshLods]; // summed over the surfaces, the full detail level first
+	};
+
+	// Appends up to MaxMeshLods - 1 simplified index ranges per surface after the mesh indices, each level has about
+	// half the triangles of the previous one. Surfaces that do not simplify any further get fewer levels.
+	LodGenerationReport generateLods(ImportedMesh& mesh);
+}
@@ -0,0 +1,293 @@
+#include "MeshletBuilder.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace Moon
+{
+	// meshlets whose normals spread further than this from their average are never back face culled
+	constexpr float MinConeDot = 0.1f;
+
+	static Meshlet computeMeshletBounds(std::span<const uint32_t> indices, std::span<const Vertex> vertices, uint32_t firstIndex)
+	{
+		Meshlet meshlet{};
+		meshlet.firstIndex = firstIndex;
+		meshlet.indexCount = static_cast<uint32_t>(indices.size());
+
+		glm::vec3 minPos(std::numeric_limits<float>::max());
+		glm::vec3 maxPos(std::numeric_limits<float>::lowest());
+		for (uint32_t index : indices)
+		{
+			minPos = glm::min(minPos, vertices[index].position);
+			maxPos = glm::max(maxPos, vertices[index].position);
+		}
+		meshlet.center = (minPos + maxPos) * 0.5f;
+		for (uint32_t index : indices)
+		{
+			meshlet.radius = std::max(meshlet.radius, glm::length(vertices[index].position - meshlet.center));
+		}
+
+		std::vector<glm::vec3> normals;
+		normals.reserve(indices.size() / 3);
+		glm::vec3 axis(0.f);
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			glm::vec3 p0 = vertices[indices[t + 0]].position;
+			glm::vec3 p1 = vertices[indices[t + 1]].position;
+			glm::vec3 p2 = vertices[indices[t + 2]].position;
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			float length = glm::length(n);
+			if (length > 0.f)
+			{
+				normals.push_back(n / length);
+				axis += normals.back();
+			}
+		}
+
+		float axisLength = glm::length(axis);
+		if (normals.empty() || axisLength == 0.f)
+		{
+			meshlet.coneCutoff = 1.f;
+			return meshlet;
+		}
+		axis /= axisLength;
+
+		float minDot = 1.f;
+		for (const glm::vec3& n : normals)
+		{
+			minDot = std::min(minDot, glm::dot(n, axis));
+		}
+
+		if (minDot <= MinConeDot)
+		{
+			meshlet.coneCutoff = 1.f;
+			return meshlet;
+		}
+		meshlet.coneAxis = axis;
+		meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+		return meshlet;
+	}
+
+	// regroups indices[0, count) of one surface or level into meshlets, appended to meshlets
+	static void buildRangeMeshlets(std::span<uint32_t> indices, uint32_t firstIndex, std::span<const Vertex> vertices,
+		std::vector<uint32_t>& localIds, std::vector<Meshlet>& meshlets)
+	{
+		constexpr uint32_t none = ~0u;
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+		// local vertex ids, so the adjacency only spans the vertices of the range
+		std::vector<uint32_t> globalIds;
+		std::vector<uint32_t> local(indices.size());
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			uint32_t& id = localIds[indices[i]];
+			if (id == none)
+			{
+				id = static_cast<uint32_t>(globalIds.size());
+				globalIds.push_back(indices[i]);
+			}
+			local[i] = id;
+		}
+		for (uint32_t global : globalIds)
+		{
+			localIds[global] = none;
+		}
+
+		const uint32_t vertexCount = static_cast<uint32_t>(globalIds.size());
+		std::vector<uint32_t> offsets(vertexCount + 1, 0);
+		for (uint32_t id : local)
+		{
+			offsets[id + 1]++;
+		}
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+		std::vector<uint32_t> adjacency(local.size());
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (uint32_t i = 0; i < local.size(); i++)
+		{
+			adjacency[fill[local[i]]++] = i / 3;
+		}
+		std::vector<uint32_t> live(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			live[v] = offsets[v + 1] - offsets[v];
+		}
+
+		auto centroid = [&](uint32_t triangle)
+			{
+				return (vertices[indices[triangle * 3 + 0]].position + vertices[indices[triangle * 3 + 1]].position +
+					vertices[indices[triangle * 3 + 2]].position) / 3.f;
+			};
+
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		std::vector<uint32_t> meshletOf(vertexCount, none); // last meshlet using each vertex
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint32_t> meshletTriangles;
+		std::vector<uint32_t> order;
+		std::vector<uint32_t> meshletSizes;
+		order.reserve(triangleCount);
+		glm::vec3 center(0.f);
+		uint32_t meshletId = 0;
+		uint32_t cursor = 0;
+
+		auto newVertices = [&](uint32_t triangle)
+			{
+				return uint32_t(meshletOf[local[triangle * 3 + 0]] != meshletId) + uint32_t(meshletOf[local[triangle * 3 + 1]] != meshletId) +
+					uint32_t(meshletOf[local[triangle * 3 + 2]] != meshletId);
+			};
+
+		auto flush = [&]()
+			{
+				if (meshletTriangles.empty())
+				{
+					return;
+				}
+				order.insert(order.end(), meshletTriangles.begin(), meshletTriangles.end());
+				meshletSizes.push_back(static_cast<uint32_t>(meshletTriangles.size()));
+				meshletTriangles.clear();
+				meshletVertices.clear();
+				meshletId++;
+			};
+
+		for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+		{
+			// the neighbour adding the fewest vertices, then the closest to the meshlet
+			int64_t best = -1;
+			uint32_t bestNew = 4;
+			float bestDistance = 0.f;
+			for (uint32_t vertex : meshletVertices)
+			{
+				if (live[vertex] == 0)
+				{
+					continue;
+				}
+				for (uint32_t a = offsets[vertex]; a < offsets[vertex + 1]; a++)
+				{
+					uint32_t triangle = adjacency[a];
+					if (emitted[triangle])
+					{
+						continue;
+					}
+					uint32_t added = newVertices(triangle);
+					if (meshletVertices.size() + added > MeshletMaxVertices || added > bestNew)
+					{
+						continue;
+					}
+					glm::vec3 offset = centroid(triangle) - center;
+					float distance = glm::dot(offset, offset);
+					if (added < bestNew || distance < bestDistance)
+					{
+						best = triangle;
+						bestNew = added;
+						bestDistance = distance;
+					}
+				}
+			}
+
+			// no neighbour fits, start a new meshlet from the next triangle in index order
+			if (best < 0)
+			{
+				flush();
+				while (emitted[cursor])
+				{
+					cursor++;
+				}
+				best = cursor;
+			}
+
+			uint32_t triangle = static_cast<uint32_t>(best);
+			emitted[triangle] = 1;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint32_t vertex = local[triangle * 3 + k];
+				live[vertex]--;
+				if (meshletOf[vertex] != meshletId)
+				{
+					meshletOf[vertex] = meshletId;
+					meshletVertices.push_back(vertex);
+				}
+			}
+			meshletTriangles.push_back(triangle);
+			center += (centroid(triangle) - center) / float(meshletTriangles.size());
+
+			if (meshletTriangles.size() == MeshletMaxTriangles)
+			{
+				flush();
+			}
+		}
+		flush();
+
+		// rewrite the range in meshlet order
+		std::vector<uint32_t> source(indices.begin(), indices.end());
+		for (uint32_t i = 0; i < triangleCount; i++)
+		{
+			indices[i * 3 + 0] = source[order[i] * 3 + 0];
+			indices[i * 3 + 1] = source[order[i] * 3 + 1];
+			indices[i * 3 + 2] = source[order[i] * 3 + 2];
+		}
+
+		uint32_t start = 0;
+		for (uint32_t size : meshletSizes)
+		{
+			std::span<const uint32_t> meshletIndices = indices.subspan(start * 3, size * 3);
+			meshlets.push_back(computeMeshletBounds(meshletIndices, vertices, firstIndex + start * 3));
+			start += size;
+		}
+	}
+
+	MeshletReport buildMeshlets(ImportedMesh& mesh)
+	{
+		std::vector<uint32_t> indices(mesh.indices.begin(), mesh.indices.end());
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> localIds(mesh.vertices.size(), ~0u);
+
+		auto build = [&](uint32_t startIndex, uint32_t count, uint32_t& firstMeshlet, uint32_t& meshletCount)
+			{
+				firstMeshlet = static_cast<uint32_t>(meshlets.size());
+				if (count >= 3 && count % 3 == 0)
+				{
+					buildRangeMeshlets(std::span<uint32_t>(indices.data() + startIndex, count), startIndex, mesh.vertices, localIds, meshlets);
+				}
+				meshletCount = static_cast<uint32_t>(meshlets.size()) - firstMeshlet;
+			};
+
+		for (ImportedSurface& surface : mesh.surfaces)
+		{
+			build(surface.startIndex, surface.count, surface.firstMeshlet, surface.meshletCount);
+			for (uint32_t lod = 0; lod < surface.lodCount; lod++)
+			{
+				build(surface.lods[lod].startIndex, surface.lods[lod].count, surface.lods[lod].firstMeshlet, surface.lods[lod].meshletCount);
+			}
+		}
+
+		MeshletReport report{ meshlets.size(), 0.f, 0.f };
+		for (const Meshlet& meshlet : meshlets)
+		{
+			report.averageTriangles += float(meshlet.indexCount / 3);
+			for (uint32_t i = 0; i < meshlet.indexCount; i++)
+			{
+				uint32_t& id = localIds[indices[meshlet.firstIndex + i]];
+				report.averageVertices += id == ~0u;
+				id = 0;
+			}
+			for (uint32_t i = 0; i < meshlet.indexCount; i++)
+			{
+				localIds[indices[meshlet.firstIndex + i]] = ~0u;
+			}
+		}
+		if (!meshlets.empty())
+		{
+			report.averageVertices /= float(meshlets.size());
+			report.averageTriangles /= float(meshlets.size());
+		}
+
+		mesh.indexStorage = std::move(indices);
+		mesh.meshletStorage = std::move(meshlets);
+		mesh.indices = mesh.indexStorage;
+		mesh.meshlets = mesh.meshletStorage;
+		return report;
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "SceneImport.h"
+
+namespace Moon
+{
+	struct MeshletReport
+	{
+		size_t meshletCount;
+		float averageVertices; // unique vertices per meshlet
+		float averageTriangles;
+	};
+
+	// Splits the index range of every surface and level of detail into meshlets: the triangles are regrouped in place
+	// so each meshlet is a contiguous run of indices, grown greedily from its neighbouring triangles. Computes the
+	// bounding sphere and the normal cone of every meshlet.
+	MeshletReport buildMeshlets(ImportedMesh& mesh);
+}
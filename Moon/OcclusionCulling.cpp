@@ -0,0 +1,556 @@
+#include "OcclusionCulling.h"
+#include "JobSystem.h"
+#include "MeshSimplifier.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MOON_OCCLUSION_SSE
+#endif
+
+namespace Moon
+{
+	constexpr int32_t TileSize = 8; // a tile mask holds 8 rows of 8 bits
+	constexpr uint32_t TilesX = OcclusionBufferWidth / TileSize;
+	constexpr uint32_t TilesY = OcclusionBufferHeight / TileSize;
+	static_assert(OcclusionBufferWidth % TileSize == 0 && OcclusionBufferHeight % TileSize == 0);
+
+	// occluders whose bounding sphere projects smaller than this many pixels of the window hide too little
+	constexpr float OccluderMinScreenRadius = 24.f;
+	// triangles rasterized per frame, the largest occluders go first
+	constexpr uint32_t OccluderTriangleBudget = 16384;
+	// per occluder mesh, and the surfaces too large to simplify at load are not occluders
+	constexpr uint32_t OccluderMaxTriangles = 1024;
+	constexpr uint32_t OccluderMaxSourceTriangles = 65536;
+	// an occluder may move the surface by this fraction of its bounding sphere radius at most, its vertices are then
+	// pulled inward by the error reached so it stays behind the real surface
+	constexpr float OccluderMaxError = 0.02f;
+	// twice the area in pixels under which a triangle is skipped
+	constexpr float MinTriangleArea = 1e-3f;
+	constexpr uint32_t OccludeeBatchSize = 256;
+
+	// Left and right pixel bounds, [left, right), of the rows of a tile whose centers are inside the triangle
+	static void computeSpans(const float* edgeA, const float* edgeB, const float* edgeC, float top, int32_t* left, int32_t* right)
+	{
+#if defined(MOON_OCCLUSION_SSE)
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 width = _mm_set1_ps(float(OcclusionBufferWidth));
+		for (int32_t row = 0; row < TileSize; row += 4)
+		{
+			__m128 y = _mm_add_ps(_mm_set1_ps(top + float(row) + 0.5f), _mm_setr_ps(0.f, 1.f, 2.f, 3.f));
+			__m128 l = zero;
+			__m128 r = width;
+			for (int e = 0; e < 3; e++)
+			{
+				// a x + b y + c >= 0 bounds x on one side, the side of the sign of a
+				__m128 offset = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeB[e]), y), _mm_set1_ps(edgeC[e]));
+				if (edgeA[e] > 0.f)
+				{
+					l = _mm_max_ps(_mm_mul_ps(offset, _mm_set1_ps(-1.f / edgeA[e])), l);
+				}
+				else if (edgeA[e] < 0.f)
+				{
+					r = _mm_min_ps(_mm_mul_ps(offset, _mm_set1_ps(-1.f / edgeA[e])), r);
+				}
+				else
+				{
+					r = _mm_andnot_ps(_mm_cmplt_ps(offset, zero), r);
+				}
+			}
+			l = _mm_min_ps(l, width);
+			r = _mm_max_ps(r, zero);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(left + row), _mm_cvttps_epi32(_mm_add_ps(l, half)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(right + row), _mm_cvttps_epi32(_mm_add_ps(r, half)));
+		}
+#else
+		for (int32_t row = 0; row < TileSize; row++)
+		{
+			float y = top + float(row) + 0.5f;
+			float l = 0.f;
+			float r = float(OcclusionBufferWidth);
+			for (int e = 0; e < 3; e++)
+			{
+				float offset = edgeB[e] * y + edgeC[e];
+				if (edgeA[e] > 0.f)
+				{
+					l = std::max(l, -offset / edgeA[e]);
+				}
+				else if (edgeA[e] < 0.f)
+				{
+					r = std::min(r, -offset / edgeA[e]);
+				}
+				else if (offset < 0.f)
+				{
+					r = 0.f;
+				}
+			}
+			left[row] = static_cast<int32_t>(std::min(l, float(OcclusionBufferWidth)) + 0.5f);
+			right[row] = static_cast<int32_t>(std::max(r, 0.f) + 0.5f);
+		}
+#endif
+	}
+
+	SoftwareOcclusionCuller::SoftwareOcclusionCuller()
+	{
+		clear();
+	}
+
+	void SoftwareOcclusionCuller::clear()
+	{
+		// nothing is hidden behind the far plane, the working layers start empty
+		m_farReference.assign(TilesX * TilesY, 0.f);
+		m_farWorking.assign(TilesX * TilesY, 1.f);
+		m_masks.assign(TilesX * TilesY, 0);
+		m_active = false;
+	}
+
+	void SoftwareOcclusionCuller::renderOccluders(std::span<const RenderObject> surfaces, const CullingBounds& bounds, std::span<const uint32_t> visibleIndices,
+		const glm::mat4& viewProj, const glm::vec3& cameraPosition, float projectionScale, JobSystem* jobSystem)
+	{
+		clear();
+		m_viewProj = viewProj;
+		m_stats = OcclusionStats{};
+
+		struct Candidate
+		{
+			uint32_t index;
+			float screenRadius;
+		};
+
+		std::vector<Candidate> candidates;
+		for (uint32_t i : visibleIndices)
+		{
+			if (surfaces[i].occluder == nullptr)
+			{
+				continue;
+			}
+
+			// the objects around the camera always qualify
+			glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+			float distance = glm::length(center - cameraPosition) - bounds.radius[i];
+			float screenRadius = distance > 0.f ? bounds.radius[i] / distance * projectionScale : std::numeric_limits<float>::max();
+			if (screenRadius >= OccluderMinScreenRadius)
+			{
+				candidates.push_back(Candidate{ i, screenRadius });
+			}
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.screenRadius > b.screenRadius; });
+
+		// clipping splits a triangle in two at most, every occluder gets its own range of the triangles
+		m_occluders.clear();
+		std::vector<uint32_t> firstTriangles;
+		uint32_t budget = OccluderTriangleBudget;
+		uint32_t capacity = 0;
+		for (const Candidate& candidate : candidates)
+		{
+			uint32_t triangleCount = static_cast<uint32_t>(surfaces[candidate.index].occluder->indices.size() / 3);
+			if (triangleCount > budget)
+			{
+				continue;
+			}
+			budget -= triangleCount;
+			m_occluders.push_back(candidate.index);
+			firstTriangles.push_back(capacity);
+			capacity += triangleCount * 2;
+		}
+		if (m_occluders.empty())
+		{
+			return;
+		}
+
+		m_triangles.resize(capacity);
+		std::vector<uint32_t> triangleCounts(m_occluders.size(), 0);
+		auto setup = [&](uint32_t begin, uint32_t end)
+			{
+				std::vector<glm::vec4> clipPositions;
+				for (uint32_t o = begin; o < end; o++)
+				{
+					const RenderObject& object = surfaces[m_occluders[o]];
+					triangleCounts[o] = addOccluder(*object.occluder, viewProj * object.transform, clipPositions, m_triangles.data() + firstTriangles[o]);
+				}
+			};
+		if (jobSystem != nullptr)
+		{
+			jobSystem->parallelFor(static_cast<uint32_t>(m_occluders.size()), 4, setup);
+		}
+		else
+		{
+			setup(0, static_cast<uint32_t>(m_occluders.size()));
+		}
+
+		uint32_t triangleCount = 0;
+		for (size_t o = 0; o < m_occluders.size(); o++)
+		{
+			std::move(m_triangles.begin() + firstTriangles[o], m_triangles.begin() + firstTriangles[o] + triangleCounts[o], m_triangles.begin() + triangleCount);
+			triangleCount += triangleCounts[o];
+		}
+		m_triangles.resize(triangleCount);
+
+		// every row of tiles belongs to a single job, the tiles are updated in the same triangle order whatever the threading
+		auto rasterize = [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t tileRow = begin; tileRow < end; tileRow++)
+				{
+					rasterizeTileRow(tileRow);
+				}
+			};
+		if (jobSystem != nullptr)
+		{
+			jobSystem->parallelFor(TilesY, 1, rasterize);
+		}
+		else
+		{
+			rasterize(0, TilesY);
+		}
+
+		m_active = true;
+		m_stats.occluderCount = static_cast<uint32_t>(m_occluders.size());
+		m_stats.occluderTriangles = triangleCount;
+	}
+
+	bool SoftwareOcclusionCuller::setupTriangle(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2, ScreenTriangle& triangle) const
+	{
+		// buffer pixels, the depth is the one of the depth buffer
+		glm::vec3 p[3];
+		const glm::vec4* clip[3] = { &v0, &v1, &v2 };
+		for (int k = 0; k < 3; k++)
+		{
+			float invW = 1.f / clip[k]->w;
+			p[k] = glm::vec3((clip[k]->x * invW * 0.5f + 0.5f) * float(OcclusionBufferWidth), (clip[k]->y * invW * 0.5f + 0.5f) * float(OcclusionBufferHeight),
+				clip[k]->z * invW);
+		}
+
+		float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+		if (std::abs(area) < MinTriangleArea)
+		{
+			return false;
+		}
+
+		triangle.minX = std::min({ p[0].x, p[1].x, p[2].x });
+		triangle.maxX = std::max({ p[0].x, p[1].x, p[2].x });
+		triangle.minY = std::min({ p[0].y, p[1].y, p[2].y });
+		triangle.maxY = std::max({ p[0].y, p[1].y, p[2].y });
+		if (triangle.maxX <= 0.f || triangle.minX >= float(OcclusionBufferWidth) || triangle.maxY <= 0.f || triangle.minY >= float(OcclusionBufferHeight))
+		{
+			return false;
+		}
+
+		// both windings are rasterized, the edges are flipped so the inside is positive
+		float sign = area > 0.f ? 1.f : -1.f;
+		for (int e = 0; e < 3; e++)
+		{
+			const glm::vec3& a = p[e];
+			const glm::vec3& b = p[(e + 1) % 3];
+			triangle.edgeA[e] = (a.y - b.y) * sign;
+			triangle.edgeB[e] = (b.x - a.x) * sign;
+			triangle.edgeC[e] = (a.x * b.y - b.x * a.y) * sign;
+		}
+
+		// the projected depth is linear in screen space
+		triangle.depthA = ((p[1].z - p[0].z) * (p[2].y - p[0].y) - (p[2].z - p[0].z) * (p[1].y - p[0].y)) / area;
+		triangle.depthB = ((p[1].x - p[0].x) * (p[2].z - p[0].z) - (p[2].x - p[0].x) * (p[1].z - p[0].z)) / area;
+		triangle.depthC = p[0].z - triangle.depthA * p[0].x - triangle.depthB * p[0].y;
+		triangle.minDepth = std::min({ p[0].z, p[1].z, p[2].z });
+		triangle.maxDepth = std::max({ p[0].z, p[1].z, p[2].z });
+		return true;
+	}
+
+	uint32_t SoftwareOcclusionCuller::addOccluder(const OccluderMesh& mesh, const glm::mat4& clipTransform, std::vector<glm::vec4>& clipPositions,
+		ScreenTriangle* output) const
+	{
+		clipPositions.resize(mesh.positions.size());
+		for (size_t v = 0; v < mesh.positions.size(); v++)
+		{
+			clipPositions[v] = clipTransform * glm::vec4(mesh.positions[v], 1.f);
+		}
+
+		// with reverse-Z the near plane is z = w, the camera side of it has z > w
+		uint32_t count = 0;
+		for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+		{
+			glm::vec4 v[3] = { clipPositions[mesh.indices[t]], clipPositions[mesh.indices[t + 1]], clipPositions[mesh.indices[t + 2]] };
+			float distance[3] = { v[0].w - v[0].z, v[1].w - v[1].z, v[2].w - v[2].z };
+			if (distance[0] >= 0.f && distance[1] >= 0.f && distance[2] >= 0.f)
+			{
+				count += setupTriangle(v[0], v[1], v[2], output[count]);
+				continue;
+			}
+			if (distance[0] < 0.f && distance[1] < 0.f && distance[2] < 0.f)
+			{
+				continue;
+			}
+
+			glm::vec4 polygon[4];
+			uint32_t polygonSize = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				int next = (k + 1) % 3;
+				if (distance[k] >= 0.f)
+				{
+					polygon[polygonSize++] = v[k];
+				}
+				if ((distance[k] >= 0.f) != (distance[next] >= 0.f))
+				{
+					polygon[polygonSize++] = v[k] + (v[next] - v[k]) * (distance[k] / (distance[k] - distance[next]));
+				}
+			}
+			for (uint32_t k = 1; k + 1 < polygonSize; k++)
+			{
+				count += setupTriangle(polygon[0], polygon[k], polygon[k + 1], output[count]);
+			}
+		}
+		return count;
+	}
+
+	void SoftwareOcclusionCuller::rasterizeTileRow(uint32_t tileRow)
+	{
+		const float top = float(tileRow * TileSize);
+		const float bottom = top + float(TileSize);
+		int32_t left[TileSize];
+		int32_t right[TileSize];
+		for (const ScreenTriangle& triangle : m_triangles)
+		{
+			if (triangle.maxY <= top || triangle.minY >= bottom)
+			{
+				continue;
+			}
+
+			computeSpans(triangle.edgeA, triangle.edgeB, triangle.edgeC, top, left, right);
+			int32_t first = OcclusionBufferWidth;
+			int32_t last = 0;
+			for (int32_t row = 0; row < TileSize; row++)
+			{
+				if (left[row] < right[row])
+				{
+					first = std::min(first, left[row]);
+					last = std::max(last, right[row]);
+				}
+			}
+
+			for (int32_t tileX = first / TileSize; tileX * TileSize < last; tileX++)
+			{
+				const int32_t x = tileX * TileSize;
+				uint64_t coverage = 0;
+				for (int32_t row = 0; row < TileSize; row++)
+				{
+					uint32_t begin = static_cast<uint32_t>(std::clamp(left[row] - x, 0, TileSize));
+					uint32_t end = static_cast<uint32_t>(std::clamp(right[row] - x, 0, TileSize));
+					if (end > begin)
+					{
+						coverage |= uint64_t(((1u << end) - 1) & ~((1u << begin) - 1)) << (row * TileSize);
+					}
+				}
+				if (coverage == 0)
+				{
+					continue;
+				}
+
+				// the covered pixel centers are inside the triangle bounds, the plane only has to hold over their overlap with the tile
+				float x0 = std::max(float(x), triangle.minX);
+				float x1 = std::min(float(x + TileSize), triangle.maxX);
+				float y0 = std::max(top, triangle.minY);
+				float y1 = std::min(bottom, triangle.maxY);
+				float d00 = triangle.depthA * x0 + triangle.depthB * y0 + triangle.depthC;
+				float d10 = triangle.depthA * x1 + triangle.depthB * y0 + triangle.depthC;
+				float d01 = triangle.depthA * x0 + triangle.depthB * y1 + triangle.depthC;
+				float d11 = triangle.depthA * x1 + triangle.depthB * y1 + triangle.depthC;
+				float farDepth = std::max(std::min({ d00, d10, d01, d11 }), triangle.minDepth);
+				float nearDepth = std::min(std::max({ d00, d10, d01, d11 }), triangle.maxDepth);
+				updateTile(tileRow * TilesX + tileX, coverage, farDepth, nearDepth);
+			}
+		}
+	}
+
+	void SoftwareOcclusionCuller::updateTile(uint32_t tile, uint64_t coverage, float farDepth, float nearDepth)
+	{
+		float& reference = m_farReference[tile];
+		float& working = m_farWorking[tile];
+		uint64_t& mask = m_masks[tile];
+
+		// already hidden
+		if (nearDepth <= reference)
+		{
+			return;
+		}
+
+		// a triangle much nearer than the working layer starts a new one, the coverage of the old one is dropped
+		if (farDepth - working > working - reference)
+		{
+			working = 1.f;
+			mask = 0;
+		}
+
+		mask |= coverage;
+		working = std::min(working, farDepth);
+		if (mask == ~0ull)
+		{
+			reference = std::max(reference, working);
+			working = 1.f;
+			mask = 0;
+		}
+	}
+
+	bool SoftwareOcclusionCuller::isBoxOccluded(const glm::vec3& center, const glm::vec3& extents) const
+	{
+		glm::vec4 clipCenter = m_viewProj * glm::vec4(center, 1.f);
+		glm::vec4 axes[3] = { m_viewProj[0] * extents.x, m_viewProj[1] * extents.y, m_viewProj[2] * extents.z };
+
+		float minX = std::numeric_limits<float>::max();
+		float minY = std::numeric_limits<float>::max();
+		float maxX = std::numeric_limits<float>::lowest();
+		float maxY = std::numeric_limits<float>::lowest();
+		float nearDepth = 0.f;
+		for (int c = 0; c < 8; c++)
+		{
+			glm::vec4 corner = clipCenter + ((c & 1) ? axes[0] : -axes[0]) + ((c & 2) ? axes[1] : -axes[1]) + ((c & 4) ? axes[2] : -axes[2]);
+
+			// the box reaches the camera side of the near plane
+			if (corner.w - corner.z <= 0.f)
+			{
+				return false;
+			}
+
+			float invW = 1.f / corner.w;
+			float x = (corner.x * invW * 0.5f + 0.5f) * float(OcclusionBufferWidth);
+			float y = (corner.y * invW * 0.5f + 0.5f) * float(OcclusionBufferHeight);
+			minX = std::min(minX, x);
+			maxX = std::max(maxX, x);
+			minY = std::min(minY, y);
+			maxY = std::max(maxY, y);
+			nearDepth = std::max(nearDepth, corner.z * invW);
+		}
+
+		// left to the frustum culling
+		if (maxX <= 0.f || maxY <= 0.f || minX >= float(OcclusionBufferWidth) || minY >= float(OcclusionBufferHeight))
+		{
+			return false;
+		}
+
+		uint32_t firstX = static_cast<uint32_t>(std::max(minX, 0.f)) / TileSize;
+		uint32_t lastX = static_cast<uint32_t>(std::min(maxX, float(OcclusionBufferWidth - 1))) / TileSize;
+		uint32_t firstY = static_cast<uint32_t>(std::max(minY, 0.f)) / TileSize;
+		uint32_t lastY = static_cast<uint32_t>(std::min(maxY, float(OcclusionBufferHeight - 1))) / TileSize;
+		for (uint32_t tileY = firstY; tileY <= lastY; tileY++)
+		{
+			const float* reference = m_farReference.data() + tileY * TilesX;
+			uint32_t tileX = firstX;
+#if defined(MOON_OCCLUSION_SSE)
+			const __m128 depth = _mm_set1_ps(nearDepth);
+			for (; tileX + 4 <= lastX + 1; tileX += 4)
+			{
+				if (_mm_movemask_ps(_mm_cmpge_ps(depth, _mm_loadu_ps(reference + tileX))) != 0)
+				{
+					return false;
+				}
+			}
+#endif
+			for (; tileX <= lastX; tileX++)
+			{
+				if (nearDepth >= reference[tileX])
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	void SoftwareOcclusionCuller::cullOccluded(const CullingBounds& bounds, std::vector<uint32_t>& indices, JobSystem* jobSystem)
+	{
+		if (!m_active || indices.empty())
+		{
+			return;
+		}
+
+		m_occluded.resize(indices.size());
+		auto test = [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t k = begin; k < end; k++)
+				{
+					uint32_t i = indices[k];
+					glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+					glm::vec3 extents(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+					m_occluded[k] = isBoxOccluded(center, extents);
+				}
+			};
+		if (jobSystem != nullptr)
+		{
+			jobSystem->parallelFor(static_cast<uint32_t>(indices.size()), OccludeeBatchSize, test);
+		}
+		else
+		{
+			test(0, static_cast<uint32_t>(indices.size()));
+		}
+
+		size_t visibleCount = 0;
+		for (size_t k = 0; k < indices.size(); k++)
+		{
+			if (!m_occluded[k])
+			{
+				indices[visibleCount++] = indices[k];
+			}
+		}
+		m_stats.occludedCount += static_cast<uint32_t>(indices.size() - visibleCount);
+		indices.resize(visibleCount);
+	}
+
+	std::shared_ptr<const OccluderMesh> buildOccluderMesh(const ImportedMesh& mesh, const ImportedSurface& surface)
+	{
+		// starts from the coarsest level of detail within the error limit, the simplification continues from there
+		const float maxError = surface.bounds.sphereRadius * OccluderMaxError;
+		std::span<const uint32_t> source = mesh.indices.subspan(surface.startIndex, surface.count);
+		float sourceError = 0.f;
+		for (uint32_t level = 0; level < surface.lodCount; level++)
+		{
+			if (surface.lods[level].error <= maxError)
+			{
+				source = mesh.indices.subspan(surface.lods[level].startIndex, surface.lods[level].count);
+				sourceError = surface.lods[level].error;
+			}
+		}
+		if (source.size() % 3 != 0 || source.size() / 3 > OccluderMaxSourceTriangles)
+		{
+			return nullptr;
+		}
+
+		float error;
+		std::vector<uint32_t> indices = simplifyMesh(source, mesh.vertices, OccluderMaxTriangles * 3, maxError - sourceError, error);
+		if (indices.empty() || indices.size() > OccluderMaxTriangles * 3)
+		{
+			return nullptr;
+		}
+
+		// The simplified triangles may pass up to the error in front of the source surface and close openings it has,
+		// hiding objects seen through them. Every vertex goes back along its normal by the whole error so the occluder
+		// only ever hides less than the surface; seams split apart, which leaves gaps and not extra coverage.
+		const float inset = sourceError + error;
+
+		// only the positions of the vertices still referenced are kept
+		std::shared_ptr<OccluderMesh> occluder = std::make_shared<OccluderMesh>();
+		std::unordered_map<uint32_t, uint32_t> remap;
+		occluder->indices.reserve(indices.size());
+		for (uint32_t index : indices)
+		{
+			auto [it, inserted] = remap.try_emplace(index, static_cast<uint32_t>(occluder->positions.size()));
+			if (inserted)
+			{
+				const Vertex& vertex = mesh.vertices[index];
+				float normalLength = glm::length(vertex.normal);
+				if (inset > 0.f && !(normalLength > 1e-6f))
+				{
+					// without a normal the vertex cannot be pulled inside
+					return nullptr;
+				}
+				occluder->positions.push_back(inset > 0.f ? vertex.position - vertex.normal * (inset / normalLength) : vertex.position);
+			}
+			occluder->indices.push_back(it->second);
+		}
+		return occluder;
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "Culling.h"
+#include "SceneImport.h"
+
+namespace Moon
+{
+	//Forward declaration
+	class JobSystem;
+
+	// resolution of the software occlusion buffer, both multiples of the 8x8 pixel tiles
+	constexpr uint32_t OcclusionBufferWidth = 320;
+	constexpr uint32_t OcclusionBufferHeight = 192;
+
+	struct OcclusionStats
+	{
+		uint32_t occluderCount;
+		uint32_t occluderTriangles; // after the near plane clipping
+		uint32_t occludedCount; // objects removed by cullOccluded since the occluders were rendered
+	};
+
+	// Masked software occlusion culling for the CPU draw path, after Hasselgren et al. 2016. The occluders are rasterized
+	// at low resolution into tiles of 8x8 pixels that keep a coverage mask and two conservative far depths instead of a
+	// depth per pixel: the reference depth covers the whole tile, the working depth only the pixels of the mask and
+	// replaces the reference once the mask is full. The rows of tiles are rasterized on the job system workers.
+	// Depths are reverse-Z like the depth buffer, the farthest depth is the smallest.
+	class SoftwareOcclusionCuller
+	{
+	public:
+		SoftwareOcclusionCuller();
+
+		// Picks the visible objects with an occluder covering enough of the screen, largest first within a triangle
+		// budget, and rasterizes them. projectionScale turns a radius / distance ratio into pixels of the window.
+		void renderOccluders(std::span<const RenderObject> surfaces, const CullingBounds& bounds, std::span<const uint32_t> visibleIndices,
+			const glm::mat4& viewProj, const glm::vec3& cameraPosition, float projectionScale, JobSystem* jobSystem = nullptr);
+
+		// Removes from indices the objects whose box is hidden behind the occluders, the order is kept
+		void cullOccluded(const CullingBounds& bounds, std::vector<uint32_t>& indices, JobSystem* jobSystem = nullptr);
+
+		// The screen rectangle of the box at its nearest depth against the reference depths of the tiles it touches
+		bool isBoxOccluded(const glm::vec3& center, const glm::vec3& extents) const;
+
+		const OcclusionStats& getStats() const { return m_stats; }
+
+	private:
+		// setup of a clipped triangle in buffer pixels, the edge functions are positive inside
+		struct ScreenTriangle
+		{
+			float edgeA[3], edgeB[3], edgeC[3];
+			float depthA, depthB, depthC; // depth = depthA * x + depthB * y + depthC
+			float minDepth, maxDepth; // of the vertices
+			float minX, minY, maxX, maxY;
+		};
+
+		void clear();
+		// false when the triangle is too small or off screen
+		bool setupTriangle(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2, ScreenTriangle& triangle) const;
+		// clips the triangles against the near plane, writes up to two triangles per input one and returns their count
+		uint32_t addOccluder(const OccluderMesh& mesh, const glm::mat4& clipTransform, std::vector<glm::vec4>& clipPositions, ScreenTriangle* output) const;
+		void rasterizeTileRow(uint32_t tileRow);
+		void updateTile(uint32_t tile, uint64_t coverage, float farDepth, float nearDepth);
+
+		glm::mat4 m_viewProj;
+		std::vector<ScreenTriangle> m_triangles;
+		std::vector<float> m_farReference; // per tile, covers every pixel
+		std::vector<float> m_farWorking; // per tile, covers the pixels of the mask
+		std::vector<uint64_t> m_masks; // a byte per row of the tile
+		std::vector<uint32_t> m_occluders; // dense indices picked this frame
+		std::vector<uint8_t> m_occluded;
+		bool m_active{ false };
+		OcclusionStats m_stats{};
+	};
+
+	// Simplified copy of a surface for the occlusion buffer, the simplification may move the surface by a small share
+	// of its radius and the vertices are pulled inward by that much, so the copy under-occludes. Null when the surface
+	// does not simplify under the occluder triangle budget or has vertices without a normal.
+	std::shared_ptr<const OccluderMesh> buildOccluderMesh(const ImportedMesh& mesh, const ImportedSurface& surface);
+}
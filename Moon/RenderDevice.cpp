@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <array>
 #include <fstream>
+#include <map>
 #include <chrono>
 
 #define VK_USE_PLATFORM_WIN32_KHR
@@ -18,6 +19,7 @@
 
 #include "RenderTypes.h"
 #include "RenderUtilities.h"
+#include "SceneCache.h"
 
 #include <VkBootstrap.h>
 
@@ -49,48 +51,24 @@ private:
 
 namespace Moon
 {
-	bool isVisible(const RenderObject& obj, const glm::mat4& viewProj)
+	static void writeObjectData(GPUObjectData& object, const RenderObject& draw)
 	{
-		std::array<glm::vec3, 8> corners
-		{
-		   glm::vec3 { 1, 1, 1 },
-		   glm::vec3 { 1, 1, -1 },
-		   glm::vec3 { 1, -1, 1 },
-		   glm::vec3 { 1, -1, -1 },
-		   glm::vec3 { -1, 1, 1 },
-		   glm::vec3 { -1, 1, -1 },
-		   glm::vec3 { -1, -1, 1 },
-		   glm::vec3 { -1, -1, -1 },
-		};
-
-		glm::mat4 matrix = viewProj * obj.transform;
-
-		glm::vec3 min = { 1.5, 1.5, 1.5 };
-		glm::vec3 max = { -1.5, -1.5, -1.5 };
-
-		for (int c = 0; c < 8; c++)
-		{
-			// project each corner into clip space
-			glm::vec4 v = matrix * glm::vec4(obj.bounds.origin + (corners[c] * obj.bounds.extents), 1.f);
-
-			// perspective correction
-			v.x = v.x / v.w;
-			v.y = v.y / v.w;
-			v.z = v.z / v.w;
-
-			min = glm::min(glm::vec3{ v.x, v.y, v.z }, min);
-			max = glm::max(glm::vec3{ v.x, v.y, v.z }, max);
-		}
+		object.worldMatrix = draw.transform;
+		object.vertexBuffer = draw.vertexBufferAddress;
+		object.materialId = draw.material->materialId;
+		object.vertexFormat = draw.vertexFormat;
+		object.boundsOrigin = glm::vec4(draw.bounds.origin, 0.f);
+		object.boundsExtents = glm::vec4(draw.bounds.extents, 0.f);
+	}
 
-		// check the clip space box is within the view
-		if (min.z > 1.f || max.z < 0.f || min.x > 1.f || max.x < -1.f || min.y > 1.f || max.y < -1.f)
-		{
-			return false;
-		}
-		else
-		{
-			return true;
-		}
+	// rotation and uniform scale keep the angles between normals, the meshlet cone cutoffs only hold under them
+	static bool keepsAngles(const glm::mat4& transform)
+	{
+		glm::vec3 x(transform[0]), y(transform[1]), z(transform[2]);
+		float scale = glm::dot(x, x);
+		float tolerance = 1e-3f * scale;
+		return std::abs(glm::dot(y, y) - scale) <= tolerance && std::abs(glm::dot(z, z) - scale) <= tolerance &&
+			std::abs(glm::dot(x, y)) <= tolerance && std::abs(glm::dot(y, z)) <= tolerance && std::abs(glm::dot(z, x)) <= tolerance;
 	}
 
 	void RenderDevice::init()
@@ -107,6 +85,8 @@ namespace Moon
 			window_flags
 		);
 
+		m_jobSystem.init();
+
 		initVulkan();
 		initSwapchain();
 		initCommands();
@@ -133,10 +113,37 @@ namespace Moon
 			vkDeviceWaitIdle(m_device);
 
 			m_loadedScenes.clear();
+			m_sceneIds.clear();
 
-			for (FrameData frameData : m_frames)
+			for (FrameData& frameData : m_frames)
 			{
 				frameData.deletionQueue.flush();
+
+				if (frameData.drawCapacity > 0)
+				{
+					destroyBuffer(frameData.objectBuffer);
+					destroyBuffer(frameData.indirectBuffer);
+				}
+				if (frameData.clusterJobCapacity > 0)
+				{
+					destroyBuffer(frameData.clusterJobBuffer);
+				}
+				if (frameData.clusterIndexCapacity > 0)
+				{
+					destroyBuffer(frameData.clusterIndexBuffer);
+				}
+				if (frameData.cullObjectCapacity > 0)
+				{
+					destroyBuffer(frameData.cullObjectBuffer);
+				}
+				if (frameData.drawCountCapacity > 0)
+				{
+					destroyBuffer(frameData.drawCountBuffer);
+				}
+			}
+			if (m_visibilityCapacity > 0)
+			{
+				destroyBuffer(m_visibilityBuffer);
 			}
 
 			m_mainDeletionQueue.flush();
@@ -154,6 +161,8 @@ namespace Moon
 			vkDestroyInstance(m_instance, nullptr);
 
 			SDL_DestroyWindow(m_window);
+
+			m_jobSystem.shutdown();
 		}
 	}
 
@@ -196,10 +205,24 @@ namespace Moon
 		}
 		VK_CHECK(vkEndCommandBuffer(cmd));
 
+		// uploads recorded since the last frame are submitted now, the GPU waits for them before drawing
+		UploadTicket uploads = m_uploads.flush();
+		m_uploads.collect();
+
 		VkCommandBufferSubmitInfo cmdinfo = commandBufferSubmitInfo(cmd);
-		VkSemaphoreSubmitInfo waitInfo = semaphoreSubmitInfo(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, frame.presentSemaphore);
+		VkSemaphoreSubmitInfo waitInfos[2];
+		waitInfos[0] = semaphoreSubmitInfo(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, frame.presentSemaphore);
+		waitInfos[1] = semaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_uploads.getSemaphore());
+		waitInfos[1].value = uploads.value;
 		VkSemaphoreSubmitInfo signalInfo = semaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, frame.renderSemaphore);
-		VkSubmitInfo2 submit = submitInfo(&cmdinfo, &signalInfo, &waitInfo);
+		VkSubmitInfo2 submit = submitInfo(&cmdinfo, &signalInfo, waitInfos);
+		if (uploads.value > m_uploadWaitValue)
+		{
+			submit.waitSemaphoreInfoCount = 2;
+			m_uploadWaitValue = uploads.value;
+		}
+
+		std::lock_guard<std::mutex> queueLock(m_queueMutex);
 		VK_CHECK(vkQueueSubmit2(m_graphicsQueue, 1, &submit, frame.renderFence));
 
 		VkPresentInfoKHR presentInfo = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
@@ -227,46 +250,260 @@ namespace Moon
 		//reset counters
 		m_stats.drawcallCount = 0;
 		m_stats.triangleCount = 0;
+		m_stats.fullTriangleCount = 0;
 
-		//sort opaque draw objects per pipeline, access only by index and frustum culled
-		std::vector<uint32_t> opaqueDraws;
-		opaqueDraws.reserve(m_mainDrawContext.OpaqueSurfaces.size());
-		for (uint32_t i = 0; i < m_mainDrawContext.OpaqueSurfaces.size(); i++)
+		// the fence of this frame has been waited on, the cluster culling it recorded last time is complete
+		FrameData& frame = getCurrentFrame();
+		vmaInvalidateAllocation(m_allocator, frame.clusterStatsBuffer.allocation, 0, VK_WHOLE_SIZE);
+		const GPUClusterStats& clusterStats = *(const GPUClusterStats*)frame.clusterStatsBuffer.info.pMappedData;
+		m_stats.visibleMeshletCount = static_cast<int>(clusterStats.visibleMeshlets);
+		m_stats.renderedTriangleCount = static_cast<int>(frame.recordedTriangles - frame.clusterTriangles + clusterStats.visibleTriangles);
+
+		m_stats.gpuVisibleCount = 0;
+		m_stats.occludedCount = 0;
+		if (frame.drawCountCount > 0)
 		{
-			if (isVisible(m_mainDrawContext.OpaqueSurfaces[i], m_sceneData.viewproj))
+			vmaInvalidateAllocation(m_allocator, frame.drawCountBuffer.allocation, 0, VK_WHOLE_SIZE);
+			const GPUDrawCullStats& drawStats = *(const GPUDrawCullStats*)frame.drawCountBuffer.info.pMappedData;
+			const uint32_t* drawCounts = (const uint32_t*)(&drawStats + 1);
+			m_stats.renderedTriangleCount += static_cast<int>(drawStats.visibleTriangles);
+			m_stats.occludedCount = static_cast<int>(drawStats.occludedObjects);
+			for (uint32_t c = 0; c < frame.drawCountCount; c++)
 			{
-				opaqueDraws.push_back(i);
+				m_stats.gpuVisibleCount += static_cast<int>(drawCounts[c]);
 			}
 		}
-		std::sort(opaqueDraws.begin(), opaqueDraws.end(), [&](const auto& iA, const auto& iB) {
-			const RenderObject& A = m_mainDrawContext.OpaqueSurfaces[iA];
-			const RenderObject& B = m_mainDrawContext.OpaqueSurfaces[iB];
-			if (A.material == B.material)
+
+		const DrawContext& drawContext = m_renderRegistry.getDrawContext();
+
+		Frustum frustum = extractFrustum(m_sceneData.viewproj);
+
+		// a negative budget keeps every object at its full detail
+		LodSelection lodSelection;
+		lodSelection.cameraPosition = m_mainCamera.position;
+		lodSelection.projectionScale = 0.5f * static_cast<float>(m_windowExtent.height) * std::abs(m_sceneData.proj[1][1]);
+		lodSelection.maxPixelError = m_useLods ? m_lodPixelError : -1.f;
+
+		//cull the objects, then sort the opaque ones per pipeline/material/mesh and front to back
+		//with GPU culling the opaque objects are all handed to drawCull.comp instead
+		const bool gpuCulling = m_useGpuCulling;
+		cullObjects(frustum, lodSelection, gpuCulling);
+		const std::vector<uint32_t>& opaqueDraws = m_opaqueDraws;
+		const std::vector<uint32_t>& transparentDraws = m_transparentDraws;
+
+		m_renderRegistry.selectLods(false, opaqueDraws, lodSelection);
+		m_renderRegistry.selectLods(true, transparentDraws, lodSelection);
+
+		m_opaqueQueue.build(drawContext.OpaqueSurfaces, m_renderRegistry.getOpaqueBounds(), opaqueDraws, m_sceneData.view, RenderQueue::SortMode::StateFrontToBack);
+		m_transparentQueue.build(drawContext.TransparentSurfaces, m_renderRegistry.getTransparentBounds(), transparentDraws, m_sceneData.view, RenderQueue::SortMode::BackToFront);
+
+		// the scene data of this frame goes to its own slice of the persistent ring, selected with a dynamic offset
+		uint32_t sceneDataOffset = static_cast<uint32_t>((m_frameNumber % FRAME_OVERLAP) * m_sceneDataStride);
+		GPUSceneData* sceneUniformData = (GPUSceneData*)((uint8_t*)m_sceneDataBuffer.info.pMappedData + sceneDataOffset);
+		*sceneUniformData = m_sceneData;
+
+		// opaque draws whose level of detail has meshlets go through the cluster culling, their indices come from the frame
+		// cluster index buffer. clusterCull.comp appends the visible meshlets in any order, which would reorder the
+		// triangles of a blended draw from frame to frame, so transparent draws keep their own index buffer.
+		auto usesClusters = [&](const RenderObject& draw)
 			{
-				return A.indexBuffer < B.indexBuffer;
-			}
-			else
+				return m_useClusterCulling && draw.material->passType != MaterialPass::Transparent && draw.lods[draw.lod].meshletCount > 0;
+			};
+
+		uint32_t jobCount = 0;
+		uint32_t clusterIndexCount = 0;
+		auto countClusters = [&](const RenderObject& draw)
 			{
-				return A.material < B.material;
-			}
-		});
+				if (usesClusters(draw))
+				{
+					jobCount += draw.lods[draw.lod].meshletCount;
+					clusterIndexCount += draw.lods[draw.lod].count;
+				}
+			};
+		for (uint32_t r : m_opaqueQueue.getSortedIndices())
+		{
+			countClusters(drawContext.OpaqueSurfaces[r]);
+		}
 
-		//frustum cull transparent objects
-		std::vector<uint32_t> transparentDraws;
-		transparentDraws.reserve(m_mainDrawContext.TransparentSurfaces.size());
-		for (uint32_t i = 0; i < m_mainDrawContext.TransparentSurfaces.size(); i++)
+		// the GPU culled objects take the first object data slots, at their dense index, and the first commands, once per
+		// phase; the sorted draws follow
+		const bool occlusionCulling = gpuCulling && m_useOcclusionCulling;
+		const uint32_t phaseCount = occlusionCulling ? 2 : 1;
+		uint32_t gpuObjectCount = 0;
+		if (gpuCulling)
+		{
+			updateDrawBatches();
+			gpuObjectCount = static_cast<uint32_t>(drawContext.OpaqueSurfaces.size());
+		}
+		const uint32_t gpuCommandCount = gpuObjectCount * phaseCount;
+
+		reserveFrameDraws(frame, gpuCommandCount + static_cast<uint32_t>(m_opaqueQueue.getSortedIndices().size() + m_transparentQueue.getSortedIndices().size()));
+		reserveClusterBuffers(frame, jobCount, clusterIndexCount);
+		frame.drawCountCount = gpuCulling ? static_cast<uint32_t>(m_drawBatches.size()) * phaseCount : 0;
+		if (gpuCulling)
+		{
+			reserveDrawCullBuffers(frame, gpuObjectCount, frame.drawCountCount);
+			writeCullObjects(frame);
+		}
+		else
 		{
-			if (isVisible(m_mainDrawContext.TransparentSurfaces[i], m_sceneData.viewproj))
+			// the sorted draws overwrite the copies
+			frame.cullObjectVersion = ~0ull;
+		}
+		GPUObjectData* objectData = (GPUObjectData*)frame.objectBuffer.info.pMappedData;
+		VkDrawIndexedIndirectCommand* indirectCommands = (VkDrawIndexedIndirectCommand*)frame.indirectBuffer.info.pMappedData;
+		GPUClusterJob* clusterJobs = frame.clusterJobCapacity > 0 ? (GPUClusterJob*)frame.clusterJobBuffer.info.pMappedData : nullptr;
+
+		// object data and indirect commands, in draw order
+		uint32_t drawIndex = gpuCommandCount;
+		uint32_t jobIndex = 0;
+		uint32_t clusterIndex = 0;
+		frame.clusterTriangles = 0;
+		auto writeDraw = [&](const RenderObject& draw)
 			{
-				transparentDraws.push_back(i);
-			}
+				writeObjectData(objectData[drawIndex], draw);
+
+				// the draw index goes through firstInstance so the shader can fetch its object data
+				VkDrawIndexedIndirectCommand& command = indirectCommands[drawIndex];
+				command.indexCount = draw.indexCount;
+				command.instanceCount = 1;
+				command.firstIndex = draw.firstIndex;
+				command.vertexOffset = 0;
+				command.firstInstance = drawIndex;
+
+				if (usesClusters(draw))
+				{
+					// clusterCull.comp appends the indices of the visible meshlets and counts them
+					const MeshLod& lod = draw.lods[draw.lod];
+					command.indexCount = 0;
+					command.firstIndex = clusterIndex;
+					clusterIndex += lod.count;
+
+					uint32_t flags = draw.indexType == VK_INDEX_TYPE_UINT16 ? ClusterJobShortIndices : 0;
+					if (!draw.material->doubleSided && keepsAngles(draw.transform))
+					{
+						flags |= ClusterJobCullBackfaces;
+					}
+					for (uint32_t m = 0; m < lod.meshletCount; m++)
+					{
+						VkDeviceAddress meshlet = draw.meshletBufferAddress + (lod.firstMeshlet + m) * sizeof(Meshlet);
+						clusterJobs[jobIndex++] = GPUClusterJob{ meshlet, draw.indexBufferAddress, drawIndex, flags };
+					}
+					frame.clusterTriangles += lod.count / 3;
+				}
+
+				drawIndex++;
+				m_stats.triangleCount += draw.indexCount / 3;
+				m_stats.fullTriangleCount += draw.lods[0].count / 3;
+			};
+
+		for (uint32_t r : m_opaqueQueue.getSortedIndices())
+		{
+			writeDraw(drawContext.OpaqueSurfaces[r]);
+		}
+		for (uint32_t r : m_transparentQueue.getSortedIndices())
+		{
+			writeDraw(drawContext.TransparentSurfaces[r]);
+		}
+		frame.recordedTriangles = m_stats.triangleCount;
+		m_stats.meshletCount = static_cast<int>(jobCount);
+
+		// the visible counts start from zero even when nothing is culled, the stats of this frame are read back later
+		vkCmdFillBuffer(cmd, frame.clusterStatsBuffer.buffer, 0, sizeof(GPUClusterStats), 0);
+		if (gpuCulling)
+		{
+			vkCmdFillBuffer(cmd, frame.drawCountBuffer.buffer, 0, sizeof(GPUDrawCullStats) + frame.drawCountCount * sizeof(uint32_t), 0);
+		}
+		if (occlusionCulling)
+		{
+			resetVisibility(cmd, gpuObjectCount);
+		}
+		if (jobCount > 0 || gpuObjectCount > 0)
+		{
+			// also orders the visibility written by the late phase of the previous frame
+			VkMemoryBarrier2 clearBarrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+			clearBarrier.srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+			clearBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+			clearBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+			clearBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+			VkDependencyInfo clearDependency{ VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+			clearDependency.memoryBarrierCount = 1;
+			clearDependency.pMemoryBarriers = &clearBarrier;
+			vkCmdPipelineBarrier2(cmd, &clearDependency);
 		}
 
+		// the culling passes write their own range of the indirect commands
+		VkDescriptorSet pyramidSet = VK_NULL_HANDLE;
+		if (gpuObjectCount > 0)
+		{
+			// only the late phase reads the pyramid, the other phases bind it all the same
+			transitionImage(cmd, m_depthPyramid.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+			pyramidSet = frame.frameDescriptors.allocate(m_device, m_depthPyramidSetLayout);
+			DescriptorWriter writer;
+			writer.writeImage(0, m_depthPyramid.imageView, m_defaultSamplerNearest, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+			writer.updateSet(m_device, pyramidSet);
+
+			cullDraws(cmd, frame, occlusionCulling ? DrawCullPhase::Early : DrawCullPhase::All, gpuObjectCount, lodSelection, sceneDataOffset, pyramidSet);
+		}
+
+		if (jobCount > 0)
+		{
+			GPUClusterCullConstants constants;
+			constants.jobs = getBufferAddress(frame.clusterJobBuffer.buffer);
+			constants.commands = getBufferAddress(frame.indirectBuffer.buffer);
+			constants.indices = getBufferAddress(frame.clusterIndexBuffer.buffer);
+			constants.stats = getBufferAddress(frame.clusterStatsBuffer.buffer);
+			constants.jobCount = jobCount;
+
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_clusterCullPipeline);
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_clusterCullLayout, 0, 1, &frame.sceneDescriptor, 1, &sceneDataOffset);
+			vkCmdPushConstants(cmd, m_clusterCullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+			vkCmdDispatch(cmd, (jobCount + CLUSTER_CULL_GROUP_SIZE - 1) / CLUSTER_CULL_GROUP_SIZE, 1, 1);
+		}
+
+		VkMemoryBarrier2 cullBarrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+		cullBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT;
+		cullBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		cullBarrier.dstStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_HOST_BIT;
+		cullBarrier.dstAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_HOST_READ_BIT;
+		VkDependencyInfo cullDependency{ VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+		cullDependency.memoryBarrierCount = 1;
+		cullDependency.pMemoryBarriers = &cullBarrier;
+		vkCmdPipelineBarrier2(cmd, &cullDependency);
+
 		VkClearValue clearValue{ .color = VkClearColorValue {0.1f, 0.1f, 0.1f, 1.0f} };
 		VkRenderingAttachmentInfo colorAttachment = Moon::attachmentInfo(m_drawImage.imageView, &clearValue, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);//VK_IMAGE_LAYOUT_GENERAL?
 		VkRenderingAttachmentInfo depthAttachment = Moon::depthAttachmentInfo(m_depthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
 		VkRenderingInfo renderingInfo = Moon::renderingInfo(m_windowExtent, &colorAttachment, &depthAttachment);
 
+		MaterialPipeline* lastPipeline = nullptr;
+		VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
+
+		// one draw per batch, its count is written by drawCull.comp
+		auto drawBatches = [&](DrawCullPhase phase)
+			{
+				uint32_t phaseIndex = phase == DrawCullPhase::Late ? 1 : 0;
+				VkDeviceSize commandOffset = VkDeviceSize(phaseIndex) * gpuObjectCount * sizeof(VkDrawIndexedIndirectCommand);
+				VkDeviceSize countOffset = sizeof(GPUDrawCullStats) + VkDeviceSize(phaseIndex) * m_drawBatches.size() * sizeof(uint32_t);
+				for (const DrawBatch& batch : m_drawBatches)
+				{
+					if (lastPipeline != batch.pipeline)
+					{
+						lastPipeline = batch.pipeline;
+						vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.pipeline->pipeline);
+					}
+					if (lastIndexBuffer != batch.indexBuffer)
+					{
+						lastIndexBuffer = batch.indexBuffer;
+						vkCmdBindIndexBuffer(cmd, batch.indexBuffer, 0, batch.indexType);
+					}
+					vkCmdDrawIndexedIndirectCount(cmd, frame.indirectBuffer.buffer, commandOffset + batch.firstCommand * sizeof(VkDrawIndexedIndirectCommand),
+						frame.drawCountBuffer.buffer, countOffset, batch.capacity, sizeof(VkDrawIndexedIndirectCommand));
+					countOffset += sizeof(uint32_t);
+					m_stats.drawcallCount++;
+				}
+			};
+
 		vkCmdBeginRendering(cmd, &renderingInfo);
 		{
 			VkViewport viewport = {};
@@ -283,67 +520,92 @@ namespace Moon
 			scissor.extent = m_windowExtent;
 			vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-			AllocatedBuffer gpuSceneDataBuffer = createBuffer(sizeof(GPUSceneData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-			getCurrentFrame().deletionQueue.pushFunction([=, this]()
-				{
-					destroyBuffer(gpuSceneDataBuffer);
-				});
+			// both pipelines share the same layout, the scene and bindless sets are bound once for the whole pass
+			VkDescriptorSet sets[] = { frame.sceneDescriptor, m_bindless.getSet() };
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_metalRoughMaterial.opaquePipeline.layout, 0, 2, sets, 1, &sceneDataOffset);
+
+			if (gpuObjectCount > 0)
+			{
+				drawBatches(occlusionCulling ? DrawCullPhase::Early : DrawCullPhase::All);
+			}
 
+			// the pyramid is built from the depth of the early phase, the late phase draws over it
+			if (gpuObjectCount > 0 && occlusionCulling)
+			{
+				vkCmdEndRendering(cmd);
 
-			GPUSceneData* sceneUniformData = (GPUSceneData*)gpuSceneDataBuffer.allocation->GetMappedData();
-			*sceneUniformData = m_sceneData;
+				buildDepthPyramid(cmd, frame);
+				cullDraws(cmd, frame, DrawCullPhase::Late, gpuObjectCount, lodSelection, sceneDataOffset, pyramidSet);
+				vkCmdPipelineBarrier2(cmd, &cullDependency);
 
-			VkDescriptorSet globalDescriptor = getCurrentFrame().frameDescriptors.allocate(m_device, m_gpuSceneDataDescriptorLayout);
-			DescriptorWriter writer;
-			writer.writeBuffer(0, gpuSceneDataBuffer.buffer, sizeof(GPUSceneData), 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-			writer.updateSet(m_device, globalDescriptor);
+				colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				vkCmdBeginRendering(cmd, &renderingInfo);
+				drawBatches(DrawCullPhase::Late);
+			}
 
-			MaterialPipeline* lastPipeline = nullptr;
-			MaterialInstance* lastMaterial = nullptr;
-			VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
+			// consecutive draws sharing pipeline and index buffer are submitted as one indirect batch, whatever their material
+			drawIndex = gpuCommandCount;
+			uint32_t batchStart = gpuCommandCount;
+			auto flushBatch = [&]()
+				{
+					if (m_useIndirectDraw && drawIndex > batchStart)
+					{
+						vkCmdDrawIndexedIndirect(cmd, frame.indirectBuffer.buffer, batchStart * sizeof(VkDrawIndexedIndirectCommand),
+							drawIndex - batchStart, sizeof(VkDrawIndexedIndirectCommand));
+						m_stats.drawcallCount++;
+					}
+					batchStart = drawIndex;
+				};
 
 			auto draw = [&](const RenderObject& draw)
 				{
-					if (lastMaterial != draw.material)
+					bool clustered = usesClusters(draw);
+					VkBuffer indexBuffer = clustered ? frame.clusterIndexBuffer.buffer : draw.indexBuffer;
+					if (lastPipeline != draw.material->pipeline || lastIndexBuffer != indexBuffer)
 					{
-						lastMaterial = draw.material;
-
-						if (lastPipeline != draw.material->pipeline)
-						{
-							lastPipeline = draw.material->pipeline;
-							vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.material->pipeline->pipeline);
-							vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.material->pipeline->layout, 0, 1, &globalDescriptor, 0, nullptr);
-						}
-
-						vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.material->pipeline->layout, 1, 1, &draw.material->materialSet, 0, nullptr);
+						flushBatch();
 					}
 
-					if (lastIndexBuffer != draw.indexBuffer)
+					if (lastPipeline != draw.material->pipeline)
 					{
-						lastIndexBuffer = draw.indexBuffer;
-						vkCmdBindIndexBuffer(cmd, draw.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+						lastPipeline = draw.material->pipeline;
+						vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.material->pipeline->pipeline);
 					}
 
-					GPUDrawPushConstants pushConstants;
-					pushConstants.vertexBuffer = draw.vertexBufferAddress;
-					pushConstants.worldMatrix = draw.transform;
-					vkCmdPushConstants(cmd, draw.material->pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUDrawPushConstants), &pushConstants);
+					if (lastIndexBuffer != indexBuffer)
+					{
+						lastIndexBuffer = indexBuffer;
+						vkCmdBindIndexBuffer(cmd, indexBuffer, 0, clustered ? VK_INDEX_TYPE_UINT32 : draw.indexType);
+					}
 
-					vkCmdDrawIndexed(cmd, draw.indexCount, 1, draw.firstIndex, 0, 0);
+					if (!m_useIndirectDraw)
+					{
+						// only the GPU knows how many indices survived the cluster culling
+						if (clustered)
+						{
+							vkCmdDrawIndexedIndirect(cmd, frame.indirectBuffer.buffer, drawIndex * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+						}
+						else
+						{
+							vkCmdDrawIndexed(cmd, draw.indexCount, 1, draw.firstIndex, 0, drawIndex);
+						}
+						m_stats.drawcallCount++;
+					}
 
-					m_stats.drawcallCount++;
-					m_stats.triangleCount += draw.indexCount / 3;
+					drawIndex++;
 				};
 
-			for (auto& r : opaqueDraws)
+			for (uint32_t r : m_opaqueQueue.getSortedIndices())
 			{
-				draw(m_mainDrawContext.OpaqueSurfaces[r]);
+				draw(drawContext.OpaqueSurfaces[r]);
 			}
 
-			for (auto& r : transparentDraws)
+			for (uint32_t r : m_transparentQueue.getSortedIndices())
 			{
-				draw(m_mainDrawContext.TransparentSurfaces[r]);
+				draw(drawContext.TransparentSurfaces[r]);
 			}
+			flushBatch();
 		}
 		vkCmdEndRendering(cmd);
 	}
@@ -376,6 +638,11 @@ namespace Moon
 
 				m_mainCamera.processSDLEvent(e);
 
+				if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_RIGHT && !ImGui::GetIO().WantCaptureMouse)
+				{
+					pickObject(e.button.x, e.button.y);
+				}
+
 				//send SDL event to imgui for handling
 				ImGui_ImplSDL2_ProcessEvent(&e);
 			}
@@ -397,8 +664,45 @@ namespace Moon
 					ImGui::Text("Draw time: %.3f ms", m_stats.meshDrawTime);
 					ImGui::Text("Update time: %.3f ms", m_stats.sceneUpdateTime);
 					ImGui::Text("Asset load time: %.3f s", m_stats.assetLoadTime/1000.f);
-					ImGui::Text("Triangles: %i", m_stats.triangleCount);
+					ImGui::Text("  parse %.1f ms, textures %.1f ms, meshes %.1f ms, scene %.1f ms",
+						m_stats.assetParseTime, m_stats.textureLoadTime, m_stats.meshLoadTime, m_stats.sceneBuildTime);
+					ImGui::Text("  peak memory %.1f MB", m_stats.peakLoadMemory / (1024.f * 1024.f));
+					ImGui::Text("Samplers: %zu, images: %zu, mesh buffers: %zu", m_samplerCache.getSamplerCount(),
+						m_assetRegistry.getImageCount(), m_assetRegistry.getMeshCount());
+					ImGui::Text("Mesh memory: vertices %.1f MB, indices %.1f MB (%.1f MB uncompressed)", m_stats.vertexMemory / (1024.f * 1024.f),
+						m_stats.indexMemory / (1024.f * 1024.f), m_stats.fullVertexMemory / (1024.f * 1024.f));
+					ImGui::Text("Triangles: %i (%i at full detail), %i rendered", m_stats.triangleCount, m_stats.fullTriangleCount, m_stats.renderedTriangleCount);
+					ImGui::Text("Meshlets: %i visible of %i", m_stats.visibleMeshletCount, m_stats.meshletCount);
+					if (m_useGpuCulling)
+					{
+						ImGui::Text("GPU culling: %i of %i opaque objects visible", m_stats.gpuVisibleCount,
+							static_cast<int>(m_renderRegistry.getDrawContext().OpaqueSurfaces.size()));
+						if (m_useOcclusionCulling)
+						{
+							ImGui::Text("  %i occluded", m_stats.occludedCount);
+						}
+					}
+					else if (m_useSoftwareOcclusion)
+					{
+						ImGui::Text("Software occlusion: %i occluders (%u triangles), %i objects hidden", m_stats.occluderCount,
+							m_occlusionCuller.getStats().occluderTriangles, m_stats.softwareOccludedCount);
+					}
+					ImGui::Text("Culling: %.3f ms, %i objects tested", m_stats.cullingTime, m_stats.cullTestedCount);
 					ImGui::Text("Draws: %i", m_stats.drawcallCount);
+					if (m_pickValid && m_renderRegistry.isAlive(m_pickHit.object))
+					{
+						ImGui::Text("Picked object %u at %.3f %.3f %.3f, triangle %i", m_pickHit.object.index, m_pickHit.position.x,
+							m_pickHit.position.y, m_pickHit.position.z, m_pickHit.triangle == ~0u ? -1 : static_cast<int>(m_pickHit.triangle));
+					}
+					ImGui::Checkbox("Indirect draws", &m_useIndirectDraw);
+					ImGui::Checkbox("LODs", &m_useLods);
+					ImGui::Checkbox("Cluster culling", &m_useClusterCulling);
+					ImGui::Checkbox("GPU culling", &m_useGpuCulling);
+					ImGui::Checkbox("Occlusion culling", &m_useOcclusionCulling);
+					ImGui::Checkbox("Software occlusion", &m_useSoftwareOcclusion);
+					ImGui::Checkbox("Temporal culling", &m_useTemporalCulling);
+					ImGui::Checkbox("BVH culling", &m_useBvhCulling);
+					ImGui::SliderFloat("LOD pixel error", &m_lodPixelError, 0.25f, 8.f);
 					ImGui::End();
 				}
 
@@ -437,7 +741,10 @@ namespace Moon
 
 		VkCommandBufferSubmitInfo cmdinfo = Moon::commandBufferSubmitInfo(cmd);
 		VkSubmitInfo2 submit = Moon::submitInfo(&cmdinfo, nullptr, nullptr);
-		VK_CHECK(vkQueueSubmit2(m_graphicsQueue, 1, &submit, m_immFence));
+		{
+			std::lock_guard<std::mutex> queueLock(m_queueMutex);
+			VK_CHECK(vkQueueSubmit2(m_graphicsQueue, 1, &submit, m_immFence));
+		}
 		VK_CHECK(vkWaitForFences(m_device, 1, &m_immFence, true, 9999999999));
 	}
 
@@ -447,6 +754,15 @@ namespace Moon
 		bufferInfo.size = allocSize;
 		bufferInfo.usage = usage;
 
+		// device buffers filled by the transfer queue are shared with the graphics queue instead of transferring ownership
+		uint32_t queueFamilies[] = { m_graphicsQueueFamily, m_transferQueueFamily };
+		if (m_transferQueueFamily != m_graphicsQueueFamily && memoryUsage == VMA_MEMORY_USAGE_GPU_ONLY && (usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT))
+		{
+			bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferInfo.queueFamilyIndexCount = 2;
+			bufferInfo.pQueueFamilyIndices = queueFamilies;
+		}
+
 		VmaAllocationCreateInfo vmaallocInfo = {};
 		vmaallocInfo.usage = memoryUsage;
 		vmaallocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
@@ -456,12 +772,27 @@ namespace Moon
 		return newBuffer;
 	}
 
-	AllocatedImage RenderDevice::createImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage)
+	AllocatedImage RenderDevice::createImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, uint32_t mipLevels, uint32_t arrayLayers, bool cubemap)
 	{
 		AllocatedImage newImage;
 		newImage.imageFormat = format;
 		newImage.imageExtent = size;
-		VkImageCreateInfo img_info = imageCreateInfo(format, usage, size);
+		newImage.mipLevels = mipLevels;
+		VkImageCreateInfo img_info = imageCreateInfo(format, usage, size, mipLevels);
+		img_info.arrayLayers = arrayLayers;
+		if (cubemap)
+		{
+			img_info.flags |= VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+		}
+
+		// sampled images filled by the transfer queue
+		uint32_t queueFamilies[] = { m_graphicsQueueFamily, m_transferQueueFamily };
+		if (m_transferQueueFamily != m_graphicsQueueFamily && (usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) && (usage & VK_IMAGE_USAGE_SAMPLED_BIT))
+		{
+			img_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			img_info.queueFamilyIndexCount = 2;
+			img_info.pQueueFamilyIndices = queueFamilies;
+		}
 
 		VmaAllocationCreateInfo allocinfo = {};
 		allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
@@ -474,55 +805,84 @@ namespace Moon
 			aspectFlag = VK_IMAGE_ASPECT_DEPTH_BIT;
 		}
 
-		VkImageViewCreateInfo view_info = imageviewCreateInfo(format, newImage.image, aspectFlag);
+		VkImageViewCreateInfo view_info = imageviewCreateInfo(format, newImage.image, aspectFlag, mipLevels);
+		view_info.subresourceRange.layerCount = arrayLayers;
+		if (cubemap)
+		{
+			view_info.viewType = arrayLayers > 6 ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE;
+		}
+		else if (arrayLayers > 1)
+		{
+			view_info.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		}
 		VK_CHECK(vkCreateImageView(m_device, &view_info, nullptr, &newImage.imageView));
 		return newImage;
 	}
 
-	AllocatedImage RenderDevice::createImage(void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage)
+	AllocatedImage RenderDevice::createImage(const void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage, uint32_t mipLevels)
 	{
-		size_t data_size = size.depth * size.width * size.height * 4;
-		AllocatedBuffer uploadBuffer = createBuffer(data_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-		memcpy(uploadBuffer.info.pMappedData, data, data_size);
+		AllocatedImage new_image = createImage(size, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT, mipLevels);
 
-		AllocatedImage new_image = createImage(size, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
-		immediateSubmit([&](VkCommandBuffer cmd)
+		std::vector<VkBufferImageCopy> copyRegions(mipLevels);
+		size_t data_size = 0;
+		for (uint32_t level = 0; level < mipLevels; level++)
 		{
-			transitionImage(cmd, new_image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+			VkExtent3D mipExtent = getMipExtent(size, level);
+			mipExtent.depth = size.depth;
 
-			VkBufferImageCopy copyRegion = {};
-			copyRegion.bufferOffset = 0;
+			VkBufferImageCopy& copyRegion = copyRegions[level];
+			copyRegion.bufferOffset = data_size;
 			copyRegion.bufferRowLength = 0;
 			copyRegion.bufferImageHeight = 0;
 			copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			copyRegion.imageSubresource.mipLevel = 0;
+			copyRegion.imageSubresource.mipLevel = level;
 			copyRegion.imageSubresource.baseArrayLayer = 0;
 			copyRegion.imageSubresource.layerCount = 1;
-			copyRegion.imageExtent = size;
+			copyRegion.imageExtent = mipExtent;
+			data_size += getImageSize(mipExtent, format) * mipExtent.depth;
+		}
 
-			vkCmdCopyBufferToImage(cmd, uploadBuffer.buffer, new_image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-				&copyRegion);
+		// recorded on the transfer queue, the frame that first samples the image waits for it on the GPU
+		m_uploads.uploadImage(new_image.image, mipLevels, copyRegions, data, data_size);
 
-			transitionImage(cmd, new_image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-		});
+		return new_image;
+	}
+
+	AllocatedImage RenderDevice::createImage(const Ktx2Texture& texture, VkImageUsageFlags usage)
+	{
+		AllocatedImage new_image = createImage(texture.extent, texture.format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			texture.mipLevels, texture.arrayLayers, texture.cubemap);
 
-		destroyBuffer(uploadBuffer);
+		m_uploads.uploadImage(new_image.image, texture.mipLevels, texture.regions, texture.data.data(), texture.data.size());
 
 		return new_image;
 	}
 
+	uint32_t RenderDevice::addScene(const std::string& name, std::shared_ptr<LoadedGLTF> scene)
+	{
+		auto [it, inserted] = m_sceneIds.try_emplace(name, static_cast<uint32_t>(m_loadedScenes.size()));
+		if (inserted)
+		{
+			m_loadedScenes.push_back(std::move(scene));
+		}
+		else
+		{
+			m_loadedScenes[it->second] = std::move(scene);
+		}
+		return it->second;
+	}
+
 	void RenderDevice::updateScene()
 	{
 		CPU_TIMER(&m_stats.sceneUpdateTime);
 		
 		m_mainCamera.update();
 
-		m_mainDrawContext.OpaqueSurfaces.clear();
-		m_mainDrawContext.TransparentSurfaces.clear();
-		m_loadedScenes["structure"]->Draw(glm::mat4{ 1.f }, m_mainDrawContext);
-		//m_loadedScenes["Sponza"]->Draw(glm::mat4{ 1.f }, m_mainDrawContext);
-		//m_loadedScenes["SponzaCurtains"]->Draw(glm::mat4{ 1.f }, m_mainDrawContext);
+		// render objects are retained in the registry, only push the transforms that changed
+		for (const std::shared_ptr<LoadedGLTF>& scene : m_loadedScenes)
+		{
+			scene->syncRenderObjects(m_renderRegistry);
+		}
 
 		glm::mat4 view = m_mainCamera.getViewMatrix();
 		glm::mat4 projection = glm::perspective(glm::radians(70.f), (float)m_windowExtent.width / (float)m_windowExtent.height, 10000.f, 0.1f);
@@ -563,6 +923,18 @@ namespace Moon
 		VkPhysicalDeviceVulkan12Features features12{};
 		features12.bufferDeviceAddress = true;
 		features12.descriptorIndexing = true;
+		features12.runtimeDescriptorArray = true;
+		features12.descriptorBindingPartiallyBound = true;
+		features12.descriptorBindingSampledImageUpdateAfterBind = true;
+		features12.shaderSampledImageArrayNonUniformIndexing = true;
+		features12.timelineSemaphore = true;
+		features12.drawIndirectCount = true;
+		features12.separateDepthStencilLayouts = true;
+
+		VkPhysicalDeviceFeatures features{};
+		features.multiDrawIndirect = true;
+		features.drawIndirectFirstInstance = true;
+		features.samplerAnisotropy = true;
 
 		vkb::PhysicalDeviceSelector selector{ vkb_inst };
 		vkb::PhysicalDevice physicalDevice = selector
@@ -573,10 +945,17 @@ namespace Moon
 			.set_minimum_version(1, 3)
 			.set_required_features_13(features13)
 			.set_required_features_12(features12)
+			.set_required_features(features)
 			.set_surface(m_surface)
 			.select()
 			.value();
 
+		// BC textures are optional, the imports keep RGBA8 on a device without them
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(physicalDevice.physical_device, &supportedFeatures);
+		physicalDevice.features.textureCompressionBC = supportedFeatures.textureCompressionBC;
+		m_importSettings.blockCompressedTextures = supportedFeatures.textureCompressionBC == VK_TRUE;
+
 		VkPhysicalDeviceShaderDrawParametersFeatures shaderDrawParametersFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES };
 		shaderDrawParametersFeatures.shaderDrawParameters = VK_TRUE;
 
@@ -591,6 +970,19 @@ namespace Moon
 		m_graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
 		m_graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+		// uploads go to a dedicated transfer queue when the device has one, otherwise they share the graphics queue
+		auto transferQueue = vkbDevice.get_dedicated_queue(vkb::QueueType::transfer);
+		if (transferQueue)
+		{
+			m_transferQueue = transferQueue.value();
+			m_transferQueueFamily = vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+		}
+		else
+		{
+			m_transferQueue = m_graphicsQueue;
+			m_transferQueueFamily = m_graphicsQueueFamily;
+		}
+
 		volkLoadDevice(m_device);
 
 		VmaAllocatorCreateInfo allocatorInfo = {};
@@ -643,7 +1035,7 @@ namespace Moon
 
 		// Depth 
 		m_depthImage.imageFormat = VK_FORMAT_D32_SFLOAT;
-		VkImageCreateInfo dimg_info = imageCreateInfo(m_depthImage.imageFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, drawImageExtent);
+		VkImageCreateInfo dimg_info = imageCreateInfo(m_depthImage.imageFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, drawImageExtent);
 
 		VmaAllocationCreateInfo dimg_allocinfo = {};
 		dimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
@@ -679,6 +1071,13 @@ namespace Moon
 				});
 		}
 
+		// Upload manager, the graphics queue lock is only needed when both share the same queue
+		m_uploads.init(this, m_transferQueue, m_transferQueueFamily, m_transferQueue == m_graphicsQueue ? &m_queueMutex : nullptr);
+		m_mainDeletionQueue.pushFunction([=, this]()
+			{
+				m_uploads.cleanup();
+			});
+
 		// Immediate submit related
 		VK_CHECK(vkCreateCommandPool(m_device, &commandPoolInfo, nullptr, &m_immCommandPool));
 		VkCommandBufferAllocateInfo cmdAllocInfo = Moon::commandBufferAllocateInfo(m_immCommandPool, 1);
@@ -732,7 +1131,8 @@ namespace Moon
 
 		{
 			DescriptorLayoutBuilder builder;
-			builder.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+			builder.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+			builder.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
 			m_gpuSceneDataDescriptorLayout = builder.build(m_device);
 			m_mainDeletionQueue.pushFunction([=]()
 				{
@@ -740,6 +1140,32 @@ namespace Moon
 				});
 		}
 
+		m_bindless.init(this);
+		m_mainDeletionQueue.pushFunction([=, this]()
+			{
+				m_bindless.cleanup(this);
+			});
+
+		m_samplerCache.init(m_device, &m_bindless, MAX_SAMPLER_ANISOTROPY, m_gpuProperties.limits);
+		m_mainDeletionQueue.pushFunction([=, this]()
+			{
+				m_samplerCache.cleanup();
+			});
+
+		m_assetRegistry.init(this);
+		m_mainDeletionQueue.pushFunction([=, this]()
+			{
+				m_assetRegistry.cleanup();
+			});
+
+		// one persistently mapped scene data slice per frame in flight
+		m_sceneDataStride = padUniformBufferSize(sizeof(GPUSceneData));
+		m_sceneDataBuffer = createBuffer(m_sceneDataStride * FRAME_OVERLAP, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		m_mainDeletionQueue.pushFunction([=, this]()
+			{
+				destroyBuffer(m_sceneDataBuffer);
+			});
+
 		for (int i = 0; i < FRAME_OVERLAP; i++)
 		{
 			std::vector<DescriptorAllocator::PoolSizeRatio> frame_sizes = {
@@ -752,6 +1178,12 @@ namespace Moon
 			m_frames[i].frameDescriptors = DescriptorAllocator{};
 			m_frames[i].frameDescriptors.initPool(m_device, 1000, frame_sizes);
 
+			// the object buffer binding is written by reserveFrameDraws when the buffer is (re)allocated
+			m_frames[i].sceneDescriptor = m_globalDescriptorAllocator.allocate(m_device, m_gpuSceneDataDescriptorLayout);
+			DescriptorWriter writer;
+			writer.writeBuffer(0, m_sceneDataBuffer.buffer, sizeof(GPUSceneData), 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+			writer.updateSet(m_device, m_frames[i].sceneDescriptor);
+
 			m_mainDeletionQueue.pushFunction([&, i]()
 				{
 					m_frames[i].frameDescriptors.destroyPool(m_device);
@@ -762,6 +1194,134 @@ namespace Moon
 	void RenderDevice::initPipelines()
 	{
 		m_metalRoughMaterial.buildPipelines(this);
+		initClusterCulling();
+		initDrawCulling();
+	}
+
+	void RenderDevice::initClusterCulling()
+	{
+		VkShaderModule cullShader;
+		if (!loadShaderModule("../../shaders/clusterCull.comp.spv", &cullShader))
+			std::cout << "Error when building the cluster culling shader module" << std::endl;
+
+		VkPushConstantRange pushConstants{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUClusterCullConstants) };
+		VkPipelineLayoutCreateInfo layoutInfo = Moon::pipelineLayoutCreateInfo();
+		layoutInfo.setLayoutCount = 1;
+		layoutInfo.pSetLayouts = &m_gpuSceneDataDescriptorLayout;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstants;
+		VK_CHECK(vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_clusterCullLayout));
+
+		VkComputePipelineCreateInfo pipelineInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+		pipelineInfo.stage = Moon::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, cullShader);
+		pipelineInfo.layout = m_clusterCullLayout;
+		VK_CHECK(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_clusterCullPipeline));
+		vkDestroyShaderModule(m_device, cullShader, nullptr);
+
+		// read back by the CPU, zeroed so the first frames report nothing visible
+		for (FrameData& frame : m_frames)
+		{
+			frame.clusterStatsBuffer = createBuffer(sizeof(GPUClusterStats),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
+			*(GPUClusterStats*)frame.clusterStatsBuffer.info.pMappedData = GPUClusterStats{ 0, 0 };
+		}
+
+		m_mainDeletionQueue.pushFunction([=, this]()
+			{
+				for (FrameData& frame : m_frames)
+				{
+					destroyBuffer(frame.clusterStatsBuffer);
+				}
+				vkDestroyPipeline(m_device, m_clusterCullPipeline, nullptr);
+				vkDestroyPipelineLayout(m_device, m_clusterCullLayout, nullptr);
+			});
+	}
+
+	void RenderDevice::initDrawCulling()
+	{
+		initDepthPyramid();
+
+		VkShaderModule cullShader;
+		if (!loadShaderModule("../../shaders/drawCull.comp.spv", &cullShader))
+			std::cout << "Error when building the draw culling shader module" << std::endl;
+
+		VkDescriptorSetLayout setLayouts[] = { m_gpuSceneDataDescriptorLayout, m_depthPyramidSetLayout };
+		VkPushConstantRange pushConstants{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUDrawCullConstants) };
+		VkPipelineLayoutCreateInfo layoutInfo = Moon::pipelineLayoutCreateInfo();
+		layoutInfo.setLayoutCount = 2;
+		layoutInfo.pSetLayouts = setLayouts;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstants;
+		VK_CHECK(vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_drawCullLayout));
+
+		VkComputePipelineCreateInfo pipelineInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+		pipelineInfo.stage = Moon::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, cullShader);
+		pipelineInfo.layout = m_drawCullLayout;
+		VK_CHECK(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_drawCullPipeline));
+		vkDestroyShaderModule(m_device, cullShader, nullptr);
+
+		m_mainDeletionQueue.pushFunction([=, this]()
+			{
+				vkDestroyPipeline(m_device, m_drawCullPipeline, nullptr);
+				vkDestroyPipelineLayout(m_device, m_drawCullLayout, nullptr);
+			});
+	}
+
+	void RenderDevice::initDepthPyramid()
+	{
+		// rounded down so every texel of a level covers 2x2 texels of the level below, see depthReduce.comp
+		m_depthPyramidExtent = VkExtent2D{ std::max(m_windowExtent.width / 2, 1u), std::max(m_windowExtent.height / 2, 1u) };
+		VkExtent3D extent{ m_depthPyramidExtent.width, m_depthPyramidExtent.height, 1 };
+		uint32_t levelCount = getMipLevelCount(extent);
+		m_depthPyramid = createImage(extent, VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, levelCount);
+
+		m_depthPyramidMips.resize(levelCount);
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			VkImageViewCreateInfo viewInfo = imageviewCreateInfo(VK_FORMAT_R32_SFLOAT, m_depthPyramid.image, VK_IMAGE_ASPECT_COLOR_BIT);
+			viewInfo.subresourceRange.baseMipLevel = level;
+			VK_CHECK(vkCreateImageView(m_device, &viewInfo, nullptr, &m_depthPyramidMips[level]));
+		}
+
+		{
+			DescriptorLayoutBuilder builder;
+			builder.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT);
+			builder.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT);
+			m_depthReduceSetLayout = builder.build(m_device);
+		}
+		{
+			DescriptorLayoutBuilder builder;
+			builder.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT);
+			m_depthPyramidSetLayout = builder.build(m_device);
+		}
+
+		VkShaderModule reduceShader;
+		if (!loadShaderModule("../../shaders/depthReduce.comp.spv", &reduceShader))
+			std::cout << "Error when building the depth reduce shader module" << std::endl;
+
+		VkPipelineLayoutCreateInfo layoutInfo = Moon::pipelineLayoutCreateInfo();
+		layoutInfo.setLayoutCount = 1;
+		layoutInfo.pSetLayouts = &m_depthReduceSetLayout;
+		VK_CHECK(vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_depthReduceLayout));
+
+		VkComputePipelineCreateInfo pipelineInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+		pipelineInfo.stage = Moon::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, reduceShader);
+		pipelineInfo.layout = m_depthReduceLayout;
+		VK_CHECK(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_depthReducePipeline));
+		vkDestroyShaderModule(m_device, reduceShader, nullptr);
+
+		m_mainDeletionQueue.pushFunction([=, this]()
+			{
+				vkDestroyPipeline(m_device, m_depthReducePipeline, nullptr);
+				vkDestroyPipelineLayout(m_device, m_depthReduceLayout, nullptr);
+				vkDestroyDescriptorSetLayout(m_device, m_depthReduceSetLayout, nullptr);
+				vkDestroyDescriptorSetLayout(m_device, m_depthPyramidSetLayout, nullptr);
+				for (VkImageView view : m_depthPyramidMips)
+				{
+					vkDestroyImageView(m_device, view, nullptr);
+				}
+				destroyImage(m_depthPyramid);
+			});
 	}
 
 	void RenderDevice::initRayTracing()
@@ -855,61 +1415,61 @@ namespace Moon
 		m_errorCheckerboardImage = createImage(pixels.data(), VkExtent3D{ 16, 16, 1 }, VK_FORMAT_R8G8B8A8_UNORM,
 			VK_IMAGE_USAGE_SAMPLED_BIT);
 
+		// the default samplers live in the sampler cache until it is cleaned up
 		VkSamplerCreateInfo sampl = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
 		sampl.magFilter = VK_FILTER_NEAREST;
 		sampl.minFilter = VK_FILTER_NEAREST;
-		vkCreateSampler(m_device, &sampl, nullptr, &m_defaultSamplerNearest);
+		SamplerHandle nearest = m_samplerCache.acquire(sampl);
+		m_defaultSamplerNearest = nearest.sampler;
+		m_defaultSamplerNearestIndex = nearest.index;
 
 		sampl.magFilter = VK_FILTER_LINEAR;
 		sampl.minFilter = VK_FILTER_LINEAR;
-		vkCreateSampler(m_device, &sampl, nullptr, &m_defaultSamplerLinear);
+		sampl.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		sampl.anisotropyEnable = VK_TRUE;
+		sampl.maxAnisotropy = m_samplerCache.getMaxAnisotropy();
+		sampl.maxLod = VK_LOD_CLAMP_NONE;
+		SamplerHandle linear = m_samplerCache.acquire(sampl);
+		m_defaultSamplerLinear = linear.sampler;
+		m_defaultSamplerLinearIndex = linear.index;
 
 		m_mainDeletionQueue.pushFunction([&]()
 			{
-				vkDestroySampler(m_device, m_defaultSamplerLinear, nullptr);
-				vkDestroySampler(m_device, m_defaultSamplerNearest, nullptr);
-
 				destroyImage(m_whiteImage);
 				destroyImage(m_greyImage);
 				destroyImage(m_blackImage);
 				destroyImage(m_errorCheckerboardImage);
 			});
 
-		GLTFMetallic_Roughness::MaterialResources materialResources;
-		materialResources.colorImage = m_whiteImage;
-		materialResources.colorSampler = m_defaultSamplerLinear;
-		materialResources.metalRoughImage = m_whiteImage;
-		materialResources.metalRoughSampler = m_defaultSamplerLinear;
-
-		AllocatedBuffer materialConstants = createBuffer(sizeof(GLTFMetallic_Roughness::MaterialConstants), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-		GLTFMetallic_Roughness::MaterialConstants* sceneUniformData = (GLTFMetallic_Roughness::MaterialConstants*)materialConstants.allocation->GetMappedData();
-		sceneUniformData->baseColorFactors = glm::vec4(1, 1, 1, 1);
-		sceneUniformData->metalRoughFactors = glm::vec4(1, 0.5, 0, 0);
-
-		m_mainDeletionQueue.pushFunction([=, this]()
-			{
-				destroyBuffer(materialConstants);
-			});
+		m_whiteTextureIndex = m_bindless.registerTexture(m_whiteImage.imageView);
+		m_errorTextureIndex = m_bindless.registerTexture(m_errorCheckerboardImage.imageView);
 
-		materialResources.dataBuffer = materialConstants.buffer;
-		materialResources.dataBufferOffset = 0;
+		GPUMaterialData materialData;
+		materialData.baseColorFactors = glm::vec4(1, 1, 1, 1);
+		materialData.metalRoughFactors = glm::vec4(1, 0.5, 0, 0);
+		materialData.colorTextureIndex = m_whiteTextureIndex;
+		materialData.colorSamplerIndex = m_defaultSamplerLinearIndex;
+		materialData.metalRoughTextureIndex = m_whiteTextureIndex;
+		materialData.metalRoughSamplerIndex = m_defaultSamplerLinearIndex;
 
-		m_defaultData = m_metalRoughMaterial.writeMaterial(m_device, MaterialPass::MainColor, materialResources, m_globalDescriptorAllocator);
+		m_defaultData = m_metalRoughMaterial.writeMaterial(MaterialPass::MainColor, materialData, m_bindless);
+		assert(m_defaultData.materialId != BindlessResources::InvalidIndex);
+		m_defaultMaterialIndex = m_defaultData.materialId;
 
 		std::string structurePath = {"..\\..\\Assets\\structure.glb"};
-		auto structureFile = loadGltf(this, structurePath);
+		auto structureFile = loadScene(this, structurePath);
 		assert(structureFile.has_value());
-		m_loadedScenes["structure"] = *structureFile;
+		addScene("structure", *structureFile);
 		
 		//std::string sponzaPath = {"..\\..\\Assets\\main_sponza\\Main.1_Sponza\\NewSponza_Main_glTF_002.gltf"};
-		//auto sponzaFile = loadGltf(this, sponzaPath);
+		//auto sponzaFile = loadScene(this, sponzaPath);
 		//assert(sponzaFile.has_value());
-		//m_loadedScenes["Sponza"] = *sponzaFile;
+		//addScene("Sponza", *sponzaFile);
 
 		//std::string sponzaCurtainsPath = {"..\\..\\Assets\\main_sponza\\PKG_A_Curtains\\NewSponza_Curtains_glTF.gltf"};
-		//auto sponzaCurtainsFile = loadGltf(this, sponzaCurtainsPath);
+		//auto sponzaCurtainsFile = loadScene(this, sponzaCurtainsPath);
 		//assert(sponzaCurtainsFile.has_value());
-		//m_loadedScenes["SponzaCurtains"] = *sponzaCurtainsFile;
+		//addScene("SponzaCurtains", *sponzaCurtainsFile);
 	}
 
 	FrameData& RenderDevice::getCurrentFrame()
@@ -917,6 +1477,359 @@ namespace Moon
 		return m_frames[m_frameNumber % FRAME_OVERLAP];
 	}
 
+	void RenderDevice::cullObjects(const Frustum& frustum, const LodSelection& lodSelection, bool gpuCulling)
+	{
+		CPU_TIMER(&m_stats.cullingTime);
+
+		// a camera that did not move over objects that did not change sees the same draws as last frame
+		const uint32_t options = (gpuCulling ? 1u : 0u) | (m_useSoftwareOcclusion ? 2u : 0u) | (m_useTemporalCulling ? 4u : 0u) |
+			(m_useBvhCulling ? 8u : 0u);
+		const uint64_t version = m_renderRegistry.getVersion();
+		if (m_useTemporalCulling && options == m_cullingOptions && version == m_cullingVersion && m_sceneData.viewproj == m_cullingViewProj)
+		{
+			m_stats.cullTestedCount = 0;
+			return;
+		}
+		m_cullingOptions = options;
+		m_cullingVersion = version;
+		m_cullingViewProj = m_sceneData.viewproj;
+
+		const CullingBounds& opaqueBounds = m_renderRegistry.getOpaqueBounds();
+		const CullingBounds& transparentBounds = m_renderRegistry.getTransparentBounds();
+		m_opaqueDraws.clear();
+		m_transparentDraws.clear();
+		// The two compose: while the camera stays within the margin of the temporal reference only the objects near a
+		// plane are tested again, which is cheaper than walking the hierarchies; the frames the reference cannot be
+		// used for, because objects keep moving, go through the hierarchies. The reference rebuild measures every object.
+		if (m_useBvhCulling)
+		{
+			m_renderRegistry.updateBvhs(&m_jobSystem);
+		}
+		const Bvh* opaqueBvh = m_useBvhCulling ? &m_renderRegistry.getOpaqueBvh() : nullptr;
+		const Bvh* transparentBvh = m_useBvhCulling ? &m_renderRegistry.getTransparentBvh() : nullptr;
+		if (m_useTemporalCulling)
+		{
+			m_stats.cullTestedCount = 0;
+			if (!gpuCulling)
+			{
+				m_opaqueCuller.cull(opaqueBounds, version, frustum, lodSelection.cameraPosition, m_opaqueDraws, &m_jobSystem, opaqueBvh);
+				m_stats.cullTestedCount += static_cast<int>(m_opaqueCuller.getRetestedCount());
+			}
+			m_transparentCuller.cull(transparentBounds, version, frustum, lodSelection.cameraPosition, m_transparentDraws, &m_jobSystem, transparentBvh);
+			m_stats.cullTestedCount += static_cast<int>(m_transparentCuller.getRetestedCount());
+		}
+		else if (m_useBvhCulling)
+		{
+			m_stats.cullTestedCount = 0;
+			if (!gpuCulling)
+			{
+				m_stats.cullTestedCount += static_cast<int>(opaqueBvh->cullFrustum(frustum, m_opaqueDraws));
+			}
+			m_stats.cullTestedCount += static_cast<int>(transparentBvh->cullFrustum(frustum, m_transparentDraws));
+		}
+		else
+		{
+			if (!gpuCulling)
+			{
+				cullBounds(opaqueBounds, frustum, m_opaqueDraws, &m_jobSystem);
+			}
+			cullBounds(transparentBounds, frustum, m_transparentDraws, &m_jobSystem);
+			m_stats.cullTestedCount = static_cast<int>((gpuCulling ? 0 : opaqueBounds.size()) + transparentBounds.size());
+		}
+
+		//the opaque occluders in view hide the other objects of the CPU path, before their levels of detail are picked
+		m_stats.occluderCount = 0;
+		m_stats.softwareOccludedCount = 0;
+		if (!gpuCulling && m_useSoftwareOcclusion)
+		{
+			m_occlusionCuller.renderOccluders(m_renderRegistry.getDrawContext().OpaqueSurfaces, opaqueBounds, m_opaqueDraws, m_sceneData.viewproj,
+				lodSelection.cameraPosition, lodSelection.projectionScale, &m_jobSystem);
+			m_occlusionCuller.cullOccluded(opaqueBounds, m_opaqueDraws, &m_jobSystem);
+			m_occlusionCuller.cullOccluded(transparentBounds, m_transparentDraws, &m_jobSystem);
+			m_stats.occluderCount = static_cast<int>(m_occlusionCuller.getStats().occluderCount);
+			m_stats.softwareOccludedCount = static_cast<int>(m_occlusionCuller.getStats().occludedCount);
+		}
+	}
+
+	void RenderDevice::pickObject(int x, int y)
+	{
+		// reverse-Z, the near plane is at depth 1
+		glm::mat4 inverseViewProj = glm::inverse(m_sceneData.viewproj);
+		glm::vec2 ndc(2.f * (x + 0.5f) / m_windowExtent.width - 1.f, 2.f * (y + 0.5f) / m_windowExtent.height - 1.f);
+		glm::vec4 nearPoint = inverseViewProj * glm::vec4(ndc, 1.f, 1.f);
+		glm::vec4 farPoint = inverseViewProj * glm::vec4(ndc, 0.f, 1.f);
+		glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+		glm::vec3 ray = glm::vec3(farPoint) / farPoint.w - origin;
+
+		float length = glm::length(ray);
+		m_renderRegistry.updateBvhs(&m_jobSystem);
+		m_pickValid = m_renderRegistry.raycast(origin, ray / length, length, m_pickHit);
+	}
+
+	void RenderDevice::reserveFrameDraws(FrameData& frame, uint32_t drawCount)
+	{
+		if (frame.drawCapacity > 0 && drawCount <= frame.drawCapacity)
+		{
+			return;
+		}
+
+		// the frame fence has been waited on, its previous buffers are no longer in use
+		if (frame.drawCapacity > 0)
+		{
+			destroyBuffer(frame.objectBuffer);
+			destroyBuffer(frame.indirectBuffer);
+		}
+		frame.cullObjectVersion = ~0ull;
+
+		frame.drawCapacity = std::max({ drawCount, frame.drawCapacity * 2, 1024u });
+		frame.objectBuffer = createBuffer(frame.drawCapacity * sizeof(GPUObjectData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		frame.indirectBuffer = createBuffer(frame.drawCapacity * sizeof(VkDrawIndexedIndirectCommand),
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+		DescriptorWriter writer;
+		writer.writeBuffer(1, frame.objectBuffer.buffer, frame.drawCapacity * sizeof(GPUObjectData), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		writer.updateSet(m_device, frame.sceneDescriptor);
+	}
+
+	void RenderDevice::reserveClusterBuffers(FrameData& frame, uint32_t jobCount, uint32_t indexCount)
+	{
+		// the frame fence has been waited on, its previous buffers are no longer in use
+		if (jobCount > frame.clusterJobCapacity)
+		{
+			if (frame.clusterJobCapacity > 0)
+			{
+				destroyBuffer(frame.clusterJobBuffer);
+			}
+			frame.clusterJobCapacity = std::max({ jobCount, frame.clusterJobCapacity * 2, 4096u });
+			frame.clusterJobBuffer = createBuffer(frame.clusterJobCapacity * sizeof(GPUClusterJob),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		}
+
+		if (indexCount > frame.clusterIndexCapacity)
+		{
+			if (frame.clusterIndexCapacity > 0)
+			{
+				destroyBuffer(frame.clusterIndexBuffer);
+			}
+			frame.clusterIndexCapacity = std::max({ indexCount, frame.clusterIndexCapacity * 2, 1u << 20 });
+			frame.clusterIndexBuffer = createBuffer(frame.clusterIndexCapacity * sizeof(uint32_t),
+				VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+		}
+	}
+
+	void RenderDevice::reserveDrawCullBuffers(FrameData& frame, uint32_t objectCount, uint32_t batchCount)
+	{
+		// the frame fence has been waited on, its previous buffers are no longer in use
+		if (objectCount > frame.cullObjectCapacity)
+		{
+			if (frame.cullObjectCapacity > 0)
+			{
+				destroyBuffer(frame.cullObjectBuffer);
+			}
+			frame.cullObjectCapacity = std::max({ objectCount, frame.cullObjectCapacity * 2, 1024u });
+			frame.cullObjectBuffer = createBuffer(frame.cullObjectCapacity * sizeof(GPUCullObject),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+			frame.cullObjectVersion = ~0ull;
+		}
+
+		// the GPUDrawCullStats counters come first
+		const uint32_t countCount = batchCount + sizeof(GPUDrawCullStats) / sizeof(uint32_t);
+		if (countCount > frame.drawCountCapacity)
+		{
+			if (frame.drawCountCapacity > 0)
+			{
+				destroyBuffer(frame.drawCountBuffer);
+			}
+			frame.drawCountCapacity = std::max({ countCount, frame.drawCountCapacity * 2, 256u });
+			frame.drawCountBuffer = createBuffer(frame.drawCountCapacity * sizeof(uint32_t),
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+				VMA_MEMORY_USAGE_GPU_TO_CPU);
+		}
+	}
+
+	void RenderDevice::resetVisibility(VkCommandBuffer cmd, uint32_t objectCount)
+	{
+		// shared by the frames, the frame in flight may still read the previous buffer
+		if (objectCount > m_visibilityCapacity)
+		{
+			if (m_visibilityCapacity > 0)
+			{
+				getCurrentFrame().deletionQueue.pushFunction([=, this, buffer = m_visibilityBuffer]()
+					{
+						destroyBuffer(buffer);
+					});
+			}
+			m_visibilityCapacity = std::max({ objectCount, m_visibilityCapacity * 2, 1024u });
+			m_visibilityBuffer = createBuffer(m_visibilityCapacity * sizeof(uint32_t),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+			m_visibilityVersion = ~0ull;
+		}
+
+		// the dense indices moved, every object is drawn by the early phase once
+		if (m_visibilityVersion != m_renderRegistry.getLayoutVersion())
+		{
+			m_visibilityVersion = m_renderRegistry.getLayoutVersion();
+			vkCmdFillBuffer(cmd, m_visibilityBuffer.buffer, 0, VkDeviceSize(m_visibilityCapacity) * sizeof(uint32_t), 1);
+		}
+	}
+
+	void RenderDevice::cullDraws(VkCommandBuffer cmd, FrameData& frame, DrawCullPhase phase, uint32_t objectCount, const LodSelection& lodSelection,
+		uint32_t sceneDataOffset, VkDescriptorSet pyramidSet)
+	{
+		GPUDrawCullConstants constants;
+		constants.objects = getBufferAddress(frame.cullObjectBuffer.buffer);
+		constants.commands = getBufferAddress(frame.indirectBuffer.buffer);
+		constants.counts = getBufferAddress(frame.drawCountBuffer.buffer);
+		constants.visibility = m_visibilityCapacity > 0 ? getBufferAddress(m_visibilityBuffer.buffer) : 0;
+		constants.projectionScale = lodSelection.projectionScale;
+		constants.maxPixelError = lodSelection.maxPixelError;
+		constants.objectCount = objectCount;
+		constants.phase = phase;
+		constants.batchCount = static_cast<uint32_t>(m_drawBatches.size());
+
+		VkDescriptorSet sets[] = { frame.sceneDescriptor, pyramidSet };
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_drawCullPipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_drawCullLayout, 0, 2, sets, 1, &sceneDataOffset);
+		vkCmdPushConstants(cmd, m_drawCullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+		vkCmdDispatch(cmd, (objectCount + DRAW_CULL_GROUP_SIZE - 1) / DRAW_CULL_GROUP_SIZE, 1, 1);
+	}
+
+	void RenderDevice::buildDepthPyramid(VkCommandBuffer cmd, FrameData& frame)
+	{
+		transitionImage(cmd, m_depthImage.image, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_depthReducePipeline);
+		for (uint32_t level = 0; level < m_depthPyramidMips.size(); level++)
+		{
+			VkDescriptorSet reduceSet = frame.frameDescriptors.allocate(m_device, m_depthReduceSetLayout);
+			DescriptorWriter writer;
+			if (level == 0)
+			{
+				writer.writeImage(0, m_depthImage.imageView, m_defaultSamplerNearest, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+			}
+			else
+			{
+				writer.writeImage(0, m_depthPyramidMips[level - 1], m_defaultSamplerNearest, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+			}
+			writer.writeImage(1, m_depthPyramidMips[level], VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+			writer.updateSet(m_device, reduceSet);
+
+			VkExtent3D extent = getMipExtent(VkExtent3D{ m_depthPyramidExtent.width, m_depthPyramidExtent.height, 1 }, level);
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_depthReduceLayout, 0, 1, &reduceSet, 0, nullptr);
+			vkCmdDispatch(cmd, (extent.width + DEPTH_REDUCE_GROUP_SIZE - 1) / DEPTH_REDUCE_GROUP_SIZE,
+				(extent.height + DEPTH_REDUCE_GROUP_SIZE - 1) / DEPTH_REDUCE_GROUP_SIZE, 1);
+
+			// the next level, or the late phase, reads this one
+			VkMemoryBarrier2 reduceBarrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+			reduceBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+			reduceBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+			reduceBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+			reduceBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+			VkDependencyInfo reduceDependency{ VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+			reduceDependency.memoryBarrierCount = 1;
+			reduceDependency.pMemoryBarriers = &reduceBarrier;
+			vkCmdPipelineBarrier2(cmd, &reduceDependency);
+		}
+
+		transitionImage(cmd, m_depthImage.image, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+	}
+
+	void RenderDevice::updateDrawBatches()
+	{
+		// transforms do not move an object to another batch, only new objects or materials do
+		if (m_drawBatchLayoutVersion == m_renderRegistry.getLayoutVersion() && m_drawBatchMaterialVersion == m_renderRegistry.getMaterialVersion())
+		{
+			return;
+		}
+		m_drawBatchLayoutVersion = m_renderRegistry.getLayoutVersion();
+		m_drawBatchMaterialVersion = m_renderRegistry.getMaterialVersion();
+
+		// the batch and first command of every copy change
+		for (FrameData& frame : m_frames)
+		{
+			frame.cullObjectVersion = ~0ull;
+		}
+
+		// ordered by pipeline first so the batches of a pipeline follow each other
+		const std::vector<RenderObject>& objects = m_renderRegistry.getDrawContext().OpaqueSurfaces;
+		std::map<std::pair<MaterialPipeline*, VkBuffer>, uint32_t> batchIds;
+		for (const RenderObject& object : objects)
+		{
+			batchIds.try_emplace({ object.material->pipeline, object.indexBuffer }, 0);
+		}
+
+		m_drawBatches.clear();
+		for (auto& [key, id] : batchIds)
+		{
+			id = static_cast<uint32_t>(m_drawBatches.size());
+			m_drawBatches.push_back(DrawBatch{ key.first, key.second, VK_INDEX_TYPE_UINT32, 0, 0 });
+		}
+
+		m_drawBatchOf.resize(objects.size());
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			uint32_t batch = batchIds[{ objects[i].material->pipeline, objects[i].indexBuffer }];
+			m_drawBatchOf[i] = batch;
+			m_drawBatches[batch].indexType = objects[i].indexType;
+			m_drawBatches[batch].capacity++;
+		}
+
+		uint32_t firstCommand = 0;
+		for (DrawBatch& batch : m_drawBatches)
+		{
+			batch.firstCommand = firstCommand;
+			firstCommand += batch.capacity;
+		}
+	}
+
+	void RenderDevice::writeCullObjects(FrameData& frame)
+	{
+		if (frame.cullObjectVersion == m_renderRegistry.getVersion())
+		{
+			return;
+		}
+
+		// a layout change rebuilds the batches, which resets the version; otherwise only the objects changed since the
+		// last write of this frame are copied again
+		const uint64_t writtenVersion = frame.cullObjectVersion;
+		frame.cullObjectVersion = m_renderRegistry.getVersion();
+
+		const std::vector<RenderObject>& objects = m_renderRegistry.getDrawContext().OpaqueSurfaces;
+		const CullingBounds& bounds = m_renderRegistry.getOpaqueBounds();
+		std::span<const uint64_t> changes = m_renderRegistry.getOpaqueChangeVersions();
+		GPUObjectData* objectData = (GPUObjectData*)frame.objectBuffer.info.pMappedData;
+		GPUCullObject* cullObjects = (GPUCullObject*)frame.cullObjectBuffer.info.pMappedData;
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			if (writtenVersion != ~0ull && changes[i] <= writtenVersion)
+			{
+				continue;
+			}
+
+			const RenderObject& object = objects[i];
+			writeObjectData(objectData[i], object);
+
+			GPUCullObject& cullObject = cullObjects[i];
+			cullObject.center = glm::vec4(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i], bounds.radius[i]);
+			float scale = object.bounds.sphereRadius > 0.f ? bounds.radius[i] / object.bounds.sphereRadius : 1.f;
+			cullObject.extents = glm::vec4(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i], scale);
+			cullObject.batch = m_drawBatchOf[i];
+			cullObject.firstCommand = m_drawBatches[m_drawBatchOf[i]].firstCommand;
+			cullObject.lodCount = object.lodCount;
+			cullObject.padding = 0;
+			for (uint32_t lod = 0; lod < object.lodCount; lod++)
+			{
+				cullObject.lods[lod] = GPUCullLod{ object.lods[lod].startIndex, object.lods[lod].count, object.lods[lod].error, 0 };
+			}
+		}
+	}
+
+	VkDeviceAddress RenderDevice::getBufferAddress(VkBuffer buffer)
+	{
+		VkBufferDeviceAddressInfo addressInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = buffer };
+		return vkGetBufferDeviceAddress(m_device, &addressInfo);
+	}
+
 	bool RenderDevice::loadShaderModule(const char* filePath, VkShaderModule* outShaderModule)
 	{
 		std::ifstream file(filePath, std::ios::ate | std::ios::binary);
@@ -943,49 +1856,41 @@ namespace Moon
 		return true;
 	}
 
-	GPUMeshBuffers RenderDevice::uploadMesh(std::span<uint32_t> indices, std::span<Vertex> vertices)
+	GPUMeshBuffers RenderDevice::uploadMesh(std::span<const uint8_t> indices, VkIndexType indexType, std::span<const uint8_t> vertices, VertexFormat vertexFormat,
+		std::span<const Meshlet> meshlets)
 	{
-		const size_t vertexBufferSize = vertices.size() * sizeof(Vertex);
-		const size_t indexBufferSize = indices.size() * sizeof(uint32_t);
+		const size_t vertexBufferSize = vertices.size();
+		const size_t indexBufferSize = indices.size();
 
 		GPUMeshBuffers newSurface;
+		newSurface.indexType = indexType;
+		newSurface.vertexFormat = vertexFormat;
 		newSurface.vertexBuffer = createBuffer(vertexBufferSize, 
 			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
 			VMA_MEMORY_USAGE_GPU_ONLY);
-		VkBufferDeviceAddressInfo deviceAdressInfo
-		{ 
-			.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, 
-			.buffer = newSurface.vertexBuffer.buffer 
-		};
-		newSurface.vertexBufferAddress = vkGetBufferDeviceAddress(m_device, &deviceAdressInfo);
-		newSurface.indexBuffer = createBuffer(indexBufferSize, 
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY);
-
-		AllocatedBuffer staging = createBuffer(vertexBufferSize + indexBufferSize, 
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-			VMA_MEMORY_USAGE_CPU_ONLY);
+		newSurface.vertexBufferAddress = getBufferAddress(newSurface.vertexBuffer.buffer);
+		newSurface.meshBufferId = m_nextMeshBufferId++;
 
-		void* data = staging.allocation->GetMappedData();
-		memcpy(data, vertices.data(), vertexBufferSize);
-		memcpy((char*)data + vertexBufferSize, indices.data(), indexBufferSize);
+		// clusterCull.comp reads the indices as 32 bit words, the buffer is padded to a whole word
+		newSurface.indexBuffer = createBuffer((indexBufferSize + 3) & ~size_t(3),
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY);
+		newSurface.indexBufferAddress = getBufferAddress(newSurface.indexBuffer.buffer);
 
-		immediateSubmit([&](VkCommandBuffer cmd)
-			{
-				VkBufferCopy vertexCopy{ 0 };
-				vertexCopy.dstOffset = 0;
-				vertexCopy.srcOffset = 0;
-				vertexCopy.size = vertexBufferSize;
-				vkCmdCopyBuffer(cmd, staging.buffer, newSurface.vertexBuffer.buffer, 1, &vertexCopy);
-
-				VkBufferCopy indexCopy{ 0 };
-				indexCopy.dstOffset = 0;
-				indexCopy.srcOffset = vertexBufferSize;
-				indexCopy.size = indexBufferSize;
-				vkCmdCopyBuffer(cmd, staging.buffer, newSurface.indexBuffer.buffer, 1, &indexCopy);
-			});
+		newSurface.meshletBuffer = {};
+		newSurface.meshletBufferAddress = 0;
+		if (!meshlets.empty())
+		{
+			newSurface.meshletBuffer = createBuffer(meshlets.size_bytes(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+				VMA_MEMORY_USAGE_GPU_ONLY);
+			newSurface.meshletBufferAddress = getBufferAddress(newSurface.meshletBuffer.buffer);
+			m_uploads.uploadBuffer(newSurface.meshletBuffer.buffer, 0, meshlets.data(), meshlets.size_bytes());
+		}
 
-		destroyBuffer(staging);
+		// batched with the other uploads of the frame, no round trip per mesh
+		m_uploads.uploadBuffer(newSurface.vertexBuffer.buffer, 0, vertices.data(), vertexBufferSize);
+		newSurface.upload = m_uploads.uploadBuffer(newSurface.indexBuffer.buffer, 0, indices.data(), indexBufferSize);
 
 		return newSurface;
 	}
@@ -1021,28 +1926,17 @@ namespace Moon
 		if (!engine->loadShaderModule("../../shaders/mesh.vert.spv", &meshVertexShader))
 			std::cout << "Error when building the triangle vertex shader module" << std::endl;
 
-		VkPushConstantRange matrixRange{};
-		matrixRange.offset = 0;
-		matrixRange.size = sizeof(GPUDrawPushConstants);
-		matrixRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-		DescriptorLayoutBuilder layoutBuilder;
-		layoutBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
-		layoutBuilder.addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
-		layoutBuilder.addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
-		materialLayout = layoutBuilder.build(engine->getDevice());
-
 		VkPipelineLayout newLayout;
-		VkDescriptorSetLayout layouts[] = { engine->getSceneDataDescriptorLayout(), materialLayout};
+		VkDescriptorSetLayout layouts[] = { engine->getSceneDataDescriptorLayout(), engine->getBindlessResources().getLayout() };
 		VkPipelineLayoutCreateInfo mesh_layout_info = Moon::pipelineLayoutCreateInfo();
 		mesh_layout_info.setLayoutCount = 2;
 		mesh_layout_info.pSetLayouts = layouts;
-		mesh_layout_info.pPushConstantRanges = &matrixRange;
-		mesh_layout_info.pushConstantRangeCount = 1;
 		VK_CHECK(vkCreatePipelineLayout(engine->getDevice(), &mesh_layout_info, nullptr, &newLayout));
 
 		opaquePipeline.layout = newLayout;
+		opaquePipeline.id = 0;
 		transparentPipeline.layout = newLayout;
+		transparentPipeline.id = 1;
 
 		PipelineBuilder pipelineBuilder;
 		pipelineBuilder.setShaders(meshVertexShader, meshFragShader);
@@ -1069,7 +1963,6 @@ namespace Moon
 				vkDestroyPipeline(engine->getDevice(), opaquePipeline.pipeline, nullptr);
 				vkDestroyPipeline(engine->getDevice(), transparentPipeline.pipeline, nullptr);
 				vkDestroyPipelineLayout(engine->getDevice(), newLayout, nullptr);
-				vkDestroyDescriptorSetLayout(engine->getDevice(), materialLayout, nullptr);
 			});
 	}
 
@@ -1077,10 +1970,11 @@ namespace Moon
 	{
 	}
 
-	MaterialInstance GLTFMetallic_Roughness::writeMaterial(VkDevice device, MaterialPass pass, const MaterialResources& resources, DescriptorAllocator& descriptorAllocator)
+	MaterialInstance GLTFMetallic_Roughness::writeMaterial(MaterialPass pass, const GPUMaterialData& data, BindlessResources& bindless)
 	{
 		MaterialInstance matData;
 		matData.passType = pass;
+		matData.materialId = bindless.allocateMaterial(data);
 		if (pass == MaterialPass::Transparent)
 		{
 			matData.pipeline = &transparentPipeline;
@@ -1089,13 +1983,6 @@ namespace Moon
 		{
 			matData.pipeline = &opaquePipeline;
 		}
-		matData.materialSet = descriptorAllocator.allocate(device, materialLayout);
-
-		writer.clear();
-		writer.writeBuffer(0, resources.dataBuffer, sizeof(MaterialConstants), resources.dataBufferOffset, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-		writer.writeImage(1, resources.colorImage.imageView, resources.colorSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-		writer.writeImage(2, resources.metalRoughImage.imageView, resources.metalRoughSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-		writer.updateSet(device, matData.materialSet);
 
 		return matData;
 	}
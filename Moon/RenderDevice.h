@@ -1,10 +1,20 @@
 ﻿#pragma once
 #include "RenderTypes.h"
 #include "Image.h"
+#include "Ktx2.h"
+#include "SamplerCache.h"
+#include "AssetRegistry.h"
 #include "Mesh.h"
+#include "SceneImport.h"
 #include "Descriptor.h"
 #include "Pipeline.h"
 #include "Camera.h"
+#include "RenderRegistry.h"
+#include "JobSystem.h"
+#include "RenderQueue.h"
+#include "OcclusionCulling.h"
+#include "Bindless.h"
+#include "UploadManager.h"
 
 #include <functional>
 #include <unordered_map>
@@ -14,6 +24,7 @@
 constexpr unsigned int FRAME_OVERLAP = 2;
 constexpr unsigned int SCREEN_WIDTH = 1920;
 constexpr unsigned int SCREEN_HEIGHT = 1080;
+constexpr float MAX_SAMPLER_ANISOTROPY = 16.f; // clamped to the device limit
 
 //Forward declaration
 struct SDL_Window;
@@ -58,47 +69,135 @@ namespace Moon
 
 		DeletionQueue deletionQueue;
 		DescriptorAllocator frameDescriptors;
+
+		// scene data (dynamic offset into the scene data ring) and object buffer, written once
+		VkDescriptorSet sceneDescriptor;
+
+		// per draw object data and indirect commands, rewritten every frame
+		AllocatedBuffer objectBuffer;
+		AllocatedBuffer indirectBuffer;
+		uint32_t drawCapacity{ 0 };
+
+		// meshlets tested by clusterCull.comp and the indices of the visible ones, rewritten every frame
+		AllocatedBuffer clusterJobBuffer;
+		AllocatedBuffer clusterIndexBuffer;
+		AllocatedBuffer clusterStatsBuffer; // GPUClusterStats, read back once the frame fence is signaled
+		uint32_t clusterJobCapacity{ 0 };
+		uint32_t clusterIndexCapacity{ 0 };
+		uint32_t recordedTriangles{ 0 }; // every triangle the frame submitted, and the part of them behind cluster culling
+		uint32_t clusterTriangles{ 0 };
+
+		// copies of the opaque objects for drawCull.comp, the object data of a draw is at its dense index in objectBuffer
+		AllocatedBuffer cullObjectBuffer;
+		AllocatedBuffer drawCountBuffer; // GPUDrawCullStats then the count of every batch and phase, read back once the frame fence is signaled
+		uint32_t cullObjectCapacity{ 0 };
+		uint32_t drawCountCapacity{ 0 };
+		uint64_t cullObjectVersion{ ~0ull }; // registry version of the copies, ~0ull rewrites them all
+		uint32_t drawCountCount{ 0 }; // batch counts written by the frame, over every phase
 	};
 
-	struct GLTFMetallic_Roughness
+	// counters written by clusterCull.comp
+	struct GPUClusterStats
 	{
-		MaterialPipeline opaquePipeline;
-		MaterialPipeline transparentPipeline;
-		VkDescriptorSetLayout materialLayout;
+		uint32_t visibleMeshlets;
+		uint32_t visibleTriangles;
+	};
 
-		struct MaterialConstants
-		{
-			glm::vec4 baseColorFactors;
-			glm::vec4 metalRoughFactors;
-			glm::vec4 extra[14];
-		};
+	constexpr uint32_t CLUSTER_CULL_GROUP_SIZE = 64; // local_size_x of clusterCull.comp
 
-		struct MaterialResources
-		{
-			AllocatedImage colorImage;
-			VkSampler colorSampler;
-			AllocatedImage metalRoughImage;
-			VkSampler metalRoughSampler;
-			VkBuffer dataBuffer;
-			uint32_t dataBufferOffset;
-		};
+	// push constants of clusterCull.comp
+	struct GPUClusterCullConstants
+	{
+		VkDeviceAddress jobs; // GPUClusterJob
+		VkDeviceAddress commands; // VkDrawIndexedIndirectCommand per draw
+		VkDeviceAddress indices; // 32 bit indices of the visible meshlets
+		VkDeviceAddress stats; // GPUClusterStats
+		uint32_t jobCount;
+	};
 
-		DescriptorWriter writer;
+	constexpr uint32_t DRAW_CULL_GROUP_SIZE = 64; // local_size_x of drawCull.comp
+	constexpr uint32_t DEPTH_REDUCE_GROUP_SIZE = 8; // local_size_x and y of depthReduce.comp
+
+	// With occlusion culling the objects visible last frame are drawn first, the depth pyramid is built from their depth
+	// and the late phase draws the objects it does not hide. Both phases write their own commands and counts.
+	enum class DrawCullPhase : uint32_t
+	{
+		All = 0, // frustum culling only
+		Early = 1,
+		Late = 2,
+	};
+
+	// counters in front of the batch counts written by drawCull.comp
+	struct GPUDrawCullStats
+	{
+		uint32_t visibleTriangles;
+		uint32_t occludedObjects; // in the frustum but hidden in both phases
+	};
+
+	// push constants of drawCull.comp
+	struct GPUDrawCullConstants
+	{
+		VkDeviceAddress objects; // GPUCullObject
+		VkDeviceAddress commands; // VkDrawIndexedIndirectCommand, the batches one after the other, once per phase
+		VkDeviceAddress counts; // GPUDrawCullStats, then the draw count of every batch, once per phase
+		VkDeviceAddress visibility; // one uint per object, written by the late phase
+		float projectionScale;
+		float maxPixelError;
+		uint32_t objectCount;
+		DrawCullPhase phase;
+		uint32_t batchCount;
+	};
+
+	// opaque objects sharing pipeline and index buffer, drawn with a single vkCmdDrawIndexedIndirectCount
+	struct DrawBatch
+	{
+		MaterialPipeline* pipeline;
+		VkBuffer indexBuffer;
+		VkIndexType indexType;
+		uint32_t firstCommand;
+		uint32_t capacity; // objects of the batch
+	};
+
+	struct GLTFMetallic_Roughness
+	{
+		MaterialPipeline opaquePipeline;
+		MaterialPipeline transparentPipeline;
 
 		void buildPipelines(RenderDevice* engine);
 		void clearResources(VkDevice device);
 
-		MaterialInstance writeMaterial(VkDevice device, MaterialPass pass, const MaterialResources& resources, DescriptorAllocator& descriptorAllocator);
+		// the material constants and texture indices go to the bindless material buffer, the material id is its slot there
+		MaterialInstance writeMaterial(MaterialPass pass, const GPUMaterialData& data, BindlessResources& bindless);
 	};
 
 	struct EngineStats
 	{
 		float frametime;
 		int triangleCount;
+		int fullTriangleCount; // the drawn objects at their full level of detail
+		int meshletCount; // meshlets tested by the cluster culling
+		int visibleMeshletCount; // GPU results of a previous frame
+		int renderedTriangleCount;
+		int gpuVisibleCount; // opaque objects passing drawCull.comp, read back from a previous frame
+		int occludedCount; // opaque objects in the frustum hidden by the depth pyramid
+		int occluderCount; // rasterized by the software occlusion culling of the CPU path
+		int softwareOccludedCount; // objects in the frustum hidden by the occluders
+		int cullTestedCount; // objects the CPU frustum culling tested against the planes
 		int drawcallCount;
 		float sceneUpdateTime;
 		float meshDrawTime;
+		float cullingTime; // CPU frustum and occlusion culling, part of meshDrawTime
 		float assetLoadTime;
+
+		// loadGltf stages, accumulated over every loaded file (ms)
+		float assetParseTime{ 0.f };
+		float textureLoadTime{ 0.f };
+		float meshLoadTime{ 0.f }; // runs in parallel with the textures
+		float sceneBuildTime{ 0.f };
+		size_t peakLoadMemory{ 0 }; // peak resident memory of the process once the last load finished (bytes)
+		size_t vertexMemory{ 0 }; // vertex bytes uploaded by the loads
+		size_t indexMemory{ 0 }; // index bytes uploaded by the loads
+		size_t fullVertexMemory{ 0 }; // the same meshes with Vertex and 32 bit indices
 	};
 
 	class RenderDevice
@@ -115,10 +214,15 @@ namespace Moon
 		void immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function);
 
 		AllocatedBuffer createBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
-		AllocatedImage createImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage);
-		AllocatedImage createImage(void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage);
-
-		GPUMeshBuffers uploadMesh(std::span<uint32_t> indices, std::span<Vertex> vertices);
+		AllocatedImage createImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, uint32_t mipLevels = 1, uint32_t arrayLayers = 1, bool cubemap = false);
+		// data holds mipLevels tightly packed levels, level 0 first, in RGBA8 or a BCn format
+		AllocatedImage createImage(const void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage, uint32_t mipLevels = 1);
+		// every level and layer of the texture is uploaded with a single copy
+		AllocatedImage createImage(const Ktx2Texture& texture, VkImageUsageFlags usage);
+
+		// indices are 16 or 32 bit per indexType, vertices are Vertex or CompactVertex per vertexFormat
+		GPUMeshBuffers uploadMesh(std::span<const uint8_t> indices, VkIndexType indexType, std::span<const uint8_t> vertices, VertexFormat vertexFormat,
+			std::span<const Meshlet> meshlets = {});
 		void destroyBuffer(const AllocatedBuffer& buffer);
 		void destroyImage(const AllocatedImage& image);
 
@@ -130,7 +234,18 @@ namespace Moon
 		AllocatedImage getDepthImage() { return m_depthImage; }
 
 		DeletionQueue& getDeletionQueue() { return m_mainDeletionQueue; }
-
+		// flushed once every frame submitted so far has completed, for resources the frames in flight may still read
+		DeletionQueue& getFrameDeletionQueue() { return m_frames[(m_frameNumber + FRAME_OVERLAP - 1) % FRAME_OVERLAP].deletionQueue; }
+		RenderObjectRegistry& getRenderRegistry() { return m_renderRegistry; }
+		JobSystem& getJobSystem() { return m_jobSystem; }
+		BindlessResources& getBindlessResources() { return m_bindless; }
+		SamplerCache& getSamplerCache() { return m_samplerCache; }
+		AssetRegistry& getAssetRegistry() { return m_assetRegistry; }
+		UploadManager& getUploadManager() { return m_uploads; }
+		EngineStats& getStats() { return m_stats; }
+
+		// names are only resolved here, the scenes are then updated by id
+		uint32_t addScene(const std::string& name, std::shared_ptr<LoadedGLTF> scene);
 		void updateScene();
 
 	public:
@@ -142,8 +257,30 @@ namespace Moon
 		VkSampler m_defaultSamplerLinear;
 		VkSampler m_defaultSamplerNearest;
 
+		// Default bindless slots
+		uint32_t m_whiteTextureIndex;
+		uint32_t m_errorTextureIndex;
+		uint32_t m_defaultSamplerLinearIndex;
+		uint32_t m_defaultSamplerNearestIndex;
+		uint32_t m_defaultMaterialIndex; // used by the materials that did not fit the material buffer
+
 		GLTFMetallic_Roughness m_metalRoughMaterial;
 
+		// meshes loaded afterwards use CompactVertex when their surfaces allow it
+		bool m_compactVertices{ false };
+		ImportSettings m_importSettings;
+		// opaque objects are culled by drawCull.comp, the CPU records one draw per batch whatever the object count
+		bool m_useGpuCulling{ false };
+		// the GPU culling also tests the objects against a depth pyramid, in two phases
+		bool m_useOcclusionCulling{ true };
+		// the CPU path tests the objects against the occluders flagged at load, see ImportSettings::buildOccluders
+		bool m_useSoftwareOcclusion{ true };
+		// the CPU culling results are kept between frames, see TemporalCuller
+		bool m_useTemporalCulling{ true };
+		// the CPU path culls the draw lists through the registry hierarchies instead of testing every object.
+		// With temporal culling too, the hierarchies only cull the frames the temporal results cannot be reused.
+		bool m_useBvhCulling{ true };
+
 	private:
 		void initVulkan();
 		void initSwapchain();
@@ -151,11 +288,27 @@ namespace Moon
 		void initSyncStructures();
 		void initDescriptors();
 		void initPipelines();
+		void initClusterCulling();
+		void initDrawCulling();
+		void initDepthPyramid();
 		void initRayTracing();
 		void initImgui();
 		void initDefaultData();
 
 		FrameData& getCurrentFrame();
+		void cullObjects(const Frustum& frustum, const LodSelection& lodSelection, bool gpuCulling);
+		// casts the ray under the window pixel through the scene, the hit is shown in the stats window
+		void pickObject(int x, int y);
+		void reserveFrameDraws(FrameData& frame, uint32_t drawCount);
+		void reserveClusterBuffers(FrameData& frame, uint32_t jobCount, uint32_t indexCount);
+		void reserveDrawCullBuffers(FrameData& frame, uint32_t objectCount, uint32_t batchCount);
+		void updateDrawBatches();
+		void writeCullObjects(FrameData& frame);
+		void resetVisibility(VkCommandBuffer cmd, uint32_t objectCount);
+		void cullDraws(VkCommandBuffer cmd, FrameData& frame, DrawCullPhase phase, uint32_t objectCount, const LodSelection& lodSelection,
+			uint32_t sceneDataOffset, VkDescriptorSet pyramidSet);
+		void buildDepthPyramid(VkCommandBuffer cmd, FrameData& frame);
+		VkDeviceAddress getBufferAddress(VkBuffer buffer);
 		size_t padUniformBufferSize(size_t originalSize);
 
 	private:
@@ -173,6 +326,9 @@ namespace Moon
 		VkSurfaceKHR m_surface;
 		VkQueue m_graphicsQueue;
 		uint32_t m_graphicsQueueFamily;
+		VkQueue m_transferQueue;
+		uint32_t m_transferQueueFamily;
+		std::mutex m_queueMutex; // guards m_graphicsQueue, the upload manager may submit to it from loading threads
 		VmaAllocator m_allocator;
 		FrameData m_frames[FRAME_OVERLAP];
 		DeletionQueue m_mainDeletionQueue;
@@ -188,6 +344,10 @@ namespace Moon
 		VkDescriptorSetLayout m_globalSetLayout;
 		VkDescriptorSetLayout m_objectSetLayout;
 
+		// Asynchronous uploads, the frame submit waits on the upload timeline up to m_uploadWaitValue
+		UploadManager m_uploads;
+		uint64_t m_uploadWaitValue{ 0 };
+
 		// Immediate Submit structures
 		VkFence m_immFence;
 		VkCommandBuffer m_immCommandBuffer;
@@ -204,12 +364,58 @@ namespace Moon
 		// For GLTF mesh rendering
 		VkDescriptorSetLayout m_gpuSceneDataDescriptorLayout;
 		MaterialInstance m_defaultData;
-		DrawContext m_mainDrawContext;
+		BindlessResources m_bindless;
+		SamplerCache m_samplerCache;
+		AssetRegistry m_assetRegistry;
+		RenderObjectRegistry m_renderRegistry;
+		RenderQueue m_opaqueQueue;
+		RenderQueue m_transparentQueue;
+		SoftwareOcclusionCuller m_occlusionCuller;
+		TemporalCuller m_opaqueCuller;
+		TemporalCuller m_transparentCuller;
+		// visible draws of the CPU path, reused as they are while the view, the objects and the culling options stay the same
+		std::vector<uint32_t> m_opaqueDraws;
+		std::vector<uint32_t> m_transparentDraws;
+		glm::mat4 m_cullingViewProj{ 0.f };
+		uint64_t m_cullingVersion{ ~0ull };
+		uint32_t m_cullingOptions{ 0 };
+		RaycastHit m_pickHit{};
+		bool m_pickValid{ false };
+		std::atomic<uint32_t> m_nextMeshBufferId{ 0 }; // meshes are uploaded from loading tasks
+		bool m_useIndirectDraw{ true };
+		bool m_useLods{ true };
+		bool m_useClusterCulling{ true };
+		VkPipeline m_clusterCullPipeline;
+		VkPipelineLayout m_clusterCullLayout;
+		VkPipeline m_drawCullPipeline;
+		VkPipelineLayout m_drawCullLayout;
+		std::vector<DrawBatch> m_drawBatches; // grouped by pipeline
+		std::vector<uint32_t> m_drawBatchOf; // opaque dense index -> m_drawBatches index
+		uint64_t m_drawBatchLayoutVersion{ ~0ull }; // registry layout and material versions the batches were built from
+		uint64_t m_drawBatchMaterialVersion{ ~0ull };
+
+		// Occlusion culling, the visibility of every opaque object carries over to the next frame
+		AllocatedBuffer m_visibilityBuffer;
+		uint32_t m_visibilityCapacity{ 0 };
+		uint64_t m_visibilityVersion{ ~0ull }; // registry version the dense indices of the visibility match
+		AllocatedImage m_depthPyramid; // R32 min reduction of the depth, level 0 at half resolution
+		std::vector<VkImageView> m_depthPyramidMips;
+		VkExtent2D m_depthPyramidExtent;
+		VkDescriptorSetLayout m_depthReduceSetLayout;
+		VkDescriptorSetLayout m_depthPyramidSetLayout; // set 1 of drawCull.comp
+		VkPipeline m_depthReducePipeline;
+		VkPipelineLayout m_depthReduceLayout;
+		float m_lodPixelError{ 1.f };
 		GPUSceneData m_sceneData;
-		std::unordered_map<std::string, std::shared_ptr<LoadedGLTF>> m_loadedScenes;
+		AllocatedBuffer m_sceneDataBuffer;
+		size_t m_sceneDataStride;
+		std::vector<std::shared_ptr<LoadedGLTF>> m_loadedScenes; // indexed by the ids of m_sceneIds
+		std::unordered_map<std::string, uint32_t> m_sceneIds;
 
 		Camera m_mainCamera;
 
 		EngineStats m_stats;
+
+		JobSystem m_jobSystem;
 	};
 }
@@ -0,0 +1,114 @@
+#include "RenderQueue.h"
+#include "Culling.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace Moon
+{
+	// positive floats keep their ordering when their bits are compared as integers,
+	// keeping the high bits gives a logarithmic-like quantization of the view depth
+	static uint32_t depthBits(float viewDepth)
+	{
+		return std::bit_cast<uint32_t>(std::max(viewDepth, 0.f));
+	}
+
+	void RenderQueue::build(std::span<const RenderObject> objects, const CullingBounds& worldBounds, std::span<const uint32_t> visibleIndices,
+		const glm::mat4& view, SortMode mode)
+	{
+		m_keys.resize(visibleIndices.size());
+		m_indices.assign(visibleIndices.begin(), visibleIndices.end());
+
+		// view space depth of the bounds center, the camera looks down -z
+		const glm::vec4 depthRow = -glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]);
+
+		for (size_t i = 0; i < m_indices.size(); i++)
+		{
+			uint32_t index = m_indices[i];
+			const RenderObject& obj = objects[index];
+
+			float viewDepth = depthRow.x * worldBounds.centerX[index] + depthRow.y * worldBounds.centerY[index] + depthRow.z * worldBounds.centerZ[index] + depthRow.w;
+			uint64_t pipeline = obj.material->pipeline->id & 0x3F;
+			uint64_t material = obj.material->materialId & 0xFFFF;
+			uint64_t depth = depthBits(viewDepth);
+
+			if (mode == SortMode::StateFrontToBack)
+			{
+				uint64_t mesh = obj.meshBufferId & 0x3FFFF;
+				m_keys[i] = (pipeline << 58) | (material << 42) | (mesh << 24) | (depth >> 7);
+			}
+			else
+			{
+				uint64_t mesh = obj.meshBufferId & 0x3FF;
+				m_keys[i] = ((~depth & 0xFFFFFFFF) << 32) | (pipeline << 26) | (material << 10) | mesh;
+			}
+		}
+
+		radixSort(m_keys, m_indices, m_keyScratch, m_indexScratch);
+	}
+
+	void radixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, std::vector<uint64_t>& keyScratch, std::vector<uint32_t>& valueScratch)
+	{
+		const size_t count = keys.size();
+		if (count <= 1)
+		{
+			return;
+		}
+
+		keyScratch.resize(count);
+		valueScratch.resize(count);
+
+		// histogram every byte in a single read of the keys
+		std::array<std::array<uint32_t, 256>, 8> histograms{};
+		for (uint64_t key : keys)
+		{
+			for (int pass = 0; pass < 8; pass++)
+			{
+				histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+			}
+		}
+
+		uint64_t* srcKeys = keys.data();
+		uint32_t* srcValues = values.data();
+		uint64_t* dstKeys = keyScratch.data();
+		uint32_t* dstValues = valueScratch.data();
+
+		for (int pass = 0; pass < 8; pass++)
+		{
+			std::array<uint32_t, 256>& histogram = histograms[pass];
+
+			// every key has the same byte, this pass would not move anything
+			const uint32_t firstByte = (srcKeys[0] >> (pass * 8)) & 0xFF;
+			if (histogram[firstByte] == count)
+			{
+				continue;
+			}
+
+			uint32_t offset = 0;
+			for (uint32_t& bucket : histogram)
+			{
+				uint32_t bucketCount = bucket;
+				bucket = offset;
+				offset += bucketCount;
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				uint32_t destination = histogram[(srcKeys[i] >> (pass * 8)) & 0xFF]++;
+				dstKeys[destination] = srcKeys[i];
+				dstValues[destination] = srcValues[i];
+			}
+
+			std::swap(srcKeys, dstKeys);
+			std::swap(srcValues, dstValues);
+		}
+
+		// an odd number of passes leaves the result in the scratch buffers
+		if (srcKeys != keys.data())
+		{
+			keys.swap(keyScratch);
+			values.swap(valueScratch);
+		}
+	}
+}
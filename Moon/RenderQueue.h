@@ -0,0 +1,36 @@
+#pragma once
+#include "Mesh.h"
+
+#include <span>
+
+namespace Moon
+{
+	struct CullingBounds;
+
+	// Builds packed 64 bit sort keys for a list of visible render objects and sorts them with an LSD radix sort.
+	//  Opaque:      | pipeline 6 | material 16 | mesh buffer 18 | depth 24 |  state buckets, front to back inside a bucket
+	//  Transparent: | inverted depth 32 | pipeline 6 | material 16 | mesh buffer 10 |  strictly back to front
+	class RenderQueue
+	{
+	public:
+		enum class SortMode : uint8_t
+		{
+			StateFrontToBack,
+			BackToFront
+		};
+
+		void build(std::span<const RenderObject> objects, const CullingBounds& worldBounds, std::span<const uint32_t> visibleIndices,
+			const glm::mat4& view, SortMode mode);
+
+		std::span<const uint32_t> getSortedIndices() const { return m_indices; }
+
+	private:
+		std::vector<uint64_t> m_keys;
+		std::vector<uint32_t> m_indices;
+		std::vector<uint64_t> m_keyScratch;
+		std::vector<uint32_t> m_indexScratch;
+	};
+
+	// Sorts keys in ascending order and applies the same permutation to values. The scratch vectors are resized as needed.
+	void radixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, std::vector<uint64_t>& keyScratch, std::vector<uint32_t>& valueScratch);
+}
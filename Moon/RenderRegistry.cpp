@@ -0,0 +1,301 @@
+#include "RenderRegistry.h"
+
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+#include <cassert>
+
+namespace Moon
+{
+	// share of the error budget a coarser level must fit before the selection switches to it
+	constexpr float LodHysteresis = 0.75f;
+	// objects per leaf of the draw list hierarchies
+	constexpr uint32_t ObjectBvhLeafSize = 4;
+
+	RenderObjectHandle RenderObjectRegistry::create(const RenderObject& object)
+	{
+		uint32_t slot;
+		if (!m_freeSlots.empty())
+		{
+			slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else
+		{
+			slot = static_cast<uint32_t>(m_slots.size());
+			m_slots.emplace_back();
+		}
+
+		bool transparent = object.material->passType == MaterialPass::Transparent;
+		m_slots[slot].transparent = transparent;
+		m_slots[slot].denseIndex = insertDense(slot, object, transparent);
+		m_version++;
+		m_layoutVersion++;
+		getChangeVersions(transparent)[m_slots[slot].denseIndex] = m_version;
+
+		return RenderObjectHandle{ slot, m_slots[slot].generation };
+	}
+
+	void RenderObjectRegistry::destroy(RenderObjectHandle handle)
+	{
+		if (!isAlive(handle))
+		{
+			return;
+		}
+
+		removeDense(handle.index);
+		m_slots[handle.index].generation++;
+		m_slots[handle.index].denseIndex = ~0u;
+		m_freeSlots.push_back(handle.index);
+		m_version++;
+		m_layoutVersion++;
+	}
+
+	void RenderObjectRegistry::clear()
+	{
+		m_surfaces.OpaqueSurfaces.clear();
+		m_surfaces.TransparentSurfaces.clear();
+		m_opaqueBounds.clear();
+		m_transparentBounds.clear();
+		m_opaqueSlots.clear();
+		m_transparentSlots.clear();
+		m_opaqueChanges.clear();
+		m_transparentChanges.clear();
+		m_slots.clear();
+		m_freeSlots.clear();
+		m_version++;
+		m_layoutVersion++;
+	}
+
+	bool RenderObjectRegistry::isAlive(RenderObjectHandle handle) const
+	{
+		return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation && m_slots[handle.index].denseIndex != ~0u;
+	}
+
+	const RenderObject& RenderObjectRegistry::get(RenderObjectHandle handle) const
+	{
+		assert(isAlive(handle));
+		const Slot& slot = m_slots[handle.index];
+		return slot.transparent ? m_surfaces.TransparentSurfaces[slot.denseIndex] : m_surfaces.OpaqueSurfaces[slot.denseIndex];
+	}
+
+	void RenderObjectRegistry::updateTransform(RenderObjectHandle handle, const glm::mat4& transform)
+	{
+		assert(isAlive(handle));
+		const Slot& slot = m_slots[handle.index];
+		RenderObject& object = getSurfaces(slot.transparent)[slot.denseIndex];
+		object.transform = transform;
+		getBounds(slot.transparent).set(slot.denseIndex, object.bounds, transform);
+		m_version++;
+		getChangeVersions(slot.transparent)[slot.denseIndex] = m_version;
+	}
+
+	void RenderObjectRegistry::updateMaterial(RenderObjectHandle handle, MaterialInstance* material)
+	{
+		assert(isAlive(handle));
+		Slot& slot = m_slots[handle.index];
+		m_version++;
+
+		bool transparent = material->passType == MaterialPass::Transparent;
+		if (transparent == slot.transparent)
+		{
+			getSurfaces(slot.transparent)[slot.denseIndex].material = material;
+			getChangeVersions(slot.transparent)[slot.denseIndex] = m_version;
+			m_materialVersion++;
+			return;
+		}
+
+		// the object changes draw list
+		RenderObject object = getSurfaces(slot.transparent)[slot.denseIndex];
+		object.material = material;
+
+		removeDense(handle.index);
+		slot.transparent = transparent;
+		slot.denseIndex = insertDense(handle.index, object, transparent);
+		getChangeVersions(transparent)[slot.denseIndex] = m_version;
+		m_layoutVersion++;
+	}
+
+	void RenderObjectRegistry::selectLods(bool transparent, std::span<const uint32_t> denseIndices, const LodSelection& selection)
+	{
+		std::vector<RenderObject>& surfaces = getSurfaces(transparent);
+		const CullingBounds& bounds = getBounds(transparent);
+		for (uint32_t i : denseIndices)
+		{
+			RenderObject& object = surfaces[i];
+			glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+
+			// errors are in object space, the world bounds give the scale; objects around the camera keep their full detail
+			float distance = glm::length(center - selection.cameraPosition) - bounds.radius[i];
+			float scale = object.bounds.sphereRadius > 0.f ? bounds.radius[i] / object.bounds.sphereRadius : 1.f;
+
+			uint32_t lod = 0;
+			if (distance > 0.f)
+			{
+				float pixelsPerUnit = scale / distance * selection.projectionScale;
+				for (uint32_t level = object.lodCount - 1; level > 0; level--)
+				{
+					float budget = level > object.lod ? selection.maxPixelError * LodHysteresis : selection.maxPixelError;
+					if (object.lods[level].error * pixelsPerUnit <= budget)
+					{
+						lod = level;
+						break;
+					}
+				}
+			}
+
+			object.lod = lod;
+			object.firstIndex = object.lods[lod].startIndex;
+			object.indexCount = object.lods[lod].count;
+		}
+	}
+
+	uint32_t RenderObjectRegistry::insertDense(uint32_t slot, const RenderObject& object, bool transparent)
+	{
+		std::vector<RenderObject>& surfaces = getSurfaces(transparent);
+		std::vector<uint32_t>& denseSlots = getDenseSlots(transparent);
+
+		surfaces.push_back(object);
+		denseSlots.push_back(slot);
+		getChangeVersions(transparent).push_back(m_version);
+		getBounds(transparent).pushBack(object.bounds, object.transform);
+		return static_cast<uint32_t>(surfaces.size() - 1);
+	}
+
+	void RenderObjectRegistry::removeDense(uint32_t slot)
+	{
+		const Slot& removed = m_slots[slot];
+		std::vector<RenderObject>& surfaces = getSurfaces(removed.transparent);
+		std::vector<uint32_t>& denseSlots = getDenseSlots(removed.transparent);
+		std::vector<uint64_t>& changes = getChangeVersions(removed.transparent);
+
+		// swap with the last object to keep the list packed
+		uint32_t last = static_cast<uint32_t>(surfaces.size() - 1);
+		if (removed.denseIndex != last)
+		{
+			surfaces[removed.denseIndex] = surfaces[last];
+			denseSlots[removed.denseIndex] = denseSlots[last];
+			changes[removed.denseIndex] = changes[last];
+			m_slots[denseSlots[removed.denseIndex]].denseIndex = removed.denseIndex;
+		}
+		getBounds(removed.transparent).swapRemove(removed.denseIndex);
+		surfaces.pop_back();
+		denseSlots.pop_back();
+		changes.pop_back();
+	}
+
+	void RenderObjectRegistry::updateBvhs(JobSystem* jobSystem)
+	{
+		if (m_bvhVersion == m_version)
+		{
+			return;
+		}
+
+		const bool rebuild = m_bvhLayoutVersion != m_layoutVersion;
+		for (bool transparent : { false, true })
+		{
+			const CullingBounds& bounds = getBounds(transparent);
+			m_boxMin.resize(bounds.size());
+			m_boxMax.resize(bounds.size());
+			for (size_t i = 0; i < bounds.size(); i++)
+			{
+				glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+				glm::vec3 extents(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+				m_boxMin[i] = center - extents;
+				m_boxMax[i] = center + extents;
+			}
+
+			Bvh& bvh = transparent ? m_transparentBvh : m_opaqueBvh;
+			if (rebuild)
+			{
+				bvh.build(m_boxMin, m_boxMax, ObjectBvhLeafSize, jobSystem);
+			}
+			else
+			{
+				bvh.refit(m_boxMin, m_boxMax);
+			}
+		}
+		m_bvhVersion = m_version;
+		m_bvhLayoutVersion = m_layoutVersion;
+	}
+
+	float RenderObjectRegistry::intersectObject(bool transparent, uint32_t denseIndex, const glm::vec3& origin, const glm::vec3& direction,
+		float maxDistance, bool anyHit, uint32_t& triangle) const
+	{
+		triangle = ~0u;
+		const RenderObject& object = (transparent ? m_surfaces.TransparentSurfaces : m_surfaces.OpaqueSurfaces)[denseIndex];
+		if (object.triangles == nullptr)
+		{
+			const CullingBounds& bounds = transparent ? m_transparentBounds : m_opaqueBounds;
+			glm::vec3 center(bounds.centerX[denseIndex], bounds.centerY[denseIndex], bounds.centerZ[denseIndex]);
+			glm::vec3 extents(bounds.extentX[denseIndex], bounds.extentY[denseIndex], bounds.extentZ[denseIndex]);
+			return intersectRayBox(center - extents, center + extents, origin, 1.f / direction);
+		}
+
+		// the ray goes to object space unnormalized, its distances stay the same
+		glm::mat4 inverse = glm::inverse(object.transform);
+		glm::vec3 localOrigin = glm::vec3(inverse * glm::vec4(origin, 1.f));
+		glm::vec3 localDirection = glm::mat3(inverse) * direction;
+		if (anyHit)
+		{
+			return object.triangles->intersectsRay(localOrigin, localDirection, maxDistance) ? 0.f : std::numeric_limits<float>::infinity();
+		}
+
+		TriangleHit hit;
+		if (!object.triangles->intersectRay(localOrigin, localDirection, maxDistance, hit))
+		{
+			return std::numeric_limits<float>::infinity();
+		}
+		triangle = hit.triangle;
+		return hit.distance;
+	}
+
+	bool RenderObjectRegistry::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RaycastHit& hit) const
+	{
+		assert(m_bvhVersion == m_version);
+		float closest = maxDistance;
+		for (bool transparent : { false, true })
+		{
+			const Bvh& bvh = transparent ? m_transparentBvh : m_opaqueBvh;
+			closest = bvh.intersectRay(origin, direction, closest, false, [&](uint32_t denseIndex, float itemDistance)
+				{
+					uint32_t triangle;
+					float distance = intersectObject(transparent, denseIndex, origin, direction, itemDistance, false, triangle);
+					if (distance < itemDistance)
+					{
+						uint32_t slot = (transparent ? m_transparentSlots : m_opaqueSlots)[denseIndex];
+						hit.object = RenderObjectHandle{ slot, m_slots[slot].generation };
+						hit.triangle = triangle;
+					}
+					return distance;
+				});
+		}
+
+		if (closest >= maxDistance)
+		{
+			return false;
+		}
+		hit.distance = closest;
+		hit.position = origin + direction * closest;
+		return true;
+	}
+
+	bool RenderObjectRegistry::intersectsRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+	{
+		assert(m_bvhVersion == m_version);
+		for (bool transparent : { false, true })
+		{
+			const Bvh& bvh = transparent ? m_transparentBvh : m_opaqueBvh;
+			float distance = bvh.intersectRay(origin, direction, maxDistance, true, [&](uint32_t denseIndex, float itemDistance)
+				{
+					uint32_t triangle;
+					return intersectObject(transparent, denseIndex, origin, direction, itemDistance, true, triangle);
+				});
+			if (distance < maxDistance)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
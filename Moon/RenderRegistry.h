@@ -0,0 +1,112 @@
+#pragma once
+#include "Mesh.h"
+#include "Culling.h"
+#include "Bvh.h"
+
+namespace Moon
+{
+	// Screen space error budget the levels of detail are picked with
+	struct LodSelection
+	{
+		glm::vec3 cameraPosition;
+		float projectionScale; // viewport height / 2 * proj[1][1], turns an error / distance ratio into pixels
+		float maxPixelError; // the coarsest level projecting under this many pixels is drawn
+	};
+
+	struct RaycastHit
+	{
+		RenderObjectHandle object;
+		float distance; // in units of the ray direction
+		uint32_t triangle; // in the index range of the surface, ~0u when the object was hit on its box
+		glm::vec3 position;
+	};
+
+	// Persistent storage for render objects. Objects are created once when a scene is loaded and only
+	// touched again when their transform or material changes, the draw lists are kept densely packed
+	// so the renderer can consume them directly every frame.
+	class RenderObjectRegistry
+	{
+	public:
+		RenderObjectHandle create(const RenderObject& object);
+		void destroy(RenderObjectHandle handle);
+		void clear();
+
+		bool isAlive(RenderObjectHandle handle) const;
+		const RenderObject& get(RenderObjectHandle handle) const;
+
+		void updateTransform(RenderObjectHandle handle, const glm::mat4& transform);
+		void updateMaterial(RenderObjectHandle handle, MaterialInstance* material);
+
+		// picks the level of detail of the listed objects from the error their levels project on screen,
+		// a coarser level than the current one must fit a smaller budget so objects do not flicker between two levels
+		void selectLods(bool transparent, std::span<const uint32_t> denseIndices, const LodSelection& selection);
+
+		const DrawContext& getDrawContext() const { return m_surfaces; }
+		// world space bounds, parallel to the opaque and transparent surface lists
+		const CullingBounds& getOpaqueBounds() const { return m_opaqueBounds; }
+		const CullingBounds& getTransparentBounds() const { return m_transparentBounds; }
+		size_t size() const { return m_surfaces.OpaqueSurfaces.size() + m_surfaces.TransparentSurfaces.size(); }
+		// bumped by every change except the level of detail selection, copies of the objects are stale once it moves
+		uint64_t getVersion() const { return m_version; }
+		// only bumped when objects are added, removed or change draw list, data indexed by dense index stays valid until then
+		uint64_t getLayoutVersion() const { return m_layoutVersion; }
+		// bumped when an object gets another material of the same draw list, anything grouped by material is stale
+		uint64_t getMaterialVersion() const { return m_materialVersion; }
+		// version of the last change of each opaque object, parallel to the surface list. Copies made at version v
+		// only need the objects above v rewritten while the layout version stays the same.
+		std::span<const uint64_t> getOpaqueChangeVersions() const { return m_opaqueChanges; }
+
+		// Rebuilds the hierarchies over the world bounds of the draw lists once objects were added or removed,
+		// refits them when only transforms changed
+		void updateBvhs(JobSystem* jobSystem = nullptr);
+		// leaves hold dense indices, up to date after updateBvhs
+		const Bvh& getOpaqueBvh() const { return m_opaqueBvh; }
+		const Bvh& getTransparentBvh() const { return m_transparentBvh; }
+
+		// Nearest object of both draw lists along origin + distance * direction. Objects are hit on their triangles
+		// when they were built at load, otherwise on their world box. The hierarchies must be up to date.
+		bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RaycastHit& hit) const;
+		// whether anything is hit before maxDistance, for line of sight tests
+		bool intersectsRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+	private:
+		struct Slot
+		{
+			uint32_t generation{ 0 };
+			uint32_t denseIndex{ ~0u };
+			bool transparent{ false };
+		};
+
+		std::vector<RenderObject>& getSurfaces(bool transparent) { return transparent ? m_surfaces.TransparentSurfaces : m_surfaces.OpaqueSurfaces; }
+		std::vector<uint32_t>& getDenseSlots(bool transparent) { return transparent ? m_transparentSlots : m_opaqueSlots; }
+		CullingBounds& getBounds(bool transparent) { return transparent ? m_transparentBounds : m_opaqueBounds; }
+		std::vector<uint64_t>& getChangeVersions(bool transparent) { return transparent ? m_transparentChanges : m_opaqueChanges; }
+
+		uint32_t insertDense(uint32_t slot, const RenderObject& object, bool transparent);
+		void removeDense(uint32_t slot);
+		// distance of the hit or infinity, triangle is ~0u for a box hit
+		float intersectObject(bool transparent, uint32_t denseIndex, const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+			bool anyHit, uint32_t& triangle) const;
+
+		DrawContext m_surfaces;
+		CullingBounds m_opaqueBounds;
+		CullingBounds m_transparentBounds;
+		std::vector<uint32_t> m_opaqueSlots;		// dense index -> slot
+		std::vector<uint32_t> m_transparentSlots;	// dense index -> slot
+		std::vector<uint64_t> m_opaqueChanges;		// dense index -> version of its last change
+		std::vector<uint64_t> m_transparentChanges;
+
+		std::vector<Slot> m_slots;
+		std::vector<uint32_t> m_freeSlots;
+		uint64_t m_version{ 0 };
+		uint64_t m_layoutVersion{ 0 };
+		uint64_t m_materialVersion{ 0 };
+
+		Bvh m_opaqueBvh;
+		Bvh m_transparentBvh;
+		uint64_t m_bvhVersion{ ~0ull };
+		uint64_t m_bvhLayoutVersion{ ~0ull };
+		std::vector<glm::vec3> m_boxMin; // scratch for the hierarchy updates
+		std::vector<glm::vec3> m_boxMax;
+	};
+}
@@ -15,6 +15,8 @@
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
 
+#include "SceneHierarchy.h"
+
 using namespace std;
 #define VK_CHECK(x)                                                    \
 	do                                                                 \
@@ -42,6 +44,7 @@ namespace Moon
         VkImageView imageView;
         VkExtent3D imageExtent;
         VkFormat imageFormat;
+        uint32_t mipLevels{ 1 };
         VmaAllocation allocation;
         std::string name;
     };
@@ -66,13 +69,23 @@ namespace Moon
 	{
 		VkPipeline pipeline;
 		VkPipelineLayout layout;
+		uint32_t id; // small sort id
 	};
 
 	struct MaterialInstance
 	{
 		MaterialPipeline* pipeline;
-		VkDescriptorSet materialSet;
 		MaterialPass passType;
+		uint32_t materialId; // slot in the bindless material buffer
+		bool doubleSided{ false };
+	};
+
+	struct RenderObjectHandle
+	{
+		uint32_t index{ ~0u };
+		uint32_t generation{ 0 };
+
+		bool isValid() const { return index != ~0u; }
 	};
 
 	struct DrawContext;
@@ -82,22 +95,18 @@ namespace Moon
 		virtual void Draw(const glm::mat4& topMatrix, DrawContext& ctx) = 0;
 	};
 
+	// Thin view over a node stored in a SceneHierarchy, transforms live in the hierarchy arrays
 	struct Node : public IRenderable
 	{
 		std::weak_ptr<Node> parent;
 		std::vector<std::shared_ptr<Node>> children;
 
-		glm::mat4 localTransform;
-		glm::mat4 worldTransform;
+		SceneHierarchy* hierarchy{ nullptr };
+		uint32_t hierarchyIndex{ SceneHierarchy::InvalidIndex };
 
-		void refreshTransform(const glm::mat4& parentMatrix)
-		{
-			worldTransform = parentMatrix * localTransform;
-			for (auto c : children)
-			{
-				c->refreshTransform(worldTransform);
-			}
-		}
+		const glm::mat4& getLocalTransform() const { return hierarchy->getLocalTransform(hierarchyIndex); }
+		const glm::mat4& getWorldTransform() const { return hierarchy->getWorldTransform(hierarchyIndex); }
+		void setLocalTransform(const glm::mat4& localTransform) { hierarchy->setLocalTransform(hierarchyIndex, localTransform); }
 
 		virtual void Draw(const glm::mat4& topMatrix, DrawContext& ctx)
 		{
@@ -0,0 +1,109 @@
+#include "SamplerCache.h"
+#include "AssetRegistry.h"
+#include "Bindless.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+
+namespace Moon
+{
+	size_t SamplerCache::KeyHash::operator()(const Key& key) const
+	{
+		return static_cast<size_t>(hashBytes({ reinterpret_cast<const uint8_t*>(key.data()), sizeof(Key) }));
+	}
+
+	void SamplerCache::init(VkDevice device, BindlessResources* bindless, float maxAnisotropy, const VkPhysicalDeviceLimits& limits)
+	{
+		m_device = device;
+		m_bindless = bindless;
+		m_maxAnisotropy = std::clamp(maxAnisotropy, 1.f, limits.maxSamplerAnisotropy);
+	}
+
+	void SamplerCache::cleanup()
+	{
+		for (auto& [key, entry] : m_samplers)
+		{
+			m_bindless->releaseSampler(entry.handle.index);
+			vkDestroySampler(m_device, entry.handle.sampler, nullptr);
+		}
+		m_samplers.clear();
+		m_keys.clear();
+	}
+
+	SamplerHandle SamplerCache::acquire(const VkSamplerCreateInfo& info)
+	{
+		assert(info.pNext == nullptr);
+
+		// fields the device ignores are normalized so they do not split the cache
+		VkSamplerCreateInfo createInfo = info;
+		if (createInfo.anisotropyEnable)
+		{
+			float level = std::min(createInfo.maxAnisotropy, m_maxAnisotropy);
+			createInfo.maxAnisotropy = level >= 2.f ? std::exp2(std::floor(std::log2(level))) : 1.f;
+			createInfo.anisotropyEnable = createInfo.maxAnisotropy > 1.f;
+		}
+		if (!createInfo.anisotropyEnable)
+		{
+			createInfo.maxAnisotropy = 1.f;
+		}
+		if (!createInfo.compareEnable)
+		{
+			createInfo.compareOp = VK_COMPARE_OP_NEVER;
+		}
+
+		Key key =
+		{
+			createInfo.flags,
+			static_cast<uint32_t>(createInfo.magFilter),
+			static_cast<uint32_t>(createInfo.minFilter),
+			static_cast<uint32_t>(createInfo.mipmapMode),
+			static_cast<uint32_t>(createInfo.addressModeU),
+			static_cast<uint32_t>(createInfo.addressModeV),
+			static_cast<uint32_t>(createInfo.addressModeW),
+			std::bit_cast<uint32_t>(createInfo.mipLodBias),
+			createInfo.anisotropyEnable,
+			std::bit_cast<uint32_t>(createInfo.maxAnisotropy),
+			createInfo.compareEnable,
+			static_cast<uint32_t>(createInfo.compareOp),
+			std::bit_cast<uint32_t>(createInfo.minLod),
+			std::bit_cast<uint32_t>(createInfo.maxLod),
+			static_cast<uint32_t>(createInfo.borderColor),
+			createInfo.unnormalizedCoordinates,
+		};
+
+		auto it = m_samplers.find(key);
+		if (it != m_samplers.end())
+		{
+			it->second.refCount++;
+			return it->second.handle;
+		}
+
+		SamplerHandle handle;
+		VK_CHECK(vkCreateSampler(m_device, &createInfo, nullptr, &handle.sampler));
+		handle.index = m_bindless->registerSampler(handle.sampler);
+
+		m_samplers.emplace(key, Entry{ handle, 1 });
+		m_keys.emplace(handle.sampler, key);
+		return handle;
+	}
+
+	void SamplerCache::release(SamplerHandle handle)
+	{
+		auto keyIt = m_keys.find(handle.sampler);
+		if (keyIt == m_keys.end())
+		{
+			return;
+		}
+
+		auto it = m_samplers.find(keyIt->second);
+		if (--it->second.refCount == 0)
+		{
+			m_bindless->releaseSampler(handle.index);
+			vkDestroySampler(m_device, handle.sampler, nullptr);
+			m_samplers.erase(it);
+			m_keys.erase(keyIt);
+		}
+	}
+}
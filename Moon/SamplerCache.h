@@ -0,0 +1,57 @@
+#pragma once
+#include "RenderTypes.h"
+
+#include <array>
+#include <unordered_map>
+
+namespace Moon
+{
+	//Forward declaration
+	class BindlessResources;
+
+	// Sampler shared through the cache, materials store the bindless index
+	struct SamplerHandle
+	{
+		VkSampler sampler{ VK_NULL_HANDLE };
+		uint32_t index{ ~0u };
+	};
+
+	// Device wide sampler cache. Identical create infos of every loaded scene share one VkSampler and one
+	// bindless slot, each acquire holds a reference and the sampler is destroyed with the last release.
+	class SamplerCache
+	{
+	public:
+		// maxAnisotropy is the level used by anisotropic samplers, clamped to the device limit
+		void init(VkDevice device, BindlessResources* bindless, float maxAnisotropy, const VkPhysicalDeviceLimits& limits);
+		void cleanup();
+
+		// pNext chains are not supported. Anisotropy is clamped to the cache level and rounded down to a power of two.
+		SamplerHandle acquire(const VkSamplerCreateInfo& info);
+		void release(SamplerHandle handle);
+
+		float getMaxAnisotropy() const { return m_maxAnisotropy; }
+		size_t getSamplerCount() const { return m_samplers.size(); }
+
+	private:
+		// every field of the create info that changes the sampler, floats stored as their bits
+		using Key = std::array<uint32_t, 16>;
+
+		struct KeyHash
+		{
+			size_t operator()(const Key& key) const;
+		};
+
+		struct Entry
+		{
+			SamplerHandle handle;
+			uint32_t refCount;
+		};
+
+		VkDevice m_device{ VK_NULL_HANDLE };
+		BindlessResources* m_bindless{ nullptr };
+		float m_maxAnisotropy{ 1.f };
+
+		std::unordered_map<Key, Entry, KeyHash> m_samplers;
+		std::unordered_map<VkSampler, Key> m_keys;
+	};
+}
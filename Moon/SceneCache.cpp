@@ -0,0 +1,562 @@
+#include "SceneCache.h"
+#include "MappedFile.h"
+#include "AssetRegistry.h"
+#include "Ktx2.h"
+#include "RenderDevice.h"
+
+#include <fastgltf/parser.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+namespace Moon
+{
+	static constexpr uint32_t SceneCacheMagic = 0x4E43534D; // "MSCN"
+	static constexpr uint64_t SectionAlignment = 16;
+
+	struct CacheString
+	{
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	struct CacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		uint64_t fileSize;
+		uint32_t vertexSize; // catches a Vertex layout change without a version bump
+		uint32_t imageCount;
+		uint32_t meshCount;
+		uint32_t surfaceCount;
+		uint32_t samplerCount;
+		uint32_t materialCount;
+		uint32_t nodeCount;
+		uint32_t childCount;
+		uint64_t imageOffset;
+		uint64_t meshOffset;
+		uint64_t surfaceOffset;
+		uint64_t samplerOffset;
+		uint64_t materialOffset;
+		uint64_t nodeOffset;
+		uint64_t childOffset;
+		uint64_t stringOffset;
+		uint64_t stringSize;
+	};
+
+	enum CacheImageFlags : uint32_t
+	{
+		CacheImageCubemap = 1,
+		CacheImageKtx2 = 2, // the pixels are a KTX2 container
+	};
+
+	struct CacheImage
+	{
+		CacheString name;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		uint32_t format;
+		uint32_t arrayLayers;
+		uint32_t flags;
+		uint64_t pixelOffset;
+		uint64_t pixelSize;
+	};
+
+	struct CacheMesh
+	{
+		CacheString name;
+		uint32_t firstSurface;
+		uint32_t surfaceCount;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t meshletOffset;
+		uint32_t meshletCount;
+		uint32_t padding;
+	};
+
+	struct CacheMaterial
+	{
+		CacheString name;
+		glm::vec4 baseColorFactors;
+		glm::vec4 metalRoughFactors;
+		uint32_t passType;
+		int32_t colorImage;
+		int32_t colorSampler;
+		uint32_t doubleSided;
+	};
+
+	struct CacheNode
+	{
+		CacheString name;
+		glm::mat4 localTransform;
+		int32_t meshIndex;
+		uint32_t firstChild;
+		uint32_t childCount;
+		uint32_t padding;
+	};
+
+	static_assert(std::is_trivially_copyable_v<ImportedSurface> && std::is_trivially_copyable_v<ImportedSampler>,
+		"surfaces and samplers are stored as is");
+
+	static uint64_t hashString(const std::string& string, uint64_t hash)
+	{
+		return hashBytes({ reinterpret_cast<const uint8_t*>(string.data()), string.size() }, hash);
+	}
+
+	static void hashReferencedFile(const std::filesystem::path& folder, const fastgltf::DataSource& source, uint64_t& hash)
+	{
+		const fastgltf::sources::URI* uri = std::get_if<fastgltf::sources::URI>(&source);
+		if (!uri || !uri->uri.isLocalPath())
+		{
+			return;
+		}
+
+		// a missing file still changes the hash through its path, the import then fails on it
+		hash = hashString(uri->uri.fspath().generic_string(), hash);
+		MappedFile file;
+		if (file.open(folder / uri->uri.fspath()))
+		{
+			hash = hashBytes(file.bytes(), hash);
+		}
+	}
+
+	uint64_t hashSceneSource(const std::filesystem::path& sourcePath, const ImportSettings& settings)
+	{
+		// the json parser reads past the end of its input, the mapping is padded for it
+		MappedFile source;
+		fastgltf::GltfDataBuffer data;
+		if (!source.open(sourcePath, fastgltf::getGltfBufferPadding()) || !data.fromByteView(source.mutableData(), source.size(), source.capacity()))
+		{
+			return 0;
+		}
+		uint64_t hash = hashBytes(source.bytes());
+
+		// only the buffers and images are parsed, the files they reference by path are hashed in declaration order
+		fastgltf::Parser parser{ fastgltf::Extensions::KHR_texture_basisu };
+		constexpr auto gltfOptions = fastgltf::Options::DontRequireValidAssetMember | fastgltf::Options::AllowDouble;
+		constexpr auto categories = fastgltf::Category::Buffers | fastgltf::Category::Images;
+		std::filesystem::path folder = sourcePath.parent_path();
+		auto type = fastgltf::determineGltfFileType(&data);
+		if (type == fastgltf::GltfType::Invalid)
+		{
+			return 0;
+		}
+		auto load = type == fastgltf::GltfType::GLB ? parser.loadBinaryGLTF(&data, folder, gltfOptions, categories) :
+			parser.loadGLTF(&data, folder, gltfOptions, categories);
+		if (load.error() != fastgltf::Error::None)
+		{
+			return 0;
+		}
+
+		for (const fastgltf::Buffer& buffer : load.get().buffers)
+		{
+			hashReferencedFile(folder, buffer.data, hash);
+		}
+		for (const fastgltf::Image& image : load.get().images)
+		{
+			hashReferencedFile(folder, image.data, hash);
+		}
+
+		uint8_t flags[] = { settings.optimizeMeshes, settings.generateLods, settings.buildMeshlets, settings.blockCompressedTextures };
+		return hashBytes({ flags, sizeof(flags) }, hash);
+	}
+
+	std::filesystem::path getSceneCachePath(const std::filesystem::path& sourcePath)
+	{
+		std::filesystem::path cachePath = sourcePath;
+		cachePath += ".mscene";
+		return cachePath;
+	}
+
+	// Sequential writer keeping track of the file offset
+	class CacheWriter
+	{
+	public:
+		explicit CacheWriter(const std::filesystem::path& path) : m_file(path, std::ios::binary | std::ios::trunc) {}
+
+		bool isOpen() const { return m_file.is_open(); }
+		bool good() const { return m_file.good(); }
+		uint64_t offset() const { return m_offset; }
+
+		uint64_t write(const void* data, size_t size)
+		{
+			uint64_t start = m_offset;
+			m_file.write(static_cast<const char*>(data), size);
+			m_offset += size;
+			return start;
+		}
+
+		template<typename T>
+		uint64_t writeArray(const std::vector<T>& values)
+		{
+			align();
+			return write(values.data(), values.size() * sizeof(T));
+		}
+
+		void align()
+		{
+			static const char zeros[SectionAlignment] = {};
+			uint64_t padding = (SectionAlignment - (m_offset % SectionAlignment)) % SectionAlignment;
+			write(zeros, padding);
+		}
+
+		void rewrite(uint64_t offset, const void* data, size_t size)
+		{
+			m_file.seekp(offset);
+			m_file.write(static_cast<const char*>(data), size);
+			m_file.seekp(m_offset);
+		}
+
+	private:
+		std::ofstream m_file;
+		uint64_t m_offset{ 0 };
+	};
+
+	bool writeSceneCache(const SceneImport& import, const std::filesystem::path& cachePath, uint64_t sourceHash)
+	{
+		// written next to the final file and renamed once complete, a crash never leaves a truncated cache
+		std::filesystem::path tempPath = cachePath;
+		tempPath += ".tmp";
+
+		bool success;
+		{
+			CacheWriter writer(tempPath);
+			if (!writer.isOpen())
+			{
+				return false;
+			}
+
+			std::vector<char> strings;
+			auto addString = [&](const std::string& string)
+				{
+					CacheString result{ static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(string.size()) };
+					strings.insert(strings.end(), string.begin(), string.end());
+					return result;
+				};
+
+			CacheHeader header{};
+			header.magic = SceneCacheMagic;
+			header.version = SceneCacheVersion;
+			header.sourceHash = sourceHash;
+			header.vertexSize = sizeof(Vertex);
+			writer.write(&header, sizeof(header));
+
+			// blobs first, the tables then reference their offsets
+			std::vector<CacheImage> images;
+			for (const ImportedImage& image : import.images)
+			{
+				CacheImage cached{};
+				cached.name = addString(image.name);
+				cached.width = image.extent.width;
+				cached.height = image.extent.height;
+				cached.mipLevels = image.mipLevels;
+				cached.format = static_cast<uint32_t>(image.format);
+				cached.arrayLayers = image.arrayLayers;
+				cached.flags = (image.cubemap ? CacheImageCubemap : 0) | (image.ktx2 ? CacheImageKtx2 : 0);
+				writer.align();
+				cached.pixelOffset = writer.write(image.pixels.data(), image.pixels.size());
+				cached.pixelSize = image.pixels.size();
+				images.push_back(cached);
+			}
+
+			std::vector<CacheMesh> meshes;
+			std::vector<ImportedSurface> surfaces;
+			for (const ImportedMesh& mesh : import.meshes)
+			{
+				CacheMesh cached{};
+				cached.name = addString(mesh.name);
+				cached.firstSurface = static_cast<uint32_t>(surfaces.size());
+				cached.surfaceCount = static_cast<uint32_t>(mesh.surfaces.size());
+				cached.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+				cached.indexCount = static_cast<uint32_t>(mesh.indices.size());
+				writer.align();
+				cached.vertexOffset = writer.write(mesh.vertices.data(), mesh.vertices.size_bytes());
+				writer.align();
+				cached.indexOffset = writer.write(mesh.indices.data(), mesh.indices.size_bytes());
+				writer.align();
+				cached.meshletOffset = writer.write(mesh.meshlets.data(), mesh.meshlets.size_bytes());
+				cached.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+				surfaces.insert(surfaces.end(), mesh.surfaces.begin(), mesh.surfaces.end());
+				meshes.push_back(cached);
+			}
+
+			std::vector<CacheMaterial> materials;
+			for (const ImportedMaterial& material : import.materials)
+			{
+				CacheMaterial cached{};
+				cached.name = addString(material.name);
+				cached.baseColorFactors = material.baseColorFactors;
+				cached.metalRoughFactors = material.metalRoughFactors;
+				cached.passType = static_cast<uint32_t>(material.passType);
+				cached.colorImage = material.colorImage;
+				cached.colorSampler = material.colorSampler;
+				cached.doubleSided = material.doubleSided;
+				materials.push_back(cached);
+			}
+
+			std::vector<CacheNode> nodes;
+			for (const ImportedNode& node : import.nodes)
+			{
+				CacheNode cached{};
+				cached.name = addString(node.name);
+				cached.localTransform = node.localTransform;
+				cached.meshIndex = node.meshIndex;
+				cached.firstChild = node.firstChild;
+				cached.childCount = node.childCount;
+				nodes.push_back(cached);
+			}
+
+			header.imageCount = static_cast<uint32_t>(images.size());
+			header.meshCount = static_cast<uint32_t>(meshes.size());
+			header.surfaceCount = static_cast<uint32_t>(surfaces.size());
+			header.samplerCount = static_cast<uint32_t>(import.samplers.size());
+			header.materialCount = static_cast<uint32_t>(materials.size());
+			header.nodeCount = static_cast<uint32_t>(nodes.size());
+			header.childCount = static_cast<uint32_t>(import.children.size());
+			header.imageOffset = writer.writeArray(images);
+			header.meshOffset = writer.writeArray(meshes);
+			header.surfaceOffset = writer.writeArray(surfaces);
+			header.samplerOffset = writer.writeArray(import.samplers);
+			header.materialOffset = writer.writeArray(materials);
+			header.nodeOffset = writer.writeArray(nodes);
+			header.childOffset = writer.writeArray(import.children);
+			header.stringOffset = writer.writeArray(strings);
+			header.stringSize = strings.size();
+			header.fileSize = writer.offset();
+			writer.rewrite(0, &header, sizeof(header));
+
+			success = writer.good();
+		}
+
+		std::error_code error;
+		if (success)
+		{
+			std::filesystem::rename(tempPath, cachePath, error);
+		}
+		if (!success || error)
+		{
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		return true;
+	}
+
+	std::optional<SceneImport> readSceneCache(const std::filesystem::path& cachePath, uint64_t sourceHash)
+	{
+		std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+		if (!file->open(cachePath) || file->size() < sizeof(CacheHeader))
+		{
+			return {};
+		}
+
+		const uint8_t* base = file->data();
+		const uint64_t fileSize = file->size();
+		const CacheHeader& header = *reinterpret_cast<const CacheHeader*>(base);
+		if (header.magic != SceneCacheMagic || header.version != SceneCacheVersion || header.vertexSize != sizeof(Vertex) ||
+			header.sourceHash != sourceHash || header.fileSize != fileSize)
+		{
+			return {};
+		}
+
+		auto inFile = [&](uint64_t offset, uint64_t size)
+			{
+				return offset <= fileSize && size <= fileSize - offset;
+			};
+		auto table = [&]<typename T>(uint64_t offset, uint32_t count, const T*& out)
+			{
+				out = reinterpret_cast<const T*>(base + offset);
+				return offset % alignof(T) == 0 && inFile(offset, uint64_t(count) * sizeof(T));
+			};
+
+		const CacheImage* images;
+		const CacheMesh* meshes;
+		const ImportedSurface* surfaces;
+		const ImportedSampler* samplers;
+		const CacheMaterial* materials;
+		const CacheNode* nodes;
+		const uint32_t* children;
+		const char* strings;
+		if (!table(header.imageOffset, header.imageCount, images) || !table(header.meshOffset, header.meshCount, meshes) ||
+			!table(header.surfaceOffset, header.surfaceCount, surfaces) || !table(header.samplerOffset, header.samplerCount, samplers) ||
+			!table(header.materialOffset, header.materialCount, materials) || !table(header.nodeOffset, header.nodeCount, nodes) ||
+			!table(header.childOffset, header.childCount, children) || !inFile(header.stringOffset, header.stringSize))
+		{
+			return {};
+		}
+		strings = reinterpret_cast<const char*>(base + header.stringOffset);
+
+		bool valid = true;
+		auto getString = [&](CacheString string) -> std::string
+			{
+				if (uint64_t(string.offset) + string.length > header.stringSize)
+				{
+					valid = false;
+					return {};
+				}
+				return std::string(strings + string.offset, string.length);
+			};
+
+		SceneImport import;
+		import.source = file;
+
+		for (uint32_t i = 0; i < header.imageCount; i++)
+		{
+			const CacheImage& cached = images[i];
+			ImportedImage& image = import.images.emplace_back();
+			image.name = getString(cached.name);
+			image.extent = VkExtent3D{ cached.width, cached.height, 1 };
+			image.mipLevels = cached.mipLevels;
+			image.format = static_cast<VkFormat>(cached.format);
+			image.arrayLayers = cached.arrayLayers;
+			image.cubemap = (cached.flags & CacheImageCubemap) != 0;
+			image.ktx2 = (cached.flags & CacheImageKtx2) != 0;
+			// images that failed to decode are stored without pixels, KTX2 containers are checked again when they are uploaded
+			valid &= cached.mipLevels <= getMipLevelCount(image.extent) && inFile(cached.pixelOffset, cached.pixelSize);
+			if (image.ktx2)
+			{
+				valid &= cached.pixelSize == 0 || isKtx2(std::span<const uint8_t>(base + cached.pixelOffset, cached.pixelSize));
+			}
+			else
+			{
+				valid &= (image.format == VK_FORMAT_R8G8B8A8_UNORM || isBlockCompressed(image.format)) && cached.arrayLayers == 1 && cached.flags == 0;
+				valid &= cached.pixelSize == 0 || cached.pixelSize == getMipChainSize(image.extent, cached.mipLevels, image.format);
+			}
+			if (valid)
+			{
+				image.pixels = std::span<const uint8_t>(base + cached.pixelOffset, cached.pixelSize);
+			}
+		}
+
+		for (uint32_t i = 0; i < header.meshCount && valid; i++)
+		{
+			const CacheMesh& cached = meshes[i];
+			ImportedMesh& mesh = import.meshes.emplace_back();
+			mesh.name = getString(cached.name);
+			valid &= inFile(cached.vertexOffset, uint64_t(cached.vertexCount) * sizeof(Vertex)) && cached.vertexOffset % alignof(Vertex) == 0;
+			valid &= inFile(cached.indexOffset, uint64_t(cached.indexCount) * sizeof(uint32_t)) && cached.indexOffset % alignof(uint32_t) == 0;
+			valid &= inFile(cached.meshletOffset, uint64_t(cached.meshletCount) * sizeof(Meshlet)) && cached.meshletOffset % alignof(Meshlet) == 0;
+			valid &= uint64_t(cached.firstSurface) + cached.surfaceCount <= header.surfaceCount;
+			if (!valid)
+			{
+				break;
+			}
+
+			mesh.vertices = std::span<const Vertex>(reinterpret_cast<const Vertex*>(base + cached.vertexOffset), cached.vertexCount);
+			mesh.indices = std::span<const uint32_t>(reinterpret_cast<const uint32_t*>(base + cached.indexOffset), cached.indexCount);
+			mesh.meshlets = std::span<const Meshlet>(reinterpret_cast<const Meshlet*>(base + cached.meshletOffset), cached.meshletCount);
+			// the index values are read by the hierarchy and occluder builds and by the GPU, a corrupt one must not get through
+			uint32_t maxIndex = 0;
+			for (uint32_t index : mesh.indices)
+			{
+				maxIndex = std::max(maxIndex, index);
+			}
+			valid &= cached.indexCount == 0 || maxIndex < cached.vertexCount;
+			for (const Meshlet& meshlet : mesh.meshlets)
+			{
+				valid &= uint64_t(meshlet.firstIndex) + meshlet.indexCount <= cached.indexCount;
+				valid &= meshlet.indexCount % 3 == 0 && meshlet.indexCount <= MeshletMaxTriangles * 3;
+			}
+			mesh.surfaces.assign(surfaces + cached.firstSurface, surfaces + cached.firstSurface + cached.surfaceCount);
+			for (const ImportedSurface& surface : mesh.surfaces)
+			{
+				valid &= surface.materialIndex < header.materialCount && uint64_t(surface.startIndex) + surface.count <= cached.indexCount;
+				valid &= uint64_t(surface.firstMeshlet) + surface.meshletCount <= cached.meshletCount;
+				valid &= surface.lodCount < MaxMeshLods;
+				for (uint32_t lod = 0; lod < std::min(surface.lodCount, MaxMeshLods - 1); lod++)
+				{
+					valid &= uint64_t(surface.lods[lod].startIndex) + surface.lods[lod].count <= cached.indexCount;
+					valid &= uint64_t(surface.lods[lod].firstMeshlet) + surface.lods[lod].meshletCount <= cached.meshletCount;
+				}
+			}
+		}
+
+		import.samplers.assign(samplers, samplers + header.samplerCount);
+
+		for (uint32_t i = 0; i < header.materialCount && valid; i++)
+		{
+			const CacheMaterial& cached = materials[i];
+			ImportedMaterial& material = import.materials.emplace_back();
+			material.name = getString(cached.name);
+			material.baseColorFactors = cached.baseColorFactors;
+			material.metalRoughFactors = cached.metalRoughFactors;
+			material.passType = static_cast<MaterialPass>(cached.passType);
+			material.colorImage = cached.colorImage;
+			material.colorSampler = cached.colorSampler;
+			material.doubleSided = cached.doubleSided != 0;
+			valid &= cached.colorImage < int32_t(header.imageCount) && cached.colorSampler < int32_t(header.samplerCount);
+			valid &= cached.colorImage < 0 || cached.colorSampler >= 0;
+		}
+
+		for (uint32_t i = 0; i < header.nodeCount && valid; i++)
+		{
+			const CacheNode& cached = nodes[i];
+			ImportedNode& node = import.nodes.emplace_back();
+			node.name = getString(cached.name);
+			node.localTransform = cached.localTransform;
+			node.meshIndex = cached.meshIndex;
+			node.firstChild = cached.firstChild;
+			node.childCount = cached.childCount;
+			valid &= cached.meshIndex < int32_t(header.meshCount) && uint64_t(cached.firstChild) + cached.childCount <= header.childCount;
+		}
+
+		import.children.assign(children, children + header.childCount);
+		for (uint32_t child : import.children)
+		{
+			valid &= child < header.nodeCount;
+		}
+
+		if (!valid)
+		{
+			return {};
+		}
+		return import;
+	}
+
+	bool cookScene(JobSystem& jobs, std::string_view filePath, EngineStats& stats, const ImportSettings& settings)
+	{
+		std::optional<SceneImport> import = importGltf(jobs, filePath, stats, settings);
+		if (!import.has_value())
+		{
+			return false;
+		}
+
+		std::filesystem::path sourcePath = filePath;
+		return writeSceneCache(*import, getSceneCachePath(sourcePath), hashSceneSource(sourcePath, settings));
+	}
+
+	std::optional<std::shared_ptr<LoadedGLTF>> loadScene(RenderDevice* engine, std::string_view filePath)
+	{
+		std::filesystem::path sourcePath = filePath;
+		std::filesystem::path cachePath = getSceneCachePath(sourcePath);
+		uint64_t sourceHash = hashSceneSource(sourcePath, engine->m_importSettings);
+
+		auto cacheStart = std::chrono::steady_clock::now();
+		std::optional<SceneImport> cached = readSceneCache(cachePath, sourceHash);
+		if (cached.has_value())
+		{
+			engine->getStats().assetParseTime += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cacheStart).count();
+			return createScene(engine, *cached);
+		}
+
+		// missing or stale cache
+		std::optional<SceneImport> import = importGltf(engine->getJobSystem(), filePath, engine->getStats(), engine->m_importSettings);
+		if (!import.has_value())
+		{
+			return {};
+		}
+
+		if (!writeSceneCache(*import, cachePath, sourceHash))
+		{
+			std::cout << "Failed to write the scene cache " << cachePath << std::endl;
+		}
+		return createScene(engine, *import);
+	}
+}
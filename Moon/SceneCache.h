@@ -0,0 +1,30 @@
+#pragma once
+#include "SceneImport.h"
+
+#include <filesystem>
+
+namespace Moon
+{
+	// Baked scene format: a header followed by 16 byte aligned tables (images, meshes, surfaces, samplers,
+	// materials, nodes, children, strings) and the raw pixel, vertex and index blobs. The file is memory
+	// mapped and the blobs are copied straight from the mapping into staging memory.
+	constexpr uint32_t SceneCacheVersion = 7;
+
+	// Content hash of a scene source and of the settings it is imported with. The buffers and images the file
+	// references by path are hashed with it, other files of its folder do not invalidate the cache. 0 when the
+	// source cannot be parsed.
+	uint64_t hashSceneSource(const std::filesystem::path& sourcePath, const ImportSettings& settings);
+
+	std::filesystem::path getSceneCachePath(const std::filesystem::path& sourcePath);
+
+	bool writeSceneCache(const SceneImport& import, const std::filesystem::path& cachePath, uint64_t sourceHash);
+	// Returns nothing when the file is missing, corrupted or was baked from another version of the source
+	std::optional<SceneImport> readSceneCache(const std::filesystem::path& cachePath, uint64_t sourceHash);
+
+	// Offline step: imports the glTF file and writes its cache next to it
+	bool cookScene(JobSystem& jobs, std::string_view filePath, EngineStats& stats, const ImportSettings& settings);
+
+	// Loads the scene from its cache when it is up to date, otherwise falls back to loadGltf and bakes the cache.
+	// The engine import settings apply.
+	std::optional<std::shared_ptr<LoadedGLTF>> loadScene(RenderDevice* engine, std::string_view filePath);
+}
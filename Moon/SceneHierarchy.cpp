@@ -0,0 +1,80 @@
+#include "SceneHierarchy.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace Moon
+{
+	uint32_t SceneHierarchy::addNode(uint32_t parent, const glm::mat4& localTransform)
+	{
+		assert(parent == InvalidIndex || parent < m_parents.size());
+
+		uint32_t index = static_cast<uint32_t>(m_parents.size());
+		m_localTransforms.push_back(localTransform);
+		m_worldTransforms.push_back(localTransform);
+		m_parents.push_back(parent);
+		m_dirty.push_back(1);
+
+		m_firstDirty = std::min(m_firstDirty, index);
+		return index;
+	}
+
+	void SceneHierarchy::reserve(size_t count)
+	{
+		m_localTransforms.reserve(count);
+		m_worldTransforms.reserve(count);
+		m_parents.reserve(count);
+		m_dirty.reserve(count);
+	}
+
+	void SceneHierarchy::clear()
+	{
+		m_localTransforms.clear();
+		m_worldTransforms.clear();
+		m_parents.clear();
+		m_dirty.clear();
+		m_changedNodes.clear();
+		m_firstDirty = InvalidIndex;
+	}
+
+	void SceneHierarchy::setLocalTransform(uint32_t node, const glm::mat4& localTransform)
+	{
+		m_localTransforms[node] = localTransform;
+		m_dirty[node] = 1;
+		m_firstDirty = std::min(m_firstDirty, node);
+	}
+
+	bool SceneHierarchy::updateTransforms()
+	{
+		m_changedNodes.clear();
+		if (m_firstDirty == InvalidIndex)
+		{
+			return false;
+		}
+
+		// nodes before the first dirty one can't be affected, and since parents always come first
+		// a node only needs its parent's flag to know if it has to be recomputed
+		const size_t count = m_parents.size();
+		for (size_t i = m_firstDirty; i < count; i++)
+		{
+			const uint32_t parent = m_parents[i];
+			const bool parentChanged = parent != InvalidIndex && m_dirty[parent];
+			if (!m_dirty[i] && !parentChanged)
+			{
+				continue;
+			}
+
+			m_dirty[i] = 1;
+			m_worldTransforms[i] = parent != InvalidIndex ? m_worldTransforms[parent] * m_localTransforms[i] : m_localTransforms[i];
+			m_changedNodes.push_back(static_cast<uint32_t>(i));
+		}
+
+		for (uint32_t node : m_changedNodes)
+		{
+			m_dirty[node] = 0;
+		}
+		m_firstDirty = InvalidIndex;
+
+		return !m_changedNodes.empty();
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+
+namespace Moon
+{
+	// Flattened transform hierarchy. Nodes are stored in parent-before-child order so that
+	// world transforms can be resolved with a single linear pass over the arrays.
+	class SceneHierarchy
+	{
+	public:
+		static constexpr uint32_t InvalidIndex = ~0u;
+
+		// parent must be InvalidIndex or an index returned by a previous call
+		uint32_t addNode(uint32_t parent, const glm::mat4& localTransform);
+		void reserve(size_t count);
+		void clear();
+
+		void setLocalTransform(uint32_t node, const glm::mat4& localTransform);
+		const glm::mat4& getLocalTransform(uint32_t node) const { return m_localTransforms[node]; }
+		const glm::mat4& getWorldTransform(uint32_t node) const { return m_worldTransforms[node]; }
+		uint32_t getParent(uint32_t node) const { return m_parents[node]; }
+		size_t size() const { return m_parents.size(); }
+
+		// Recompute world transforms of dirty nodes and their descendants.
+		// Returns true if any world transform changed, the nodes touched are listed in getChangedNodes().
+		bool updateTransforms();
+		std::span<const uint32_t> getChangedNodes() const { return m_changedNodes; }
+
+	private:
+		std::vector<glm::mat4> m_localTransforms;
+		std::vector<glm::mat4> m_worldTransforms;
+		std::vector<uint32_t> m_parents;
+		std::vector<uint8_t> m_dirty;
+
+		std::vector<uint32_t> m_changedNodes;
+		uint32_t m_firstDirty{ InvalidIndex };
+	};
+}
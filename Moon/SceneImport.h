@@ -0,0 +1,132 @@
+#pragma once
+#include "Mesh.h"
+
+#include <glm/mat4x4.hpp>
+
+namespace Moon
+{
+	//Forward declaration
+	class JobSystem;
+	class MappedFile;
+	struct EngineStats;
+
+	// CPU side content of a scene, produced either from a glTF file or from a baked scene cache.
+	// The spans point at the owned storage vectors, at the mapped cache file or, for KTX2 images, at the mapped
+	// glTF files. Images and meshes are move only so a copy never points at the storage of another object.
+
+	struct ImportedImage
+	{
+		ImportedImage() = default;
+		ImportedImage(ImportedImage&&) = default;
+		ImportedImage& operator=(ImportedImage&&) = default;
+		ImportedImage(const ImportedImage&) = delete;
+		ImportedImage& operator=(const ImportedImage&) = delete;
+
+		std::string name;
+		VkExtent3D extent;
+		VkFormat format{ VK_FORMAT_R8G8B8A8_UNORM };
+		uint32_t mipLevels{ 1 };
+		uint32_t arrayLayers{ 1 }; // layers times cube faces, only KTX2 images have several
+		bool cubemap{ false };
+		bool ktx2{ false }; // pixels hold the whole KTX2 container, uploaded with the level layout of the file
+		std::vector<uint8_t> storage;
+		std::span<const uint8_t> pixels; // mip chain in format, level 0 first, or the KTX2 container
+		std::shared_ptr<const MappedFile> file; // keeps the glTF file the pixels of a KTX2 image point into mapped
+
+		// materials only sample 2D textures
+		bool isTexture2D() const { return !pixels.empty() && arrayLayers == 1 && !cubemap; }
+	};
+
+	// Primitive of an imported mesh
+	struct ImportedSurface
+	{
+		uint32_t startIndex;
+		uint32_t count;
+		uint32_t materialIndex;
+		Bounds bounds;
+		uint32_t firstMeshlet{ 0 };
+		uint32_t meshletCount{ 0 };
+		uint32_t lodCount{ 0 };
+		MeshLod lods[MaxMeshLods - 1]{}; // simplified levels, their ranges follow the full detail indices
+	};
+
+	// All primitives of a mesh merged in the same vertex and index arrays
+	struct ImportedMesh
+	{
+		ImportedMesh() = default;
+		ImportedMesh(ImportedMesh&&) = default;
+		ImportedMesh& operator=(ImportedMesh&&) = default;
+		ImportedMesh(const ImportedMesh&) = delete;
+		ImportedMesh& operator=(const ImportedMesh&) = delete;
+
+		std::string name;
+		std::vector<ImportedSurface> surfaces;
+		std::vector<uint32_t> indexStorage;
+		std::vector<Vertex> vertexStorage;
+		std::vector<Meshlet> meshletStorage;
+		std::span<const uint32_t> indices;
+		std::span<const Vertex> vertices;
+		std::span<const Meshlet> meshlets;
+	};
+
+	struct ImportedSampler
+	{
+		VkFilter magFilter;
+		VkFilter minFilter;
+		VkSamplerMipmapMode mipmapMode;
+		VkSamplerAddressMode addressModeU;
+		VkSamplerAddressMode addressModeV;
+		float maxLod;
+	};
+
+	struct ImportedMaterial
+	{
+		std::string name;
+		glm::vec4 baseColorFactors;
+		glm::vec4 metalRoughFactors;
+		MaterialPass passType;
+		bool doubleSided{ false };
+		int32_t colorImage{ -1 };
+		int32_t colorSampler{ -1 };
+	};
+
+	struct ImportedNode
+	{
+		std::string name;
+		glm::mat4 localTransform;
+		int32_t meshIndex{ -1 };
+		uint32_t firstChild; // range in SceneImport::children
+		uint32_t childCount;
+	};
+
+	struct SceneImport
+	{
+		std::vector<ImportedImage> images;
+		std::vector<ImportedMesh> meshes;
+		std::vector<ImportedSampler> samplers;
+		std::vector<ImportedMaterial> materials;
+		std::vector<ImportedNode> nodes;
+		std::vector<uint32_t> children;
+
+		std::shared_ptr<MappedFile> source; // keeps the mapped cache alive while the spans are used
+	};
+
+	struct ImportSettings
+	{
+		bool optimizeMeshes{ false }; // weld and reorder the meshes for the vertex cache, overdraw and vertex fetch
+		bool generateLods{ false }; // append simplified index ranges to every surface
+		bool buildMeshlets{ false }; // split every index range into meshlets for the cluster culling
+		bool buildOccluders{ false }; // keep a simplified CPU copy of the opaque surfaces for the software occlusion culling
+		bool buildTriangleBvhs{ false }; // keep the triangles of every surface in a BVH for the ray queries
+		bool blockCompressedTextures{ true }; // the device samples BC formats, set at init; images stay RGBA8 otherwise
+		// BC encode the decoded images, single threaded per image so only the cook does it; not part of the cache hash,
+		// the runtime loads the cooked caches whatever their image formats
+		bool compressTextures{ false };
+	};
+
+	// Parses the glTF file, then decodes its images and builds its meshes on the job system
+	std::optional<SceneImport> importGltf(JobSystem& jobs, std::string_view filePath, EngineStats& stats, const ImportSettings& settings = {});
+
+	// Creates the GPU resources, materials and node hierarchy of an imported scene
+	std::shared_ptr<LoadedGLTF> createScene(RenderDevice* engine, const SceneImport& import);
+}
@@ -0,0 +1,473 @@
+#include "TextureCompression.h"
+#include "Image.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MOON_BC_SSE
+#endif
+
+namespace Moon
+{
+	// 4x4 RGBA8 texels in row order
+	struct Block
+	{
+		uint8_t texels[16][4];
+	};
+
+	static void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Block& block)
+	{
+		for (uint32_t y = 0; y < 4; y++)
+		{
+			const uint8_t* row = rgba + size_t(std::min(blockY * 4 + y, height - 1)) * width * 4;
+			for (uint32_t x = 0; x < 4; x++)
+			{
+				memcpy(block.texels[y * 4 + x], row + std::min(blockX * 4 + x, width - 1) * 4, 4);
+			}
+		}
+	}
+
+	static void getBlockBounds(const Block& block, uint8_t minColor[4], uint8_t maxColor[4])
+	{
+#if defined(MOON_BC_SSE)
+		const __m128i* texels = reinterpret_cast<const __m128i*>(block.texels);
+		__m128i row0 = _mm_loadu_si128(texels);
+		__m128i row1 = _mm_loadu_si128(texels + 1);
+		__m128i row2 = _mm_loadu_si128(texels + 2);
+		__m128i row3 = _mm_loadu_si128(texels + 3);
+		__m128i low = _mm_min_epu8(_mm_min_epu8(row0, row1), _mm_min_epu8(row2, row3));
+		__m128i high = _mm_max_epu8(_mm_max_epu8(row0, row1), _mm_max_epu8(row2, row3));
+
+		// fold the four texels of each register into the first one
+		low = _mm_min_epu8(low, _mm_srli_si128(low, 8));
+		low = _mm_min_epu8(low, _mm_srli_si128(low, 4));
+		high = _mm_max_epu8(high, _mm_srli_si128(high, 8));
+		high = _mm_max_epu8(high, _mm_srli_si128(high, 4));
+
+		uint32_t packedLow = static_cast<uint32_t>(_mm_cvtsi128_si32(low));
+		uint32_t packedHigh = static_cast<uint32_t>(_mm_cvtsi128_si32(high));
+		memcpy(minColor, &packedLow, 4);
+		memcpy(maxColor, &packedHigh, 4);
+#else
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			minColor[c] = 255;
+			maxColor[c] = 0;
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				minColor[c] = std::min(minColor[c], block.texels[i][c]);
+				maxColor[c] = std::max(maxColor[c], block.texels[i][c]);
+			}
+		}
+#endif
+	}
+
+	static void writeLittleEndian(uint8_t* out, uint64_t value, uint32_t bytes)
+	{
+		for (uint32_t i = 0; i < bytes; i++)
+		{
+			out[i] = static_cast<uint8_t>(value >> (i * 8));
+		}
+	}
+
+	// Single channel block: both endpoints are the channel range, six interpolated values in between
+	static void encodeBC4(const Block& block, uint32_t channel, uint8_t* out)
+	{
+		uint8_t low = 255, high = 0;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			low = std::min(low, block.texels[i][channel]);
+			high = std::max(high, block.texels[i][channel]);
+		}
+
+		out[0] = high;
+		out[1] = low;
+
+		uint64_t indices = 0;
+		if (high > low)
+		{
+			// index 0 is high, 1 is low, 2 to 7 go from high to low in sevenths
+			static const uint8_t paletteIndex[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+			int range = high - low;
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				int step = ((high - block.texels[i][channel]) * 14 + range) / (2 * range);
+				indices |= uint64_t(paletteIndex[step]) << (3 * i);
+			}
+		}
+		writeLittleEndian(out + 2, indices, 6);
+	}
+
+	static uint16_t packRGB565(const int color[3])
+	{
+		int r = (color[0] * 31 + 127) / 255;
+		int g = (color[1] * 63 + 127) / 255;
+		int b = (color[2] * 31 + 127) / 255;
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	static void unpackRGB565(uint16_t packed, int color[3])
+	{
+		int r = packed >> 11;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// Opaque four color block from the inset bounding box of the texels
+	static void encodeBC1(const Block& block, uint8_t* out)
+	{
+		uint8_t minColor[4], maxColor[4];
+		getBlockBounds(block, minColor, maxColor);
+
+		// the box diagonal runs along the widest channel, the other channels are flipped when they decrease along it
+		uint32_t widest = 0;
+		for (uint32_t c = 1; c < 3; c++)
+		{
+			if (maxColor[c] - minColor[c] > maxColor[widest] - minColor[widest])
+			{
+				widest = c;
+			}
+		}
+
+		int center[3];
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			center[c] = (minColor[c] + maxColor[c] + 1) / 2;
+		}
+
+		int covariance[3] = {};
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			int reference = block.texels[i][widest] - center[widest];
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				covariance[c] += (block.texels[i][c] - center[c]) * reference;
+			}
+		}
+
+		int endpoints[2][3];
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			int inset = (maxColor[c] - minColor[c]) >> 4;
+			endpoints[0][c] = maxColor[c] - inset;
+			endpoints[1][c] = minColor[c] + inset;
+			if (covariance[c] < 0)
+			{
+				std::swap(endpoints[0][c], endpoints[1][c]);
+			}
+		}
+
+		// the first color has to be the greater one to select the four color mode
+		uint16_t color0 = packRGB565(endpoints[0]);
+		uint16_t color1 = packRGB565(endpoints[1]);
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+		}
+
+		uint32_t indices = 0;
+		if (color0 != color1)
+		{
+			int palette[4][3];
+			unpackRGB565(color0, palette[0]);
+			unpackRGB565(color1, palette[1]);
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t best = 0;
+				int bestError = INT32_MAX;
+				for (uint32_t p = 0; p < 4; p++)
+				{
+					int error = 0;
+					for (uint32_t c = 0; c < 3; c++)
+					{
+						int delta = block.texels[i][c] - palette[p][c];
+						error += delta * delta;
+					}
+					if (error < bestError)
+					{
+						bestError = error;
+						best = p;
+					}
+				}
+				indices |= best << (2 * i);
+			}
+		}
+
+		writeLittleEndian(out, color0, 2);
+		writeLittleEndian(out + 2, color1, 2);
+		writeLittleEndian(out + 4, indices, 4);
+	}
+
+	// 7 bit endpoint and its p-bit, the p-bit is shared by the four channels
+	static void quantizeBC7Endpoint(const float endpoint[4], int quantized[4], int& pBit)
+	{
+		float bestError = INFINITY;
+		for (int p = 0; p < 2; p++)
+		{
+			int candidate[4];
+			float error = 0.f;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				candidate[c] = std::clamp(static_cast<int>(std::lround((endpoint[c] - p) / 2.f)), 0, 127);
+				float delta = float((candidate[c] << 1) | p) - endpoint[c];
+				error += delta * delta;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				pBit = p;
+				memcpy(quantized, candidate, sizeof(candidate));
+			}
+		}
+	}
+
+	// BC7 mode 6: a single RGBA subset with 7.7.7.7 endpoints, per endpoint p-bits and 4 bit indices
+	static void encodeBC7(const Block& block, uint8_t* out)
+	{
+		float mean[4] = {};
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				mean[c] += block.texels[i][c] / 16.f;
+			}
+		}
+
+		float covariance[4][4] = {};
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			float delta[4];
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				delta[c] = block.texels[i][c] - mean[c];
+			}
+			for (uint32_t a = 0; a < 4; a++)
+			{
+				for (uint32_t b = 0; b < 4; b++)
+				{
+					covariance[a][b] += delta[a] * delta[b];
+				}
+			}
+		}
+
+		// principal axis by power iteration, starting from the bounding box diagonal
+		uint8_t minColor[4], maxColor[4];
+		getBlockBounds(block, minColor, maxColor);
+		float axis[4];
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			axis[c] = float(maxColor[c] - minColor[c]) + 1e-3f;
+		}
+		for (uint32_t iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float length = 0.f;
+			for (uint32_t a = 0; a < 4; a++)
+			{
+				for (uint32_t b = 0; b < 4; b++)
+				{
+					next[a] += covariance[a][b] * axis[b];
+				}
+				length += next[a] * next[a];
+			}
+			if (length < 1e-12f)
+			{
+				break;
+			}
+			length = 1.f / std::sqrt(length);
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				axis[c] = next[c] * length;
+			}
+		}
+
+		float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3]);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			axis[c] /= axisLength;
+		}
+
+		float lowest = INFINITY, highest = -INFINITY;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			float projection = 0.f;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				projection += (block.texels[i][c] - mean[c]) * axis[c];
+			}
+			lowest = std::min(lowest, projection);
+			highest = std::max(highest, projection);
+		}
+
+		float endpoints[2][4];
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			endpoints[0][c] = std::clamp(mean[c] + axis[c] * lowest, 0.f, 255.f);
+			endpoints[1][c] = std::clamp(mean[c] + axis[c] * highest, 0.f, 255.f);
+		}
+
+		int quantized[2][4];
+		int pBits[2];
+		quantizeBC7Endpoint(endpoints[0], quantized[0], pBits[0]);
+		quantizeBC7Endpoint(endpoints[1], quantized[1], pBits[1]);
+
+		static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+		int palette[16][4];
+		for (uint32_t p = 0; p < 16; p++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				int e0 = (quantized[0][c] << 1) | pBits[0];
+				int e1 = (quantized[1][c] << 1) | pBits[1];
+				palette[p][c] = ((64 - weights[p]) * e0 + weights[p] * e1 + 32) >> 6;
+			}
+		}
+
+		uint32_t indices[16];
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			int bestError = INT32_MAX;
+			for (uint32_t p = 0; p < 16; p++)
+			{
+				int error = 0;
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					int delta = block.texels[i][c] - palette[p][c];
+					error += delta * delta;
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					indices[i] = p;
+				}
+			}
+		}
+
+		// the first index is stored with 3 bits, its top bit has to be zero
+		if (indices[0] & 8)
+		{
+			std::swap(quantized[0], quantized[1]);
+			std::swap(pBits[0], pBits[1]);
+			for (uint32_t& index : indices)
+			{
+				index = 15 - index;
+			}
+		}
+
+		memset(out, 0, 16);
+		uint32_t bit = 0;
+		auto writeBits = [&](uint32_t value, uint32_t count)
+			{
+				for (uint32_t i = 0; i < count; i++, bit++)
+				{
+					out[bit >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (bit & 7));
+				}
+			};
+
+		writeBits(1 << 6, 7);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			writeBits(quantized[0][c], 7);
+			writeBits(quantized[1][c], 7);
+		}
+		writeBits(pBits[0], 1);
+		writeBits(pBits[1], 1);
+		writeBits(indices[0], 3);
+		for (uint32_t i = 1; i < 16; i++)
+		{
+			writeBits(indices[i], 4);
+		}
+	}
+
+	VkFormat chooseBlockFormat(TextureRole role, std::span<const uint8_t> rgba)
+	{
+		switch (role)
+		{
+		case TextureRole::Normal:
+			return VK_FORMAT_BC5_UNORM_BLOCK;
+		case TextureRole::Single:
+			return VK_FORMAT_BC4_UNORM_BLOCK;
+		case TextureRole::Color:
+		default:
+			for (size_t i = 3; i < rgba.size(); i += 4)
+			{
+				if (rgba[i] != 255)
+				{
+					return VK_FORMAT_BC7_UNORM_BLOCK;
+				}
+			}
+			return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		}
+	}
+
+	void compressImage(VkFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks)
+	{
+		uint32_t blocksX = (width + 3) / 4;
+		uint32_t blocksY = (height + 3) / 4;
+		size_t blockSize = getImageSize(VkExtent3D{ 4, 4, 1 }, format);
+
+		Block block;
+		for (uint32_t y = 0; y < blocksY; y++)
+		{
+			for (uint32_t x = 0; x < blocksX; x++)
+			{
+				loadBlock(rgba, width, height, x, y, block);
+				uint8_t* out = blocks + (size_t(y) * blocksX + x) * blockSize;
+
+				switch (format)
+				{
+				case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+				case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+					encodeBC1(block, out);
+					break;
+				case VK_FORMAT_BC3_UNORM_BLOCK:
+					encodeBC4(block, 3, out);
+					encodeBC1(block, out + 8);
+					break;
+				case VK_FORMAT_BC4_UNORM_BLOCK:
+					encodeBC4(block, 0, out);
+					break;
+				case VK_FORMAT_BC5_UNORM_BLOCK:
+					encodeBC4(block, 0, out);
+					encodeBC4(block, 1, out + 8);
+					break;
+				case VK_FORMAT_BC7_UNORM_BLOCK:
+					encodeBC7(block, out);
+					break;
+				default:
+					assert(false && "unsupported block format");
+					return;
+				}
+			}
+		}
+	}
+
+	std::vector<uint8_t> compressMipChain(VkFormat format, const uint8_t* chain, VkExtent3D extent, uint32_t mipLevels)
+	{
+		std::vector<uint8_t> blocks(getMipChainSize(extent, mipLevels, format));
+
+		size_t srcOffset = 0;
+		size_t dstOffset = 0;
+		for (uint32_t level = 0; level < mipLevels; level++)
+		{
+			VkExtent3D mip = getMipExtent(extent, level);
+			compressImage(format, chain + srcOffset, mip.width, mip.height, blocks.data() + dstOffset);
+			srcOffset += getImageSize(mip, VK_FORMAT_R8G8B8A8_UNORM);
+			dstOffset += getImageSize(mip, format);
+		}
+		return blocks;
+	}
+}
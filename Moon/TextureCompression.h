@@ -0,0 +1,21 @@
+#pragma once
+#include "RenderTypes.h"
+
+namespace Moon
+{
+	// How a texture is sampled by the materials, decides its block format
+	enum class TextureRole : uint8_t
+	{
+		Color,  // BC1, or BC7 when it has alpha
+		Normal, // BC5, only the xy of the normal are kept
+		Single, // BC4, red channel only
+	};
+
+	VkFormat chooseBlockFormat(TextureRole role, std::span<const uint8_t> rgba);
+
+	// Encodes an RGBA8 image into BC1, BC3, BC4, BC5 or BC7 blocks. Partial blocks on the edges repeat the last texels.
+	void compressImage(VkFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks);
+
+	// Encodes every level of a tightly packed RGBA8 mip chain, the result is packed the same way
+	std::vector<uint8_t> compressMipChain(VkFormat format, const uint8_t* chain, VkExtent3D extent, uint32_t mipLevels);
+}
@@ -0,0 +1,340 @@
+#include "UploadManager.h"
+#include "RenderDevice.h"
+#include "RenderUtilities.h"
+
+#include <cstring>
+
+namespace Moon
+{
+	static constexpr size_t StagingAlignment = 16; // covers texel block sizes and the 4 byte copy offset rule
+
+	void UploadManager::init(RenderDevice* engine, VkQueue queue, uint32_t queueFamily, std::mutex* queueMutex)
+	{
+		m_engine = engine;
+		m_device = engine->getDevice();
+		m_queue = queue;
+		m_queueFamily = queueFamily;
+		m_queueMutex = queueMutex;
+
+		VkCommandPoolCreateInfo poolInfo = Moon::commandPoolCreateInfo(queueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+		VK_CHECK(vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool));
+
+		VkSemaphoreTypeCreateInfo timelineInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+		timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		timelineInfo.initialValue = 0;
+		VkSemaphoreCreateInfo semaphoreInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+		semaphoreInfo.pNext = &timelineInfo;
+		VK_CHECK(vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_timeline));
+
+		m_staging = engine->createBuffer(StagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+	}
+
+	void UploadManager::cleanup()
+	{
+		wait(flush());
+
+		m_engine->destroyBuffer(m_staging);
+		vkDestroySemaphore(m_device, m_timeline, nullptr);
+		vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+	}
+
+	UploadTicket UploadManager::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, size_t size)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (size == 0)
+		{
+			return UploadTicket{ m_submittedValue };
+		}
+
+		VkBuffer srcBuffer;
+		VkDeviceSize srcOffset;
+		void* staging = allocateStaging(size, srcBuffer, srcOffset);
+		memcpy(staging, data, size);
+
+		VkBufferCopy copy{ 0 };
+		copy.srcOffset = srcOffset;
+		copy.dstOffset = offset;
+		copy.size = size;
+		vkCmdCopyBuffer(m_current.cmd, srcBuffer, buffer, 1, &copy);
+
+		UploadTicket ticket{ m_submittedValue + 1 };
+		if (m_current.stagingBytes >= MaxBatchSize)
+		{
+			submitBatch();
+		}
+		return ticket;
+	}
+
+	UploadTicket UploadManager::uploadImage(VkImage image, uint32_t mipLevels, std::span<const VkBufferImageCopy> regions, const void* data, size_t size)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (size == 0)
+		{
+			return UploadTicket{ m_submittedValue };
+		}
+
+		VkBuffer srcBuffer;
+		VkDeviceSize srcOffset;
+		void* staging = allocateStaging(size, srcBuffer, srcOffset);
+		memcpy(staging, data, size);
+
+		VkImageMemoryBarrier2 barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+		barrier.srcAccessMask = VK_ACCESS_2_NONE;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange = imageSubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT);
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+		VkDependencyInfo depInfo{ VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+		depInfo.imageMemoryBarrierCount = 1;
+		depInfo.pImageMemoryBarriers = &barrier;
+		vkCmdPipelineBarrier2(m_current.cmd, &depInfo);
+
+		std::vector<VkBufferImageCopy> copies(regions.begin(), regions.end());
+		for (VkBufferImageCopy& copy : copies)
+		{
+			copy.bufferOffset += srcOffset;
+		}
+		vkCmdCopyBufferToImage(m_current.cmd, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+
+		// the timeline semaphore makes the writes visible to the graphics queue
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+		barrier.dstAccessMask = VK_ACCESS_2_NONE;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vkCmdPipelineBarrier2(m_current.cmd, &depInfo);
+
+		UploadTicket ticket{ m_submittedValue + 1 };
+		if (m_current.stagingBytes >= MaxBatchSize)
+		{
+			submitBatch();
+		}
+		return ticket;
+	}
+
+	UploadTicket UploadManager::flush()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_recording)
+		{
+			submitBatch();
+		}
+		return UploadTicket{ m_submittedValue };
+	}
+
+	void UploadManager::collect()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		uint64_t completed;
+		VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_timeline, &completed));
+		while (!m_inFlight.empty() && m_inFlight.front().value <= completed)
+		{
+			releaseBatch(m_inFlight.front());
+			m_inFlight.pop_front();
+		}
+	}
+
+	bool UploadManager::isComplete(UploadTicket ticket) const
+	{
+		uint64_t completed;
+		VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_timeline, &completed));
+		return completed >= ticket.value;
+	}
+
+	void UploadManager::wait(UploadTicket ticket)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (ticket.value > m_submittedValue && m_recording)
+			{
+				submitBatch();
+			}
+		}
+
+		if (ticket.value > 0)
+		{
+			uint64_t value = ticket.value;
+			VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &m_timeline;
+			waitInfo.pValues = &value;
+			VK_CHECK(vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX));
+		}
+		collect();
+	}
+
+	void* UploadManager::allocateStaging(size_t size, VkBuffer& buffer, VkDeviceSize& offset)
+	{
+		size_t alignedSize = (size + StagingAlignment - 1) & ~(StagingAlignment - 1);
+
+		// too big to share the ring, give it its own buffer released with the batch
+		if (alignedSize > StagingSize / 2)
+		{
+			if (!m_recording)
+			{
+				beginBatch();
+			}
+			AllocatedBuffer dedicated = m_engine->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+			m_current.dedicatedStaging.push_back(dedicated);
+			buffer = dedicated.buffer;
+			offset = 0;
+			return dedicated.info.pMappedData;
+		}
+
+		size_t ringOffset;
+		while (!tryAllocateRing(alignedSize, ringOffset))
+		{
+			// the ring is full, push what is recorded and wait for the oldest batch to free its range
+			if (m_recording)
+			{
+				submitBatch();
+			}
+			retireOldest();
+		}
+
+		if (!m_recording)
+		{
+			beginBatch();
+		}
+		buffer = m_staging.buffer;
+		offset = ringOffset;
+		return (uint8_t*)m_staging.info.pMappedData + ringOffset;
+	}
+
+	bool UploadManager::tryAllocateRing(size_t size, size_t& offset)
+	{
+		if (m_used == 0)
+		{
+			m_head = 0;
+			m_tail = 0;
+		}
+
+		size_t consumed;
+		bool full = m_used > 0 && m_head == m_tail;
+		if (m_head >= m_tail && !full)
+		{
+			// free space is [head, end) and [0, tail)
+			if (m_head + size <= StagingSize)
+			{
+				offset = m_head;
+				consumed = size;
+			}
+			else if (size <= m_tail)
+			{
+				// the end of the ring is skipped and charged to this batch
+				offset = 0;
+				consumed = StagingSize - m_head + size;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if (!full && m_head + size <= m_tail)
+		{
+			offset = m_head;
+			consumed = size;
+		}
+		else
+		{
+			return false;
+		}
+
+		m_head = offset + size;
+		m_used += consumed;
+		m_current.stagingBytes += consumed;
+		m_current.stagingEnd = m_head;
+		return true;
+	}
+
+	void UploadManager::beginBatch()
+	{
+		if (!m_freeCommandBuffers.empty())
+		{
+			m_current.cmd = m_freeCommandBuffers.back();
+			m_freeCommandBuffers.pop_back();
+		}
+		else
+		{
+			VkCommandBufferAllocateInfo allocInfo = Moon::commandBufferAllocateInfo(m_commandPool, 1);
+			VK_CHECK(vkAllocateCommandBuffers(m_device, &allocInfo, &m_current.cmd));
+		}
+
+		VkCommandBufferBeginInfo beginInfo = Moon::commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		VK_CHECK(vkBeginCommandBuffer(m_current.cmd, &beginInfo));
+		m_recording = true;
+	}
+
+	void UploadManager::submitBatch()
+	{
+		VK_CHECK(vkEndCommandBuffer(m_current.cmd));
+
+		m_current.value = m_submittedValue + 1;
+
+		VkCommandBufferSubmitInfo cmdInfo = Moon::commandBufferSubmitInfo(m_current.cmd);
+		VkSemaphoreSubmitInfo signalInfo = Moon::semaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_timeline);
+		signalInfo.value = m_current.value;
+		VkSubmitInfo2 submit = Moon::submitInfo(&cmdInfo, &signalInfo, nullptr);
+
+		if (m_queueMutex)
+		{
+			std::lock_guard<std::mutex> queueLock(*m_queueMutex);
+			VK_CHECK(vkQueueSubmit2(m_queue, 1, &submit, VK_NULL_HANDLE));
+		}
+		else
+		{
+			VK_CHECK(vkQueueSubmit2(m_queue, 1, &submit, VK_NULL_HANDLE));
+		}
+
+		m_submittedValue = m_current.value;
+		m_inFlight.push_back(std::move(m_current));
+		m_current = Batch{};
+		m_recording = false;
+	}
+
+	void UploadManager::retireOldest()
+	{
+		if (m_inFlight.empty())
+		{
+			return;
+		}
+
+		Batch& batch = m_inFlight.front();
+		VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &m_timeline;
+		waitInfo.pValues = &batch.value;
+		VK_CHECK(vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX));
+
+		releaseBatch(batch);
+		m_inFlight.pop_front();
+	}
+
+	void UploadManager::releaseBatch(Batch& batch)
+	{
+		// batches retire in submit order, so the ring tail simply follows them
+		if (batch.stagingBytes > 0)
+		{
+			m_used -= batch.stagingBytes;
+			m_tail = batch.stagingEnd;
+		}
+
+		for (const AllocatedBuffer& buffer : batch.dedicatedStaging)
+		{
+			m_engine->destroyBuffer(buffer);
+		}
+
+		VK_CHECK(vkResetCommandBuffer(batch.cmd, 0));
+		m_freeCommandBuffers.push_back(batch.cmd);
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "RenderTypes.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+namespace Moon
+{
+	//Forward declaration
+	class RenderDevice;
+
+	// Timeline value of the batch an upload was recorded in, the data is on the GPU once the
+	// upload semaphore reaches it
+	struct UploadTicket
+	{
+		uint64_t value{ 0 };
+	};
+
+	// Records buffer and image uploads on the transfer queue. Data is copied into a persistently mapped
+	// staging ring, many uploads share one command buffer and one submit, and every submit signals the
+	// upload timeline semaphore. Nothing blocks the CPU unless the ring is full or wait() is called,
+	// the renderer makes its frame submit wait on the semaphore instead.
+	class UploadManager
+	{
+	public:
+		static constexpr size_t StagingSize = 64 * 1024 * 1024;
+		static constexpr size_t MaxBatchSize = 16 * 1024 * 1024; // submit early so the copies overlap with loading
+
+		// queueMutex guards the queue when it is shared with the renderer, nullptr for a dedicated queue
+		void init(RenderDevice* engine, VkQueue queue, uint32_t queueFamily, std::mutex* queueMutex);
+		void cleanup();
+
+		UploadTicket uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, size_t size);
+		// copies the regions (bufferOffset relative to data) and leaves every mip level and layer in SHADER_READ_ONLY_OPTIMAL
+		UploadTicket uploadImage(VkImage image, uint32_t mipLevels, std::span<const VkBufferImageCopy> regions, const void* data, size_t size);
+
+		// submits the batch being recorded, returns the value it will signal
+		UploadTicket flush();
+		// releases staging memory and command buffers of the finished batches
+		void collect();
+
+		bool isComplete(UploadTicket ticket) const;
+		void wait(UploadTicket ticket);
+
+		VkSemaphore getSemaphore() const { return m_timeline; }
+		uint64_t getSubmittedValue() const { return m_submittedValue; }
+		uint32_t getQueueFamily() const { return m_queueFamily; }
+
+	private:
+		struct Batch
+		{
+			VkCommandBuffer cmd{ VK_NULL_HANDLE };
+			uint64_t value{ 0 };
+			size_t stagingEnd{ 0 };
+			size_t stagingBytes{ 0 };
+			std::vector<AllocatedBuffer> dedicatedStaging; // uploads bigger than the ring
+		};
+
+		// returns a pointer in staging memory and the buffer/offset to copy from
+		void* allocateStaging(size_t size, VkBuffer& buffer, VkDeviceSize& offset);
+		bool tryAllocateRing(size_t size, size_t& offset);
+		void beginBatch();
+		void submitBatch();
+		void retireOldest();
+		void releaseBatch(Batch& batch);
+
+		RenderDevice* m_engine{ nullptr };
+		VkDevice m_device{ VK_NULL_HANDLE };
+		VkQueue m_queue{ VK_NULL_HANDLE };
+		uint32_t m_queueFamily{ 0 };
+		std::mutex* m_queueMutex{ nullptr };
+
+		VkCommandPool m_commandPool{ VK_NULL_HANDLE };
+		std::vector<VkCommandBuffer> m_freeCommandBuffers;
+		VkSemaphore m_timeline{ VK_NULL_HANDLE };
+		std::atomic<uint64_t> m_submittedValue{ 0 };
+
+		AllocatedBuffer m_staging;
+		size_t m_head{ 0 };
+		size_t m_tail{ 0 };
+		size_t m_used{ 0 };
+
+		bool m_recording{ false };
+		Batch m_current;
+		std::deque<Batch> m_inFlight;
+
+		std::mutex m_mutex;
+	};
+}
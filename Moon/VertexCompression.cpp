@@ -0,0 +1,116 @@
+#include "VertexCompression.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace Moon
+{
+	static uint16_t quantizeUnorm16(float value)
+	{
+		return static_cast<uint16_t>(std::clamp(value, 0.f, 1.f) * 65535.f + 0.5f);
+	}
+
+	static int8_t quantizeSnorm8(float value)
+	{
+		return static_cast<int8_t>(std::round(std::clamp(value, -1.f, 1.f) * 127.f));
+	}
+
+	// maps a unit vector onto the [-1, 1] square, the lower hemisphere is folded over the diagonals
+	static glm::vec2 encodeOctahedral(glm::vec3 n)
+	{
+		float length = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+		if (length == 0.f)
+		{
+			return glm::vec2(0.f);
+		}
+		n /= length;
+
+		glm::vec2 e(n.x, n.y);
+		if (n.z < 0.f)
+		{
+			e = glm::vec2((1.f - std::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f));
+		}
+		return e;
+	}
+
+	static bool sameBounds(const Bounds& a, const Bounds& b)
+	{
+		return a.origin == b.origin && a.extents == b.extents;
+	}
+
+	bool compressVertices(std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+		std::span<const ImportedSurface> surfaces, std::vector<CompactVertex>& compact)
+	{
+		// surface whose bounds quantize each vertex, unreferenced vertices keep none
+		constexpr uint32_t none = ~0u;
+		std::vector<uint32_t> owners(vertices.size(), none);
+		for (uint32_t s = 0; s < surfaces.size(); s++)
+		{
+			const ImportedSurface& surface = surfaces[s];
+			if (surface.startIndex + uint64_t(surface.count) > indices.size())
+			{
+				return false;
+			}
+
+			for (uint32_t i = surface.startIndex; i < surface.startIndex + surface.count; i++)
+			{
+				if (indices[i] >= vertices.size())
+				{
+					return false;
+				}
+
+				uint32_t& owner = owners[indices[i]];
+				if (owner == none)
+				{
+					owner = s;
+				}
+				else if (owner != s && !sameBounds(surfaces[owner].bounds, surface.bounds))
+				{
+					return false;
+				}
+			}
+		}
+
+		compact.resize(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			const Vertex& vertex = vertices[i];
+			CompactVertex& packed = compact[i];
+
+			// mesh.vert decodes origin + (q * 2 - 1) * extents, flat axes decode to the origin
+			glm::vec3 position(0.5f);
+			if (owners[i] != none)
+			{
+				const Bounds& bounds = surfaces[owners[i]].bounds;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					if (bounds.extents[axis] > 0.f)
+					{
+						position[axis] = (vertex.position[axis] - bounds.origin[axis]) / bounds.extents[axis] * 0.5f + 0.5f;
+					}
+				}
+			}
+			packed.position[0] = quantizeUnorm16(position.x);
+			packed.position[1] = quantizeUnorm16(position.y);
+			packed.position[2] = quantizeUnorm16(position.z);
+
+			glm::vec2 normal = encodeOctahedral(vertex.normal);
+			packed.normal[0] = quantizeSnorm8(normal.x);
+			packed.normal[1] = quantizeSnorm8(normal.y);
+
+			packed.uv[0] = glm::packHalf1x16(vertex.uv_x);
+			packed.uv[1] = glm::packHalf1x16(vertex.uv_y);
+			packed.color = glm::packUnorm4x8(vertex.color);
+		}
+		return true;
+	}
+
+	std::vector<uint16_t> narrowIndices(std::span<const uint32_t> indices)
+	{
+		std::vector<uint16_t> narrow(indices.size());
+		std::transform(indices.begin(), indices.end(), narrow.begin(), [](uint32_t index) { return static_cast<uint16_t>(index); });
+		return narrow;
+	}
+}
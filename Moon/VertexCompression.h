@@ -0,0 +1,13 @@
+#pragma once
+#include "SceneImport.h"
+
+namespace Moon
+{
+	// Packs the vertices of a mesh into CompactVertex, positions are quantized inside the bounds of the surface
+	// drawing them. Fails when a vertex is shared by surfaces with different bounds.
+	bool compressVertices(std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+		std::span<const ImportedSurface> surfaces, std::vector<CompactVertex>& compact);
+
+	// 16 bit copy of the indices, every index must be below 65536
+	std::vector<uint16_t> narrowIndices(std::span<const uint32_t> indices);
+}
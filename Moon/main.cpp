@@ -1,8 +1,54 @@
 #include <RenderDevice.h>
+#include <Bvh.h>
+#include <Culling.h>
+#include <JobSystem.h>
+#include <SceneCache.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string_view>
 
 int main(int argc, char* argv[])
 {
+	auto hasFlag = [&](std::string_view flag)
+		{
+			return std::find(argv + 1, argv + argc, flag) != argv + argc;
+		};
+
+	Moon::ImportSettings importSettings;
+	importSettings.optimizeMeshes = hasFlag("--optimize-meshes");
+	importSettings.generateLods = hasFlag("--generate-lods");
+	importSettings.buildMeshlets = hasFlag("--meshlets");
+	importSettings.buildOccluders = hasFlag("--occluders");
+	importSettings.buildTriangleBvhs = hasFlag("--triangle-bvh");
+
+	if (argc > 1 && std::string_view(argv[1]) == "--benchmark-culling")
+	{
+		Moon::runCullingBenchmark();
+		return 0;
+	}
+
+	if (argc > 1 && std::string_view(argv[1]) == "--benchmark-bvh")
+	{
+		Moon::runBvhBenchmark();
+		return 0;
+	}
+
+	if (argc > 2 && std::string_view(argv[1]) == "--cook")
+	{
+		Moon::JobSystem jobs;
+		jobs.init();
+		Moon::EngineStats stats{};
+		importSettings.compressTextures = true;
+		bool cooked = Moon::cookScene(jobs, argv[2], stats, importSettings);
+		std::cout << (cooked ? "Cooked " : "Failed to cook ") << argv[2] << ", peak memory " << stats.peakLoadMemory / (1024 * 1024) << " MB" << std::endl;
+		return cooked ? 0 : 1;
+	}
+
 	Moon::RenderDevice engine;
+	engine.m_compactVertices = hasFlag("--compact-vertices");
+	engine.m_useGpuCulling = hasFlag("--gpu-culling");
+	engine.m_importSettings = importSettings;
 	engine.init();		
 	engine.run();	
 	engine.cleanup();	
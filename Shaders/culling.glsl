@@ -0,0 +1,41 @@
+//frustum tests shared by the culling passes, include after inputStructures.glsl
+
+//xyz normal pointing inside, w distance, vulkan clip volume -w <= x,y <= w and 0 <= z <= w
+vec4 frustumPlane(int i)
+{
+	mat4 m = transpose(sceneData.viewproj);
+	vec4 planes[6] = vec4[6](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2], m[3] - m[2]);
+	return planes[i] / length(planes[i].xyz);
+}
+
+bool isSphereInFrustum(vec3 center, float radius)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		vec4 plane = frustumPlane(i);
+		if (dot(plane.xyz, center) + plane.w < -radius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//world axis aligned box, same test as cullBounds on the CPU
+bool isBoxInFrustum(vec3 center, vec3 extents)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		vec4 plane = frustumPlane(i);
+		if (dot(plane.xyz, center) + plane.w + dot(abs(plane.xyz), extents) < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+vec3 cameraPosition()
+{
+	return -transpose(mat3(sceneData.view)) * sceneData.view[3].xyz;
+}
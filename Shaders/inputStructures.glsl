@@ -8,11 +8,20 @@ layout(set = 0, binding = 0) uniform SceneData
 	vec4 sunlightColor;
 } sceneData;
 
-layout(set = 1, binding = 0) uniform GLTFMaterialData
+struct MaterialData
 {
 	vec4 baseColorFactors;
-	vec4 metalRoughFactors;	
-} materialData;
+	vec4 metalRoughFactors;
+	uint colorTextureIndex;
+	uint colorSamplerIndex;
+	uint metalRoughTextureIndex;
+	uint metalRoughSamplerIndex;
+};
 
-layout(set = 1, binding = 1) uniform sampler2D baseColorTex;
-layout(set = 1, binding = 2) uniform sampler2D metalRoughTex;
+//bindless resources, indexed by the material id of each draw
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler samplers[];
+layout(std430, set = 1, binding = 2) readonly buffer MaterialBuffer
+{
+	MaterialData materials[];
+} materialBuffer;
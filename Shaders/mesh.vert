@@ -1,12 +1,14 @@
 #version 450
 #extension GL_GOOGLE_include_directive : require
 #extension GL_EXT_buffer_reference : require
+#extension GL_EXT_nonuniform_qualifier : require
 
 #include "inputStructures.glsl"
 
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec3 outColor;
 layout (location = 2) out vec2 outUV;
+layout (location = 3) flat out uint outMaterialId;
 
 struct Vertex
 {
@@ -22,22 +24,70 @@ layout(buffer_reference, std430) readonly buffer VertexBuffer
 	Vertex vertices[];
 };
 
-//push constants block
-layout( push_constant ) uniform constants
+//CompactVertex: xyz unorm16 position in the object bounds, snorm8 octahedral normal, half uv, unorm8 color
+layout(buffer_reference, std430) readonly buffer CompactVertexBuffer
+{
+	uvec4 vertices[];
+};
+
+const uint VertexFormatCompact = 1;
+
+struct ObjectData
 {
 	mat4 renderMatrix;
 	VertexBuffer vertexBuffer;
-} PushConstants;
+	uint materialId;
+	uint vertexFormat;
+	vec4 boundsOrigin;
+	vec4 boundsExtents;
+};
+
+//per draw data, indexed through firstInstance
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffer
+{
+	ObjectData objects[];
+} objectBuffer;
+
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+Vertex loadVertex(ObjectData object)
+{
+	if (object.vertexFormat != VertexFormatCompact)
+	{
+		return object.vertexBuffer.vertices[gl_VertexIndex];
+	}
+
+	uvec4 packed = CompactVertexBuffer(object.vertexBuffer).vertices[gl_VertexIndex];
+	vec3 position = vec3(packed.x & 0xFFFFu, packed.x >> 16, packed.y & 0xFFFFu) / 65535.0f;
+	vec2 uv = unpackHalf2x16(packed.z);
+
+	Vertex v;
+	v.position = object.boundsOrigin.xyz + (position * 2.0f - 1.0f) * object.boundsExtents.xyz;
+	v.normal = decodeOctahedral(unpackSnorm4x8(packed.y).zw);
+	v.uv_x = uv.x;
+	v.uv_y = uv.y;
+	v.color = unpackUnorm4x8(packed.w);
+	return v;
+}
 
 void main() 
 {
-	Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
+	ObjectData object = objectBuffer.objects[gl_InstanceIndex];
+	Vertex v = loadVertex(object);
 	
 	vec4 position = vec4(v.position, 1.0f);
-	gl_Position =  sceneData.viewproj * PushConstants.renderMatrix * position;
+	gl_Position =  sceneData.viewproj * object.renderMatrix * position;
 
-	outNormal = (PushConstants.renderMatrix * vec4(v.normal, 0.f)).xyz;
-	outColor = v.color.xyz * materialData.baseColorFactors.xyz;	
+	outNormal = (object.renderMatrix * vec4(v.normal, 0.f)).xyz;
+	outColor = v.color.xyz * materialBuffer.materials[object.materialId].baseColorFactors.xyz;
 	outUV.x = v.uv_x;
 	outUV.y = v.uv_y;
+	outMaterialId = object.materialId;
 }